@@ -0,0 +1,180 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: animation.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "..\json\json.h"
+#include "..\filemap\filemap.h"
+#include "..\ppm\ppm.h"
+#include "..\arena\arena.h"
+#include "..\threadpool\threadpool.h"
+#include "animation.h"
+
+/**
+ * Parses the keyframes of an animation and checks that they hold the same objects. The first
+ * frame is filled in.
+ *
+ * @param paths - json scene of every keyframe, in order
+ * @param num_keys - number of keyframes
+ * @param pool - thread pool that parses large keyframes, may be NULL
+ * @returns the animation
+ */
+Animation* animation_load(char **paths, int num_keys, ThreadPool *pool) {
+	Animation *animation;
+	char *data;
+	size_t size;
+	int key, index, mapped, num_objects;
+	
+	animation = (Animation *)calloc(1, sizeof(Animation));
+	if(animation != NULL) {
+		animation->keys = (Object **)malloc(sizeof(Object *) * num_keys);
+		
+	}
+	
+	if((animation == NULL) || (animation->keys == NULL)) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	arena_init(&animation->arena);
+	animation->num_keys = num_keys;
+	
+	for(key = 0; key < num_keys; key++) {
+		data = map_file(paths[key], &size, &mapped);
+		if(data == NULL) {
+			fprintf(stderr, "Error, could not open file '%s'.\n", paths[key]);
+			exit(-1);
+			
+		}
+		
+		animation->keys[key] = json_parse_scene_parallel(data, size, &animation->arena, &num_objects, pool);
+		unmap_file(data, size, mapped);
+		
+		if(key == 0) {
+			animation->num_objects = num_objects;
+			
+		} else if(num_objects != animation->num_objects) {
+			fprintf(stderr, "Error, keyframe '%s' has %d objects, '%s' has %d.\n", paths[key], num_objects, paths[0], animation->num_objects);
+			exit(-1);
+			
+		}
+		
+		// Objects are matched up by their place in the scene
+		for(index = 0; (key > 0) && (index < num_objects); index++) {
+			if(((animation->keys[key][index].type == NULL) != (animation->keys[0][index].type == NULL)) || ((animation->keys[0][index].type != NULL) && (strcmp(animation->keys[key][index].type, animation->keys[0][index].type) != 0))) {
+				fprintf(stderr, "Error, object %d of keyframe '%s' is not of the same type as in '%s'.\n", index, paths[key], paths[0]);
+				exit(-1);
+				
+			}
+			
+		}
+		
+	}
+	
+	animation->objects = (Object *)malloc(sizeof(Object) * (animation->num_objects + 1));
+	if(animation->objects == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	animation_frame(animation, 0, 1);
+	
+	return (animation);
+	
+}
+
+
+/**
+ * Interpolates the objects of a frame. Keyframes are spread evenly from the first frame to
+ * the last, every double of an object's properties is blended between the two keyframes
+ * around the frame.
+ *
+ * @param animation - the animation, its objects receive the frame
+ * @param frame - the frame, 0 to num_frames - 1
+ * @param num_frames - number of frames of the animation
+ */
+void animation_frame(Animation *animation, int frame, int num_frames) {
+	double *from, *to, *value;
+	double position, t;
+	int key, index, property, num_properties;
+	
+	// Position of the frame along the keyframes
+	position = (num_frames > 1) ? (double)frame * (animation->num_keys - 1) / (num_frames - 1) : 0.0;
+	key = (int)position;
+	key = (key > animation->num_keys - 2) ? animation->num_keys - 2 : key;
+	key = (key < 0) ? 0 : key;
+	t = position - key;
+	
+	memcpy(animation->objects, animation->keys[key], sizeof(Object) * animation->num_objects);
+	if(animation->num_keys == 1) {
+		return;
+		
+	}
+	
+	// Camera, sphere, plane and light properties are all doubles
+	num_properties = sizeof(animation->objects[0].properties) / sizeof(double);
+	
+	for(index = 0; index < animation->num_objects; index++) {
+		from = (double *)&animation->keys[key][index].properties;
+		to = (double *)&animation->keys[key + 1][index].properties;
+		value = (double *)&animation->objects[index].properties;
+		
+		for(property = 0; property < num_properties; property++) {
+			value[property] = from[property] + (to[property] - from[property]) * t;
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Names the output file of a frame by inserting the zero padded frame number before the
+ * extension, out.png gives out-0000.png for the first frame.
+ *
+ * @param path - path the frames are named after
+ * @param frame - the frame
+ * @param num_frames - number of frames, sets the width of the number
+ * @returns the path, to be freed by the caller
+ */
+char* animation_path(char *path, int frame, int num_frames) {
+	int digits, count;
+	
+	digits = 1;
+	for(count = num_frames - 1; count >= 10; count = count / 10) {
+		digits = digits + 1;
+		
+	}
+	digits = (digits < 4) ? 4 : digits;
+	
+	return path_with_suffix(path, "-%0*d", digits, frame);
+	
+}
+
+
+/**
+ * Releases an animation and its keyframes.
+ *
+ * @param animation - animation to release
+ */
+void animation_free(Animation *animation) {
+	if(animation == NULL) {
+		return;
+		
+	}
+	
+	arena_free(&animation->arena);
+	free(animation->objects);
+	free(animation->keys);
+	free(animation);
+	
+}
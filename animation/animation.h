@@ -0,0 +1,35 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: animation.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef animation_h
+	#define animation_h
+	
+	// Refitting keeps the hierarchy until its estimated cost reaches this many times a fresh build's
+	#define DEFAULT_REFIT_LIMIT 1.5
+	
+	/**
+	 * A scene animated by keyframes. Every keyframe is a json scene holding the same objects in
+	 * the same order, spread evenly over the frames. objects holds the frame being rendered,
+	 * every property interpolated linearly between the two keyframes around it.
+	 */
+	typedef struct Animation {
+		Object **keys;
+		int num_keys;
+		Object *objects;
+		int num_objects;
+		Arena arena;					//<= holds the keyframes and their type strings
+		
+	} Animation;
+	
+	// function declarations
+	Animation* animation_load(char **paths, int num_keys, ThreadPool *pool);
+	void animation_frame(Animation *animation, int frame, int num_frames);
+	char* animation_path(char *path, int frame, int num_frames);
+	void animation_free(Animation *animation);
+	
+#endif
@@ -0,0 +1,247 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: arena.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "arena.h"
+
+// Block headers are padded so the data behind them stays aligned
+#define ARENA_HEADER ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1))
+
+/**
+ * Returns the first byte of a block's data.
+ *
+ * @param block - the block
+ * @returns start of the data
+ */
+static char *block_data(ArenaBlock *block) {
+	return ((char *)block + ARENA_HEADER);
+	
+}
+
+
+/**
+ * Rounds a size up to the arena alignment.
+ *
+ * @param size - size in bytes
+ * @returns the aligned size
+ */
+static size_t align_size(size_t size) {
+	return ((size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1));
+	
+}
+
+
+/**
+ * Prepares an empty arena, no memory is reserved until the first allocation.
+ *
+ * @param arena - the arena
+ */
+void arena_init(Arena *arena) {
+	arena->head = NULL;
+	arena->used = 0;
+	arena->reserved = 0;
+	arena->num_blocks = 0;
+	
+}
+
+
+/**
+ * Adds a block of at least size bytes of data in front of the block list.
+ *
+ * @param arena - the arena
+ * @param size - bytes of data the block must hold
+ */
+static void arena_grow(Arena *arena, size_t size) {
+	ArenaBlock *block;
+	
+	if(size < ARENA_BLOCK_SIZE) {
+		size = ARENA_BLOCK_SIZE;
+		
+	}
+	
+	block = (ArenaBlock *)malloc(ARENA_HEADER + size);
+	if(block == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	block->next = arena->head;
+	block->size = size;
+	block->used = 0;
+	block->last = 0;
+	
+	arena->head = block;
+	arena->reserved += ARENA_HEADER + size;
+	arena->num_blocks++;
+	
+}
+
+
+/**
+ * Allocates zero filled memory from the arena, exits the program if the allocation fails.
+ *
+ * @param arena - the arena
+ * @param size - size in bytes
+ * @returns pointer to the memory, released by arena_free
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+	ArenaBlock *block;
+	char *pointer;
+	
+	size = align_size(size);
+	
+	if((arena->head == NULL) || (arena->head->used + size > arena->head->size)) {
+		arena_grow(arena, size);
+		
+	}
+	
+	block = arena->head;
+	pointer = block_data(block) + block->used;
+	block->last = block->used;
+	block->used += size;
+	arena->used += size;
+	
+	memset(pointer, 0, size);
+	return pointer;
+	
+}
+
+
+/**
+ * Grows or shrinks an allocation, keeping its contents. The most recent allocation is resized
+ * in place when its block has room, and an allocation that fills a block of its own is moved
+ * with realloc, so an array that keeps doubling does not leave its old copies behind. Added
+ * memory is not cleared.
+ *
+ * @param arena - the arena
+ * @param pointer - allocation to resize, NULL to allocate
+ * @param old_size - size the allocation was made with
+ * @param new_size - size in bytes it needs now
+ * @returns pointer to the resized allocation, which may have moved
+ */
+void *arena_resize(Arena *arena, void *pointer, size_t old_size, size_t new_size) {
+	ArenaBlock *block = arena->head;
+	ArenaBlock *moved;
+	void *resized;
+	
+	if(pointer == NULL) {
+		return arena_alloc(arena, new_size);
+		
+	}
+	
+	old_size = align_size(old_size);
+	new_size = align_size(new_size);
+	
+	if((block != NULL) && ((char *)pointer == block_data(block) + block->last)) {
+		// Most recent allocation, extend it while the block has room
+		if(block->last + new_size <= block->size) {
+			arena->used += new_size - old_size;
+			block->used = block->last + new_size;
+			return pointer;
+			
+		}
+		
+		// Sole allocation of the block, move the whole block
+		if(block->last == 0) {
+			moved = (ArenaBlock *)realloc(block, ARENA_HEADER + new_size);
+			if(moved == NULL) {
+				fprintf(stderr, "Failed to allocate memory.\n");
+				exit(-1);
+				
+			}
+			
+			arena->reserved += new_size - moved->size;
+			arena->used += new_size - old_size;
+			moved->size = new_size;
+			moved->used = new_size;
+			arena->head = moved;
+			return block_data(moved);
+			
+		}
+		
+	}
+	
+	resized = arena_alloc(arena, new_size);
+	memcpy(resized, pointer, (old_size < new_size) ? old_size : new_size);
+	return resized;
+	
+}
+
+
+/**
+ * Copies a string into the arena.
+ *
+ * @param arena - the arena
+ * @param string - the string
+ * @returns the copy
+ */
+char *arena_strdup(Arena *arena, const char *string) {
+	size_t length = strlen(string) + 1;
+	
+	return (char *)memcpy(arena_alloc(arena, length), string, length);
+	
+}
+
+
+/**
+ * Moves every block of another arena into this one, e.g. memory worker threads allocated on
+ * their own, so it is released with this arena. Allocations keep coming from the current block
+ * of this arena and the other arena is left empty.
+ *
+ * @param arena - the arena
+ * @param other - arena whose blocks are taken over
+ */
+void arena_merge(Arena *arena, Arena *other) {
+	ArenaBlock *last;
+	
+	if(other->head == NULL) {
+		return;
+		
+	}
+	
+	if(arena->head == NULL) {
+		arena->head = other->head;
+		
+	} else {
+		for(last = other->head; last->next != NULL; last = last->next);
+		
+		last->next = arena->head->next;
+		arena->head->next = other->head;
+		
+	}
+	
+	arena->used += other->used;
+	arena->reserved += other->reserved;
+	arena->num_blocks += other->num_blocks;
+	
+	arena_init(other);
+	
+}
+
+
+/**
+ * Releases every allocation of the arena and leaves it empty.
+ *
+ * @param arena - the arena
+ */
+void arena_free(Arena *arena) {
+	ArenaBlock *block;
+	
+	while(arena->head != NULL) {
+		block = arena->head;
+		arena->head = block->next;
+		free(block);
+		
+	}
+	
+	arena_init(arena);
+	
+}
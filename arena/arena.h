@@ -0,0 +1,51 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: arena.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef arena_h
+	#define arena_h
+	
+	// Size in bytes of an ordinary arena block, larger requests get a block of their own
+	#define ARENA_BLOCK_SIZE (1 << 20)
+	
+	// Every allocation starts on a multiple of this many bytes
+	#define ARENA_ALIGNMENT 16
+	
+	/**
+	 * Block of memory handed out front to back. last is the offset of the most recent
+	 * allocation so it can be grown in place.
+	 */
+	typedef struct ArenaBlock {
+		struct ArenaBlock *next;
+		size_t size;
+		size_t used;
+		size_t last;
+		
+	} ArenaBlock;
+	
+	/**
+	 * Region allocator for data that lives as long as the scene. Allocations are never released
+	 * one by one, arena_free releases the whole arena at once. head is the block allocations
+	 * are currently taken from, used and reserved track the footprint.
+	 */
+	typedef struct Arena {
+		ArenaBlock *head;
+		size_t used;
+		size_t reserved;
+		int num_blocks;
+		
+	} Arena;
+	
+	// function declarations
+	void arena_init(Arena *arena);
+	void *arena_alloc(Arena *arena, size_t size);
+	void *arena_resize(Arena *arena, void *pointer, size_t old_size, size_t new_size);
+	char *arena_strdup(Arena *arena, const char *string);
+	void arena_merge(Arena *arena, Arena *other);
+	void arena_free(Arena *arena);
+	
+#endif
@@ -0,0 +1,874 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: bvh.c
+ * Copyright © 2016 All rights reserved 
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "..\math\real.h"
+#include "..\math\vector_math.h"
+#include "..\json\json.h"
+#include "..\scene\scene.h"
+#include "..\simd\simd.h"
+#include "..\stats\stats.h"
+#include "bvh.h"
+
+/**
+ * Bin used while evaluating split candidates with the surface area heuristic.
+ */
+typedef struct Bin {
+	real min[3];
+	real max[3];
+	int count;
+	
+} Bin;
+
+
+/**
+ * Resets a bounding box so that growing it by any point yields that point.
+ *
+ * @param min - minimum corner
+ * @param max - maximum corner
+ */
+static void bounds_empty(real *min, real *max) {
+	min[0] = min[1] = min[2] = INFINITY;
+	max[0] = max[1] = max[2] = -INFINITY;
+	
+}
+
+
+/**
+ * Grows a bounding box to enclose another box.
+ *
+ * @param min - minimum corner, updated
+ * @param max - maximum corner, updated
+ * @param other_min - minimum corner of the enclosed box
+ * @param other_max - maximum corner of the enclosed box
+ */
+static void bounds_grow(real *min, real *max, real *other_min, real *other_max) {
+	int axis;
+	
+	for(axis = 0; axis < 3; axis++) {
+		if(other_min[axis] < min[axis]) {
+			min[axis] = other_min[axis];
+			
+		}
+		
+		if(other_max[axis] > max[axis]) {
+			max[axis] = other_max[axis];
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Half of the surface area of a bounding box, the constant factor cancels out in the SAH.
+ *
+ * @param min - minimum corner
+ * @param max - maximum corner
+ * @returns half surface area, 0 for an empty box
+ */
+static real bounds_area(real *min, real *max) {
+	real x, y, z;
+	
+	if(min[0] > max[0]) {
+		return (0);
+		
+	}
+	
+	x = max[0] - min[0];
+	y = max[1] - min[1];
+	z = max[2] - min[2];
+	
+	return ((x * y) + (y * z) + (z * x));
+	
+}
+
+
+/**
+ * Reads the center of a compiled sphere.
+ *
+ * @param spheres - compiled sphere arrays
+ * @param slot - index of the sphere within the arrays
+ * @param center - receives the center
+ */
+static void sphere_center(SphereArray *spheres, int slot, real *center) {
+	center[0] = spheres->x[slot];
+	center[1] = spheres->y[slot];
+	center[2] = spheres->z[slot];
+	
+}
+
+
+/**
+ * Computes the bounding box of a compiled sphere.
+ *
+ * @param spheres - compiled sphere arrays
+ * @param slot - index of the sphere within the arrays
+ * @param min - minimum corner
+ * @param max - maximum corner
+ */
+static void sphere_bounds(SphereArray *spheres, int slot, real *min, real *max) {
+	real radius = real_sqrt(spheres->radius2[slot]);
+	real center[3];
+	int axis;
+	
+	sphere_center(spheres, slot, center);
+	for(axis = 0; axis < 3; axis++) {
+		min[axis] = center[axis] - radius;
+		max[axis] = center[axis] + radius;
+		
+	}
+	
+}
+
+
+/**
+ * Recursively splits a node using a binned surface area heuristic along the axis with the
+ * largest centroid extent. Nodes holding few primitives, or for which no split is cheaper
+ * than intersecting every primitive, become leaves.
+ *
+ * @param bvh - hierarchy under construction
+ * @param spheres - compiled sphere arrays
+ * @param node_index - node to subdivide
+ * @param depth - depth of the node in the tree
+ */
+static void bvh_subdivide(BVH *bvh, SphereArray *spheres, int node_index, int depth) {
+	BVHNode *node = &bvh->nodes[node_index];
+	Bin bins[BVH_BINS];
+	real centroid_min[3], centroid_max[3];
+	real left_min[BVH_BINS][3], left_max[BVH_BINS][3];
+	real box_min[3], box_max[3], right_min[3], right_max[3];
+	real extent, scale, cost, best_cost;
+	int left_count[BVH_BINS];
+	int index, bin, axis, best_axis, best_split, right_count;
+	int i, j, temp, left;
+	real center[3];
+	
+	if(depth > bvh->depth) {
+		bvh->depth = depth;
+		
+	}
+	
+	// Compute the node bounds and the bounds of the primitive centroids
+	bounds_empty(node->min, node->max);
+	bounds_empty(centroid_min, centroid_max);
+	for(index = node->first; index < node->first + node->count; index++) {
+		sphere_center(spheres, bvh->indices[index], center);
+		sphere_bounds(spheres, bvh->indices[index], box_min, box_max);
+		bounds_grow(node->min, node->max, box_min, box_max);
+		bounds_grow(centroid_min, centroid_max, center, center);
+		
+	}
+	
+	// Small nodes and nodes at the traversal stack limit become leaves
+	if((node->count <= BVH_LEAF_SIZE) || (depth >= BVH_STACK_SIZE - 2)) {
+		return;
+		
+	}
+	
+	// Cost of leaving the node as a leaf
+	best_cost = bounds_area(node->min, node->max) * node->count;
+	best_axis = -1;
+	best_split = 0;
+	
+	for(axis = 0; axis < 3; axis++) {
+		extent = centroid_max[axis] - centroid_min[axis];
+		if(extent <= 0) {
+			continue;
+			
+		}
+		scale = BVH_BINS / extent;
+		
+		// Distribute the primitives into bins
+		for(bin = 0; bin < BVH_BINS; bin++) {
+			bounds_empty(bins[bin].min, bins[bin].max);
+			bins[bin].count = 0;
+			
+		}
+		
+		for(index = node->first; index < node->first + node->count; index++) {
+			sphere_center(spheres, bvh->indices[index], center);
+			bin = (int)((center[axis] - centroid_min[axis]) * scale);
+			if(bin > BVH_BINS - 1) {
+				bin = BVH_BINS - 1;
+				
+			}
+			
+			sphere_bounds(spheres, bvh->indices[index], box_min, box_max);
+			bounds_grow(bins[bin].min, bins[bin].max, box_min, box_max);
+			bins[bin].count = bins[bin].count + 1;
+			
+		}
+		
+		// Sweep from the left accumulating bounds and counts
+		bounds_empty(box_min, box_max);
+		temp = 0;
+		for(bin = 0; bin < BVH_BINS - 1; bin++) {
+			bounds_grow(box_min, box_max, bins[bin].min, bins[bin].max);
+			temp = temp + bins[bin].count;
+			vector_copy(box_min, left_min[bin]);
+			vector_copy(box_max, left_max[bin]);
+			left_count[bin] = temp;
+			
+		}
+		
+		// Sweep from the right evaluating every split plane
+		bounds_empty(right_min, right_max);
+		right_count = 0;
+		for(bin = BVH_BINS - 1; bin > 0; bin--) {
+			bounds_grow(right_min, right_max, bins[bin].min, bins[bin].max);
+			right_count = right_count + bins[bin].count;
+			
+			if((left_count[bin - 1] == 0) || (right_count == 0)) {
+				continue;
+				
+			}
+			
+			cost = bounds_area(left_min[bin - 1], left_max[bin - 1]) * left_count[bin - 1] + bounds_area(right_min, right_max) * right_count;
+			if(cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_split = bin;
+				
+			}
+			
+		}
+		
+	}
+	
+	// No split beats the leaf
+	if(best_axis == -1) {
+		return;
+		
+	}
+	
+	// Partition the index range around the chosen split plane
+	extent = centroid_max[best_axis] - centroid_min[best_axis];
+	scale = BVH_BINS / extent;
+	i = node->first;
+	j = node->first + node->count - 1;
+	while(i <= j) {
+		sphere_center(spheres, bvh->indices[i], center);
+		bin = (int)((center[best_axis] - centroid_min[best_axis]) * scale);
+		if(bin > BVH_BINS - 1) {
+			bin = BVH_BINS - 1;
+			
+		}
+		
+		if(bin < best_split) {
+			i = i + 1;
+			
+		} else {
+			temp = bvh->indices[i];
+			bvh->indices[i] = bvh->indices[j];
+			bvh->indices[j] = temp;
+			j = j - 1;
+			
+		}
+		
+	}
+	
+	left = i - node->first;
+	if((left == 0) || (left == node->count)) {
+		return;
+		
+	}
+	
+	// Create the two children, the right child follows the left one
+	index = bvh->num_nodes;
+	bvh->num_nodes = bvh->num_nodes + 2;
+	
+	bvh->nodes[index].first = node->first;
+	bvh->nodes[index].count = left;
+	bvh->nodes[index + 1].first = i;
+	bvh->nodes[index + 1].count = node->count - left;
+	
+	node->first = index;
+	node->count = 0;
+	
+	bvh_subdivide(bvh, spheres, index, depth + 1);
+	bvh_subdivide(bvh, spheres, index + 1, depth + 1);
+	
+}
+
+
+/**
+ * Builds a bounding volume hierarchy over the spheres of a compiled scene using a binned
+ * surface area heuristic. Planes stay in the scene's plane arrays which act as a side list.
+ *
+ * @param scene - compiled scene
+ * @returns pointer to the new hierarchy
+ */
+BVH* bvh_build(Scene *scene) {
+	BVH *bvh;
+	double start;
+	int index;
+	
+	start = wall_clock();
+	
+	bvh = (BVH *)calloc(1, sizeof(BVH));
+	if(bvh == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	bvh->num_indices = scene->spheres.count;
+	bvh->indices = (int *)malloc(sizeof(int) * (bvh->num_indices + 1));
+	bvh->nodes = (BVHNode *)malloc(sizeof(BVHNode) * (2 * bvh->num_indices + 1));
+	if((bvh->indices == NULL) || (bvh->nodes == NULL)) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	// Leaves reference sphere slots
+	for(index = 0; index < bvh->num_indices; index++) {
+		bvh->indices[index] = index;
+		
+	}
+	
+	// Root node spans every primitive
+	bvh->nodes[0].first = 0;
+	bvh->nodes[0].count = bvh->num_indices;
+	bvh->num_nodes = 1;
+	
+	if(bvh->num_indices > 0) {
+		bvh_subdivide(bvh, &scene->spheres, 0, 0);
+		
+	} else {
+		bounds_empty(bvh->nodes[0].min, bvh->nodes[0].max);
+		
+	}
+	
+	bvh->build_time = wall_clock() - start;
+	
+	return bvh;
+	
+}
+
+
+/**
+ * Recomputes the bounds of every node after spheres moved or changed size, keeping the tree
+ * as it was built. Children are always stored after their parent, so walking the nodes
+ * backwards visits both children before the parent. The tree can get much worse than a fresh
+ * build when spheres move far, bvh_cost tells when to build it again.
+ *
+ * @param bvh - hierarchy to refit
+ * @param scene - compiled scene the hierarchy was built from, with updated sphere arrays
+ */
+void bvh_refit(BVH *bvh, Scene *scene) {
+	BVHNode *node;
+	real box_min[3], box_max[3];
+	int index, primitive;
+	
+	if(bvh->num_indices == 0) {
+		return;
+		
+	}
+	
+	for(index = bvh->num_nodes - 1; index >= 0; index--) {
+		node = &bvh->nodes[index];
+		bounds_empty(node->min, node->max);
+		
+		if(node->count > 0) {
+			for(primitive = node->first; primitive < node->first + node->count; primitive++) {
+				sphere_bounds(&scene->spheres, bvh->indices[primitive], box_min, box_max);
+				bounds_grow(node->min, node->max, box_min, box_max);
+				
+			}
+			
+		} else {
+			bounds_grow(node->min, node->max, bvh->nodes[node->first].min, bvh->nodes[node->first].max);
+			bounds_grow(node->min, node->max, bvh->nodes[node->first + 1].min, bvh->nodes[node->first + 1].max);
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Estimates the cost of tracing a ray through the hierarchy with the surface area heuristic,
+ * the expected number of nodes visited plus primitives tested by a ray that hits the root.
+ *
+ * @param bvh - the hierarchy
+ * @returns the estimated cost, 0 for an empty hierarchy
+ */
+double bvh_cost(BVH *bvh) {
+	BVHNode *node;
+	double root, cost;
+	int index;
+	
+	root = bounds_area(bvh->nodes[0].min, bvh->nodes[0].max);
+	if(root <= 0) {
+		return (0);
+		
+	}
+	
+	cost = 0;
+	for(index = 0; index < bvh->num_nodes; index++) {
+		node = &bvh->nodes[index];
+		cost = cost + bounds_area(node->min, node->max) * ((node->count > 0) ? node->count + 1 : 1);
+		
+	}
+	
+	return (cost / root);
+	
+}
+
+
+/**
+ * Slab test of a ray against an axis aligned bounding box.
+ *
+ * @param node - the node whose bounds are tested
+ * @param ro - ray vector orgin
+ * @param inverse_rd - component wise reciprocal of the ray direction
+ * @param max_distance - hits beyond this distance are ignored
+ * @returns distance at which the ray enters the box, INFINITY if the box is missed
+ */
+static real node_intersection(BVHNode *node, real *ro, real *inverse_rd, real max_distance) {
+	real t0, t1, near, far, temp;
+	int axis;
+	
+	near = -INFINITY;
+	far = max_distance;
+	
+	for(axis = 0; axis < 3; axis++) {
+		t0 = (node->min[axis] - ro[axis]) * inverse_rd[axis];
+		t1 = (node->max[axis] - ro[axis]) * inverse_rd[axis];
+		
+		if(t0 > t1) {
+			temp = t0;
+			t0 = t1;
+			t1 = temp;
+			
+		}
+		
+		// Written so that NaN from a zero direction component never rejects the box
+		if(!(t0 <= near)) {
+			near = t0;
+			
+		}
+		
+		if(!(t1 >= far)) {
+			far = t1;
+			
+		}
+		
+	}
+	
+	if((near > far) || (far < 0)) {
+		return (INFINITY);
+		
+	}
+	
+	return (near);
+	
+}
+
+
+/**
+ * Decides whether a candidate hit replaces the current closest hit. Ties go to the object
+ * that comes first in the scene so the result matches a linear scan of the object array.
+ */
+static int closer_hit(real distance, int index, real best_distance, int closest_object, real max_distance) {
+	if((distance <= 0) || (distance > max_distance)) {
+		return (0);
+		
+	}
+	
+	return ((distance < best_distance) || ((distance == best_distance) && (index < closest_object)));
+	
+}
+
+
+/**
+ * Finds the closest object hit by a ray. Produces the same object and distance as testing
+ * every sphere and plane of the scene in order.
+ *
+ * @param bvh - hierarchy of the scene
+ * @param scene - compiled scene the hierarchy was built from
+ * @param ro - ray vector orgin
+ * @param rd - ray vector direction
+ * @param ignore - object index excluded from the test, -1 to test every object
+ * @param max_distance - hits further away than this are ignored
+ * @param best_distance - receives the distance of the closest hit, INFINITY if none
+ * @returns array index of the closest object, -1 if nothing was hit
+ */
+int bvh_closest(BVH *bvh, Scene *scene, real *ro, real *rd, int ignore, real max_distance, real *best_distance) {
+	int stack[BVH_STACK_SIZE];
+	real inverse_rd[3];
+	real distance, near_left, near_right;
+	int closest_object, index, slot, object, top;
+	long long nodes_visited, primitive_tests, plane_tests;
+	BVHNode *node;
+	
+	closest_object = -1;
+	*best_distance = INFINITY;
+	nodes_visited = primitive_tests = 0;
+	
+	// Planes are unbounded, test them linearly
+	for(slot = 0; slot < scene->planes.count; slot++) {
+		object = scene->planes.object[slot];
+		if(object != ignore) {
+			distance = plane_intersection(&scene->planes, slot, ro, rd);
+			primitive_tests = primitive_tests + 1;
+			
+			if(closer_hit(distance, object, *best_distance, closest_object, max_distance)) {
+				closest_object = object;
+				*best_distance = distance;
+				
+			}
+			
+		}
+		
+	}
+	plane_tests = primitive_tests;
+	
+	if(bvh->num_indices > 0) {
+		inverse_rd[0] = 1.0 / rd[0];
+		inverse_rd[1] = 1.0 / rd[1];
+		inverse_rd[2] = 1.0 / rd[2];
+		
+		top = 0;
+		if(node_intersection(&bvh->nodes[0], ro, inverse_rd, max_distance) != INFINITY) {
+			stack[top++] = 0;
+			
+		}
+		
+		while(top > 0) {
+			node = &bvh->nodes[stack[--top]];
+			nodes_visited = nodes_visited + 1;
+			
+			if(node->count > 0) {
+				// Leaf, test every primitive
+				for(index = node->first; index < node->first + node->count; index++) {
+					slot = bvh->indices[index];
+					object = scene->spheres.object[slot];
+					if(object != ignore) {
+						distance = sphere_intersection(&scene->spheres, slot, ro, rd);
+						primitive_tests = primitive_tests + 1;
+						
+						if(closer_hit(distance, object, *best_distance, closest_object, max_distance)) {
+							closest_object = object;
+							*best_distance = distance;
+							
+						}
+						
+					}
+					
+				}
+				
+			} else {
+				// Interior, visit the nearer child first
+				near_left = node_intersection(&bvh->nodes[node->first], ro, inverse_rd, max_distance);
+				near_right = node_intersection(&bvh->nodes[node->first + 1], ro, inverse_rd, max_distance);
+				
+				// Boxes entered beyond the current hit can not contain a closer one
+				if(near_left > *best_distance) {
+					near_left = INFINITY;
+					
+				}
+				
+				if(near_right > *best_distance) {
+					near_right = INFINITY;
+					
+				}
+				
+				if(near_left <= near_right) {
+					if(near_right != INFINITY) {
+						stack[top++] = node->first + 1;
+						
+					}
+					
+					if(near_left != INFINITY) {
+						stack[top++] = node->first;
+						
+					}
+					
+				} else {
+					if(near_left != INFINITY) {
+						stack[top++] = node->first;
+						
+					}
+					
+					stack[top++] = node->first + 1;
+					
+				}
+				
+			}
+			
+		}
+		
+	}
+	
+	if(bvh->collect_stats != 0) {
+		__atomic_fetch_add(&bvh->stats.rays, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&bvh->stats.nodes_visited, nodes_visited, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&bvh->stats.primitive_tests, primitive_tests, __ATOMIC_RELAXED);
+		
+	}
+	
+	STATS_ADD(plane_tests, plane_tests);
+	STATS_ADD(sphere_tests, primitive_tests - plane_tests);
+	
+	return (closest_object);
+	
+}
+
+
+/**
+ * Any hit traversal for shadow rays, returns as soon as a sphere is found between the origin
+ * and max_distance. Children are visited in storage order since the closest hit is not needed.
+ *
+ * @param bvh - hierarchy of the scene
+ * @param scene - compiled scene the hierarchy was built from
+ * @param ro - ray vector orgin
+ * @param rd - ray vector direction
+ * @param ignore - object index excluded from the test, -1 to test every object
+ * @param max_distance - hits further away than this are ignored
+ * @returns array index of an object hit within max_distance, -1 if there is none
+ */
+int bvh_occluded(BVH *bvh, Scene *scene, real *ro, real *rd, int ignore, real max_distance) {
+	int stack[BVH_STACK_SIZE];
+	real inverse_rd[3];
+	real distance;
+	int index, slot, object, top, occluder;
+	long long nodes_visited, primitive_tests;
+	BVHNode *node;
+	
+	if(bvh->num_indices == 0) {
+		return (-1);
+		
+	}
+	
+	inverse_rd[0] = 1.0 / rd[0];
+	inverse_rd[1] = 1.0 / rd[1];
+	inverse_rd[2] = 1.0 / rd[2];
+	
+	occluder = -1;
+	nodes_visited = primitive_tests = 0;
+	
+	top = 0;
+	stack[top++] = 0;
+	
+	while((top > 0) && (occluder == -1)) {
+		node = &bvh->nodes[stack[--top]];
+		
+		if(node_intersection(node, ro, inverse_rd, max_distance) == INFINITY) {
+			continue;
+			
+		}
+		nodes_visited = nodes_visited + 1;
+		
+		if(node->count > 0) {
+			for(index = node->first; (index < node->first + node->count) && (occluder == -1); index++) {
+				slot = bvh->indices[index];
+				object = scene->spheres.object[slot];
+				
+				if(object != ignore) {
+					distance = sphere_intersection(&scene->spheres, slot, ro, rd);
+					primitive_tests = primitive_tests + 1;
+					
+					if((distance > 0) && (distance <= max_distance)) {
+						occluder = object;
+						
+					}
+					
+				}
+				
+			}
+			
+		} else {
+			stack[top++] = node->first + 1;
+			stack[top++] = node->first;
+			
+		}
+		
+	}
+	
+	if(bvh->collect_stats != 0) {
+		__atomic_fetch_add(&bvh->stats.rays, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&bvh->stats.nodes_visited, nodes_visited, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&bvh->stats.primitive_tests, primitive_tests, __ATOMIC_RELAXED);
+		
+	}
+	
+	STATS_ADD(sphere_tests, primitive_tests);
+	
+	return (occluder);
+	
+}
+
+
+/**
+ * Traverses the hierarchy with a whole packet of rays. A node is visited when any ray of the
+ * packet may still find a closer hit inside it, and the leaves are intersected with the packet
+ * kernels. Gives the same closest hit per ray as bvh_closest.
+ *
+ * @param bvh - hierarchy of the scene
+ * @param scene - compiled scene the hierarchy was built from
+ * @param packet - the ray packet, distance and object receive the closest hits
+ */
+void bvh_closest_packet(BVH *bvh, Scene *scene, RayPacket *packet) {
+	int stack[BVH_STACK_SIZE];
+	real ro[PACKET_SIZE][3], inverse_rd[PACKET_SIZE][3];
+	real near[2], distance;
+	int lane, child, index, top, first;
+	long long nodes_visited, primitive_tests;
+	BVHNode *node;
+	
+	if(bvh->num_indices == 0) {
+		return;
+		
+	}
+	
+	nodes_visited = primitive_tests = 0;
+	
+	for(lane = 0; lane < PACKET_SIZE; lane++) {
+		ro[lane][0] = packet->ox[lane];
+		ro[lane][1] = packet->oy[lane];
+		ro[lane][2] = packet->oz[lane];
+		inverse_rd[lane][0] = 1.0 / packet->dx[lane];
+		inverse_rd[lane][1] = 1.0 / packet->dy[lane];
+		inverse_rd[lane][2] = 1.0 / packet->dz[lane];
+		
+	}
+	
+	top = 0;
+	stack[top++] = 0;
+	
+	while(top > 0) {
+		node = &bvh->nodes[stack[--top]];
+		nodes_visited = nodes_visited + 1;
+		
+		if(node->count > 0) {
+			// Leaf, intersect the packet with every primitive
+			for(index = node->first; index < node->first + node->count; index++) {
+				sphere_intersection_packet(packet, &scene->spheres, bvh->indices[index]);
+				primitive_tests = primitive_tests + PACKET_SIZE;
+				
+			}
+			
+		} else {
+			// A child is entered at the smallest distance any ray that can still improve enters it
+			for(child = 0; child < 2; child++) {
+				near[child] = INFINITY;
+				
+				for(lane = 0; lane < PACKET_SIZE; lane++) {
+					distance = node_intersection(&bvh->nodes[node->first + child], ro[lane], inverse_rd[lane], INFINITY);
+					if((distance <= packet->distance[lane]) && (distance < near[child])) {
+						near[child] = distance;
+						
+					}
+					
+				}
+				
+			}
+			
+			// Visit the nearer child first
+			first = (near[1] < near[0]) ? 1 : 0;
+			if(near[1 - first] != INFINITY) {
+				stack[top++] = node->first + 1 - first;
+				
+			}
+			
+			if(near[first] != INFINITY) {
+				stack[top++] = node->first + first;
+				
+			}
+			
+		}
+		
+	}
+	
+	if(bvh->collect_stats != 0) {
+		__atomic_fetch_add(&bvh->stats.rays, PACKET_SIZE, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&bvh->stats.nodes_visited, nodes_visited * PACKET_SIZE, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&bvh->stats.primitive_tests, primitive_tests, __ATOMIC_RELAXED);
+		
+	}
+	
+	STATS_ADD(sphere_tests, primitive_tests);
+	
+}
+
+
+/**
+ * Prints the build time, the shape of the tree and the traversal cost per ray compared with
+ * testing every primitive of the scene.
+ *
+ * @param bvh - hierarchy of the scene
+ * @param scene - compiled scene the hierarchy was built from
+ * @param fpointer - stream the report is written to
+ */
+void bvh_report(BVH *bvh, Scene *scene, FILE *fpointer) {
+	double rays, brute_force;
+	int index, leaves;
+	
+	leaves = 0;
+	for(index = 0; index < bvh->num_nodes; index++) {
+		if(bvh->nodes[index].count > 0) {
+			leaves = leaves + 1;
+			
+		}
+		
+	}
+	
+	fprintf(fpointer, "\n- Bounding volume hierarchy -\n\n");
+	fprintf(fpointer, "Objects: %d\n", scene->num_objects);
+	fprintf(fpointer, "Primitives: %d\n", bvh->num_indices);
+	fprintf(fpointer, "Planes: %d\n", scene->planes.count);
+	fprintf(fpointer, "Nodes: %d\n", bvh->num_nodes);
+	fprintf(fpointer, "Leaves: %d\n", leaves);
+	fprintf(fpointer, "Depth: %d\n", bvh->depth);
+	fprintf(fpointer, "Build time: %lf ms\n", bvh->build_time * 1000.0);
+	
+	if(bvh->stats.rays > 0) {
+		rays = (double)bvh->stats.rays;
+		brute_force = bvh->num_indices + scene->planes.count;
+		
+		fprintf(fpointer, "Rays traced: %lld\n", bvh->stats.rays);
+		fprintf(fpointer, "Nodes visited per ray: %lf\n", bvh->stats.nodes_visited / rays);
+		fprintf(fpointer, "Primitive tests per ray: %lf\n", bvh->stats.primitive_tests / rays);
+		fprintf(fpointer, "Brute force tests per ray: %lf\n", brute_force);
+		
+		if(bvh->stats.primitive_tests > 0) {
+			fprintf(fpointer, "Test reduction: %lfx\n", (brute_force * rays) / bvh->stats.primitive_tests);
+			
+		}
+		
+	}
+	
+	fprintf(fpointer, "\n");
+	
+}
+
+
+/**
+ * Releases a hierarchy and all of its arrays.
+ *
+ * @param bvh - hierarchy to release
+ */
+void bvh_free(BVH *bvh) {
+	if(bvh == NULL) {
+		return;
+		
+	}
+	
+	free(bvh->nodes);
+	free(bvh->indices);
+	free(bvh);
+	
+}
@@ -0,0 +1,65 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: bvh.h
+ * Copyright © 2016 All rights reserved 
+ */
+ 
+#ifndef bvh_h
+	#define bvh_h
+	
+	#define BVH_BINS 16
+	#define BVH_LEAF_SIZE 4
+	#define BVH_STACK_SIZE 64
+
+	/**
+	 * Axis aligned bounding box node. Interior nodes store the index of their left child in
+	 * first, the right child directly follows it. Leaf nodes have count > 0 and reference
+	 * count entries of the index array starting at first.
+	 */
+	typedef struct BVHNode {
+		real min[3];
+		real max[3];
+		int first;
+		int count;
+		
+	} BVHNode;
+	
+	/**
+	 * Traversal counters, only collected when the BVH was built with statistics enabled.
+	 */
+	typedef struct BVHStats {
+		long long rays;
+		long long nodes_visited;
+		long long primitive_tests;
+		
+	} BVHStats;
+
+	/**
+	 * Bounding volume hierarchy over the spheres of a compiled scene, leaves reference sphere
+	 * slots. Planes are unbounded and are tested linearly for every ray.
+	 */
+	typedef struct BVH {
+		BVHNode *nodes;
+		int num_nodes;
+		int *indices;
+		int num_indices;
+		int depth;
+		double build_time;
+		int collect_stats;
+		BVHStats stats;
+		
+	} BVH;
+
+	// function declarations
+	BVH* bvh_build(Scene *scene);
+	void bvh_refit(BVH *bvh, Scene *scene);
+	double bvh_cost(BVH *bvh);
+	int bvh_closest(BVH *bvh, Scene *scene, real *ro, real *rd, int ignore, real max_distance, real *best_distance);
+	int bvh_occluded(BVH *bvh, Scene *scene, real *ro, real *rd, int ignore, real max_distance);
+	void bvh_closest_packet(BVH *bvh, Scene *scene, RayPacket *packet);
+	void bvh_report(BVH *bvh, Scene *scene, FILE *fpointer);
+	void bvh_free(BVH *bvh);
+ 
+#endif
@@ -0,0 +1,237 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: distribute.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "..\ppm\ppm.h"
+#include "distribute.h"
+
+/**
+ * Builds the path of a worker's partial image, the output path followed by ".partN.ppm".
+ *
+ * @param output - path of the final image
+ * @param worker - number of the worker
+ * @param path - receives the path
+ * @param size - size of path in bytes
+ */
+void distribute_path(char *output, int worker, char *path, size_t size) {
+	snprintf(path, size, "%s.part%d.ppm", output, worker);
+	
+}
+
+
+/**
+ * Assembles partial images written by renders of a --region into the whole image and
+ * writes it, as a PNG when the output ends in .png and as a P6 otherwise. Every partial
+ * must be a region of an image of the same size, together they must cover all of it;
+ * where they overlap the later one wins.
+ *
+ * @param output - path of the image to write
+ * @param paths - paths of the partial images
+ * @param count - number of partial images
+ * @returns 0 once the image is written
+ */
+int merge_regions(char *output, char *paths[], int count) {
+	Image image, part;
+	unsigned char *covered;
+	size_t missing, offset, total;
+	int index, row;
+	
+	covered = NULL;
+	total = 0;
+	memset(&image, 0, sizeof(Image));
+	
+	for(index = 0; index < count; index++) {
+		read_region_image(paths[index], &part);
+		
+		// The first partial gives the size of the whole image
+		if(index == 0) {
+			image = part;
+			image.magic_number = "P6";
+			image.band_start = 0;
+			image.band_height = image.height;
+			image.band_left = 0;
+			image.band_width = image.width;
+			
+			total = (size_t)(image.width) * image.height;
+			image.image_data = (Pixel *)calloc(total + 1, sizeof(Pixel));
+			covered = (unsigned char *)calloc(total + 1, 1);
+			
+			if((image.image_data == NULL) || (covered == NULL)) {
+				fprintf(stderr, "Failed to allocate memory.\n");
+				exit(-1);
+				
+			}
+			
+		} else if((part.width != image.width) || (part.height != image.height) || (part.max_color != image.max_color)) {
+			fprintf(stderr, "Error, '%s' is part of a %dx%d image, not of a %dx%d one.\n", paths[index], part.width, part.height, image.width, image.height);
+			exit(-1);
+			
+		}
+		
+		for(row = part.band_start; row < (part.band_start + part.band_height); row++) {
+			offset = (size_t)(image.width) * row + part.band_left;
+			
+			memcpy(image_pixel(&image, row, part.band_left), image_pixel(&part, row, part.band_left), sizeof(Pixel) * part.band_width);
+			memset(covered + offset, 1, part.band_width);
+			
+		}
+		
+		free(part.image_data);
+		
+	}
+	
+	missing = 0;
+	for(offset = 0; offset < total; offset++) {
+		missing += (covered[offset] == 0);
+		
+	}
+	
+	if(missing > 0) {
+		fprintf(stderr, "Error, the partial images leave %zu pixels of the %dx%d image uncovered.\n", missing, image.width, image.height);
+		exit(-1);
+		
+	}
+	
+	if(is_png_file(output) != 0) {
+		write_png_image(output, &image, NULL);
+		
+	} else {
+		write_p6_image(output, &image);
+		
+	}
+	
+	free(covered);
+	free(image.image_data);
+	
+	return (0);
+	
+}
+
+
+/**
+ * Renders an image on several processes. Every worker renders one strip of rows with
+ * --region into a partial image, once all of them have finished the strips are merged into
+ * the output and the partial images removed. The workers' standard output is discarded,
+ * their errors are passed through.
+ *
+ * @param job - the render and the workers to split it over
+ * @returns 0 once the image is written, -1 if a worker failed
+ */
+int distribute_render(DistributeJob *job) {
+	char **argv, **paths;
+	char region[64], width[16], height[16];
+	pid_t *pids;
+	int index, workers, first, last, status, failed;
+	
+	workers = job->num_workers;
+	if(workers < 1) {
+		workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		
+	}
+	
+	// Every worker gets at least one row
+	workers = (workers > job->height) ? job->height : workers;
+	workers = (workers < 1) ? 1 : workers;
+	
+	argv = (char **)malloc(sizeof(char *) * (job->num_options + 8));
+	paths = (char **)malloc(sizeof(char *) * workers);
+	pids = (pid_t *)malloc(sizeof(pid_t) * workers);
+	
+	if((argv == NULL) || (paths == NULL) || (pids == NULL)) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	// raytrace [options] --region x0,y0,x1,y1 width height scene partial
+	snprintf(width, sizeof(width), "%d", job->width);
+	snprintf(height, sizeof(height), "%d", job->height);
+	
+	argv[0] = job->program;
+	memcpy(argv + 1, job->options, sizeof(char *) * job->num_options);
+	argv[job->num_options + 1] = "--region";
+	argv[job->num_options + 2] = region;
+	argv[job->num_options + 3] = width;
+	argv[job->num_options + 4] = height;
+	argv[job->num_options + 5] = job->scene;
+	argv[job->num_options + 7] = NULL;
+	
+	fflush(stdout);
+	fflush(stderr);
+	
+	for(index = 0; index < workers; index++) {
+		paths[index] = (char *)malloc(DISTRIBUTE_PATH);
+		if(paths[index] == NULL) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
+			
+		}
+		
+		distribute_path(job->output, index, paths[index], DISTRIBUTE_PATH);
+		
+		// Strip i holds rows height * i / workers up to the next strip's first row
+		first = (int)(((long long)job->height * index) / workers);
+		last = (int)(((long long)job->height * (index + 1)) / workers);
+		snprintf(region, sizeof(region), "0,%d,%d,%d", first, job->width, last);
+		argv[job->num_options + 6] = paths[index];
+		
+		pids[index] = fork();
+		if(pids[index] < 0) {
+			fprintf(stderr, "Error, unable to start worker %d.\n", index);
+			exit(-1);
+			
+		}
+		
+		if(pids[index] == 0) {
+			if(freopen("/dev/null", "w", stdout) == NULL) {
+				_exit(127);
+				
+			}
+			
+			execvp(argv[0], argv);
+			fprintf(stderr, "Error, unable to run '%s'.\n", argv[0]);
+			_exit(127);
+			
+		}
+		
+	}
+	
+	// Wait for every worker, even after one failed, so none is left running
+	failed = 0;
+	for(index = 0; index < workers; index++) {
+		if((waitpid(pids[index], &status, 0) < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+			fprintf(stderr, "Error, worker %d rendering rows %d to %d failed.\n", index, (int)(((long long)job->height * index) / workers), (int)(((long long)job->height * (index + 1)) / workers) - 1);
+			failed = 1;
+			
+		}
+		
+	}
+	
+	if(failed == 0) {
+		merge_regions(job->output, paths, workers);
+		
+	}
+	
+	for(index = 0; index < workers; index++) {
+		remove(paths[index]);
+		free(paths[index]);
+		
+	}
+	
+	free(pids);
+	free(paths);
+	free(argv);
+	
+	return ((failed == 0) ? 0 : -1);
+	
+}
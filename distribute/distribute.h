@@ -0,0 +1,36 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: distribute.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef distribute_h
+	#define distribute_h
+	
+	// Longest path of a partial image, the output path followed by ".partN.ppm"
+	#define DISTRIBUTE_PATH 4096
+	
+	/**
+	 * A render split into horizontal strips of about equal height, one per worker process.
+	 * Every worker runs program with the options given here and a --region for its strip,
+	 * and writes its strip as a partial image next to the output.
+	 */
+	typedef struct DistributeJob {
+		char *program;			//<= raytrace executable the workers run
+		char **options;			//<= render options handed to every worker
+		int num_options;
+		int num_workers;		//<= 0 starts one worker per processor
+		int width, height;
+		char *scene;
+		char *output;
+		
+	} DistributeJob;
+	
+	// function declarations
+	void distribute_path(char *output, int worker, char *path, size_t size);
+	int merge_regions(char *output, char *paths[], int count);
+	int distribute_render(DistributeJob *job);
+	
+#endif
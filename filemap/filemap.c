@@ -0,0 +1,132 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: filemap.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "filemap.h"
+
+/**
+ * Maps a file into memory read only. Files that can not be mapped, such as pipes, are read into
+ * a buffer instead.
+ *
+ * @param path - the file
+ * @param size - receives the size of the file
+ * @param mapped - receives 1 if the file was mapped, 0 if it was read
+ * @returns the contents of the file, NULL if it could not be opened or read, or is a directory
+ */
+char* map_file(const char *path, size_t *size, int *mapped) {
+	struct stat status;
+	char *data;
+	size_t capacity, length;
+	ssize_t count;
+	int fd;
+	
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return (NULL);
+		
+	}
+	
+	// A directory opens fine but only fails once it is read
+	if((fstat(fd, &status) != 0) || S_ISDIR(status.st_mode)) {
+		close(fd);
+		return (NULL);
+		
+	}
+	
+	if(S_ISREG(status.st_mode) && (status.st_size > 0)) {
+		data = (char *)mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		
+		if(data != MAP_FAILED) {
+			// Parsers read the file front to back once
+			madvise(data, status.st_size, MADV_SEQUENTIAL);
+			close(fd);
+			
+			*size = status.st_size;
+			*mapped = 1;
+			return (data);
+			
+		}
+		
+	}
+	
+	// Not a mappable file, read it whole
+	capacity = FILEMAP_BUFFER_SIZE;
+	length = 0;
+	data = (char *)malloc(capacity);
+	
+	while(data != NULL) {
+		if(length == capacity) {
+			capacity = capacity * 2;
+			data = (char *)realloc(data, capacity);
+			if(data == NULL) {
+				break;
+				
+			}
+			
+		}
+		
+		count = read(fd, data + length, capacity - length);
+		if((count < 0) && (errno == EINTR)) {
+			continue;
+			
+		}
+		
+		// A read error is not the end of the file, report it like a file that could not be opened
+		if(count < 0) {
+			free(data);
+			close(fd);
+			return (NULL);
+			
+		}
+		
+		if(count == 0) {
+			break;
+			
+		}
+		length += count;
+		
+	}
+	
+	close(fd);
+	
+	if(data == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	*size = length;
+	*mapped = 0;
+	return (data);
+	
+}
+
+
+/**
+ * Releases a file returned by map_file.
+ *
+ * @param data - contents of the file
+ * @param size - size of the file
+ * @param mapped - 1 if the file was mapped, 0 if it was read
+ */
+void unmap_file(char *data, size_t size, int mapped) {
+	if(mapped != 0) {
+		munmap(data, size);
+		
+	} else {
+		free(data);
+		
+	}
+	
+}
@@ -0,0 +1,21 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: filemap.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef filemap_h
+	#define filemap_h
+	
+	#include <stddef.h>
+	
+	// Initial size in bytes of the buffer a file that can not be mapped is read into
+	#define FILEMAP_BUFFER_SIZE (1 << 16)
+	
+	// function declarations
+	char* map_file(const char *path, size_t *size, int *mapped);
+	void unmap_file(char *data, size_t size, int mapped);
+	
+#endif
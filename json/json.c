@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include "..\arena\arena.h"
 #include "json.h"
 
 // Line number for error checking purposes
@@ -66,10 +67,10 @@ void skip_whitespace(FILE *fpointer) {
  * sequence codes, strings longer then 256 characters, and non-ascii characters. 
  *
  * @param fpointer - file pointer
- * @returns string of characters delimited by "..."
+ * @param buffer - receives the string, holds MAX_STRING characters and the terminator
+ * @returns buffer, the string of characters delimited by "..."
  */
-char *get_string(FILE *fpointer){
-	char buffer[256];
+char *get_string(FILE *fpointer, char *buffer){
 	int token, i = 0;
 	// Read in character advance the stream position indicator
 	token = get_char(fpointer);
@@ -86,7 +87,7 @@ char *get_string(FILE *fpointer){
 		
 		while(token != '"'){
 			 // String exceeds the buffer size
-			if(i > 256) {
+			if(i >= MAX_STRING) {
 				fprintf(stderr, "Error, line number %d; Strings with a length greater than 256 characters are not supported.\n", line_num);
 				// Close file stream flush all buffers
 				fclose(fpointer);
@@ -121,7 +122,7 @@ char *get_string(FILE *fpointer){
 	}
 	 
 	buffer[i] = 0;
-	return strdup(buffer);
+	return buffer;
 	
  }
  
@@ -153,11 +154,10 @@ double get_double(FILE *fpointer){
  * Reads in an array with the format pattern [x, y, z] and parses into an array of doubles.
  *
  * @param fpointer - file pointer
- * @returns an array of double precsion floating point numbers 
+ * @param vector - receives the three double precsion floating point numbers
+ * @returns vector
  */
-double *get_vector(FILE *fpointer){
-	// Allocate memory for vector array of doubles
-	double *vector = malloc(3 * sizeof(double));
+double *get_vector(FILE *fpointer, double vector[]){
 	int token;
 	
 	token = get_char(fpointer);
@@ -303,6 +303,41 @@ void print_scene(Object *objects, int num_objects) {
 } 
  
  
+/**
+ * Returns the arena copy of an object's type string. Scenes use a handful of types, so each is
+ * stored once and shared by every object of that type.
+ *
+ * @param arena - arena the copies are stored in
+ * @param types - the copies made so far
+ * @param num_types - number of copies made so far
+ * @param type - type string read in
+ * @returns the shared copy
+ */
+static char *intern_type(Arena *arena, char **types, int *num_types, char *type) {
+	int index;
+	
+	for(index = 0; index < (*num_types); index++) {
+		if(strcmp(types[index], type) == 0) {
+			return (types[index]);
+			
+		}
+		
+	}
+	
+	// Past the table every further type gets a copy of its own
+	if((*num_types) == MAX_TYPES) {
+		return arena_strdup(arena, type);
+		
+	}
+	
+	types[*num_types] = arena_strdup(arena, type);
+	*num_types = (*num_types) + 1;
+	
+	return (types[(*num_types) - 1]);
+	
+}
+
+
 /**
  * Reads in a scene of objects formatted using JavaScript Object Notation (JSON)
  * - Accepts [ empty scene ]
@@ -311,16 +346,25 @@ void print_scene(Object *objects, int num_objects) {
  * - Accepts comma and non-comma separated name:value pairs
  * - Whitespace insensitive
  *
+ * The object array, the type strings and everything else the scene keeps are allocated from
+ * the arena, the array doubles whenever it fills up so a scene may hold any number of objects.
+ *
  * @param fpointer - file pointer
- * @param objects - an array of Object types
- * @returns integer number of item read-in
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @returns the array of objects read in
  */ 
-int json_read_scene(FILE *fpointer, Object objects[]) {
-	int token, index;
-	double *vector;
-	char *name, *value;
+Object* json_read_scene(FILE *fpointer, Arena *arena, int *num_objects) {
+	int token, index, capacity, num_types;
+	double vector[3];
+	char name[MAX_STRING + 1], value[MAX_STRING + 1];
+	char *types[MAX_TYPES];
+	Object *objects;
 	
 	index = 0;
+	num_types = 0;
+	capacity = INITIAL_OBJECTS;
+	objects = (Object *)arena_alloc(arena, sizeof(Object) * capacity);
 	
 	// Skip whitespace(s) read in the first character
 	skip_whitespace(fpointer);
@@ -352,6 +396,14 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 			
 		}
 		
+		// Double the object array when it is full
+		if(index == capacity) {
+			objects = (Object *)arena_resize(arena, objects, sizeof(Object) * capacity, sizeof(Object) * capacity * 2);
+			capacity = capacity * 2;
+			
+		}
+		memset(&objects[index], 0, sizeof(Object));
+		
 		// Skip whitespace(s), read in the next character and advance the stream position indicator
 		skip_whitespace(fpointer);
 		token = get_char(fpointer);
@@ -365,7 +417,7 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 
 			}
 			
-			name = get_string(fpointer);
+			get_string(fpointer, name);
 			
 			if(strcmp(name, "type") == 0){
 				// Skip whitespace(s), read in the next character
@@ -381,8 +433,8 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 					
 				} else {
 					skip_whitespace(fpointer);
-					value = get_string(fpointer);
-					objects[index].type = value;
+					get_string(fpointer, value);
+					objects[index].type = intern_type(arena, types, &num_types, value);
 					
 				}
 	   
@@ -534,7 +586,7 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 					
 				} else {
 					skip_whitespace(fpointer);
-					vector = get_vector(fpointer);
+					get_vector(fpointer, vector);
 					
 					// Validates against object defintions without a type defined. That is all 
 					// objects and object properties associated to a type value of NULL are ignored
@@ -577,7 +629,7 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 					
 				} else {
 					skip_whitespace(fpointer);
-					vector = get_vector(fpointer);
+					get_vector(fpointer, vector);
 					
 					// Validates against object defintions without a type defined. That is all 
 					// objects and object properties associated to a type value of NULL are ignored
@@ -620,7 +672,7 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 					
 				} else {
 					skip_whitespace(fpointer);
-					vector = get_vector(fpointer);
+					get_vector(fpointer, vector);
 					
 					// Validates against object defintions without a type defined. That is all 
 					// objects and object properties associated to a type value of NULL are ignored
@@ -671,7 +723,7 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 					
 				} else {
 					skip_whitespace(fpointer);
-					vector = get_vector(fpointer);
+					get_vector(fpointer, vector);
 					
 					// Validates against object defintions without a type defined. That is all 
 					// objects and object properties associated to a type value of NULL are ignored
@@ -691,6 +743,11 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 							objects[index].properties.light.position[1] = vector[1];
 							objects[index].properties.light.position[2] = vector[2];
 							
+						} else if(strcmp(objects[index].type, "camera") == 0) {
+							objects[index].properties.camera.position[0] = vector[0];
+							objects[index].properties.camera.position[1] = vector[1];
+							objects[index].properties.camera.position[2] = vector[2];
+							
 						}
 						
 					}
@@ -710,7 +767,7 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 					
 				} else {
 					skip_whitespace(fpointer);
-					vector = get_vector(fpointer);
+					get_vector(fpointer, vector);
 					
 					objects[index].properties.plane.normal[0] = vector[0];
 					objects[index].properties.plane.normal[1] = vector[1];
@@ -731,7 +788,7 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 					
 				} else {
 					skip_whitespace(fpointer);
-					vector = get_vector(fpointer);
+					get_vector(fpointer, vector);
 					
 					objects[index].properties.light.direction[0] = vector[0];
 					objects[index].properties.light.direction[1] = vector[1];
@@ -862,7 +919,8 @@ int json_read_scene(FILE *fpointer, Object objects[]) {
 	
 	} // End-of-While-Loop: Object defintions
 
-	// Return the total number of objects read-in from the scene
-	return (index);
+	// Return the objects and their total number read-in from the scene
+	*num_objects = index;
+	return (objects);
 
 }
\ No newline at end of file
@@ -9,16 +9,25 @@
 #ifndef json_h
 #define json_h
 
-#define MAX_OBJECTS 128
 #define MAX_COLOR 255
 
+// Longest string the parser accepts
+#define MAX_STRING 256
+
+// Object slots allocated before the array first doubles
+#define INITIAL_OBJECTS 64
+
+// Distinct type strings stored once and shared between objects
+#define MAX_TYPES 16
+
 /**
  * Stores values for height and width properties of an camera
- * object
+ * object, and the position of the eye in Euclidean space (x, y, z)
  */
 typedef struct Camera {
 	double width;
 	double height;
+	double position[3];
 	
 } Camera;
 
@@ -97,8 +106,38 @@ typedef struct Object {
 
 } Object;
 
+// Scenes smaller than this are parsed on one thread, splitting them costs more than it saves
+#define PARALLEL_PARSE_SIZE (1 << 20)
+
+// Objects each task of a parallel parse takes at least
+#define PARALLEL_PARSE_OBJECTS 4096
+
+/**
+ * Read position of the in-memory parser. position walks towards end, line counts newlines,
+ * carriage returns and form feeds passed so far for error messages. A cursor with an abort
+ * point belongs to a worker thread and gives up on errors instead of reporting them.
+ */
+typedef struct JsonCursor {
+	const char *position;
+	const char *end;
+	int line;
+	struct JsonAbort *abort;
+	
+} JsonCursor;
+
+// Scene storage, see arena.h
+struct Arena;
+
+// Worker threads, see threadpool.h
+struct ThreadPool;
+
 // function declarations
 void print_scene(Object *objects, int num_objects);
-int json_read_scene(FILE *fpointer, Object objects[]);
+int color_tolerance(double color_v[]);
+Object* json_read_scene(FILE *fpointer, struct Arena *arena, int *num_objects);
+Object* json_parse_scene(const char *data, size_t size, struct Arena *arena, int *num_objects);
+Object* json_parse_scene_parallel(const char *data, size_t size, struct Arena *arena, int *num_objects, struct ThreadPool *pool);
+Object* json_try_parse_scene(const char *data, size_t size, struct Arena *arena, int *num_objects, struct ThreadPool *pool, char *error, size_t error_size);
+Object* json_load_scene(const char *path, struct Arena *arena, int *num_objects);
  
 #endif
\ No newline at end of file
@@ -0,0 +1,1137 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: json_map.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <ctype.h>
+#include "..\arena\arena.h"
+#include "..\filemap\filemap.h"
+#include "..\threadpool\threadpool.h"
+#include "json.h"
+
+/**
+ * Property names the parser knows, resolved by json_key.
+ */
+typedef enum JsonKey {
+	KEY_UNKNOWN,
+	KEY_TYPE,
+	KEY_WIDTH,
+	KEY_HEIGHT,
+	KEY_RADIUS,
+	KEY_RADIAL_A0,
+	KEY_RADIAL_A1,
+	KEY_RADIAL_A2,
+	KEY_ANGULAR_A0,
+	KEY_THETA,
+	KEY_DIFFUSE_COLOR,
+	KEY_SPECULAR_COLOR,
+	KEY_COLOR,
+	KEY_POSITION,
+	KEY_NORMAL,
+	KEY_DIRECTION,
+	KEY_REFLECTIVITY,
+	KEY_REFRACTIVITY,
+	KEY_IOR
+	
+} JsonKey;
+
+/**
+ * Object types the parser assigns properties by, resolved once when the type is read.
+ */
+typedef enum JsonType {
+	JSON_NONE,
+	JSON_CAMERA,
+	JSON_SPHERE,
+	JSON_PLANE,
+	JSON_LIGHT,
+	JSON_OTHER
+	
+} JsonType;
+
+/**
+ * Type strings stored once in the arena and shared by every object of that type.
+ */
+typedef struct TypeTable {
+	char *names[MAX_TYPES];
+	JsonType types[MAX_TYPES];
+	int count;
+	
+} TypeTable;
+
+// Exact powers of ten, products and quotients with them are correctly rounded
+static const double powers_of_ten[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Where a parse that runs on a worker thread returns to on an error. Workers never print or
+ * exit, the scene is parsed again serially to report the error. A parse that must not exit
+ * either, see json_try_parse_scene, returns the message in message instead.
+ */
+typedef struct JsonAbort {
+	jmp_buf jump;
+	char *message;
+	size_t message_size;
+	
+} JsonAbort;
+
+/**
+ * Reports an error in the scene and exits the program, or abandons the parse when it runs on
+ * a worker thread.
+ *
+ * @param cursor - position in the scene
+ * @param status - exit status
+ * @param format - printf style message
+ */
+static void cursor_error(JsonCursor *cursor, int status, const char *format, ...) {
+	va_list arguments;
+	
+	if(cursor->abort != NULL) {
+		if(cursor->abort->message != NULL) {
+			va_start(arguments, format);
+			vsnprintf(cursor->abort->message, cursor->abort->message_size, format, arguments);
+			va_end(arguments);
+			
+		}
+		
+		longjmp(cursor->abort->jump, 1);
+		
+	}
+	
+	va_start(arguments, format);
+	vfprintf(stderr, format, arguments);
+	va_end(arguments);
+	
+	exit(status);
+	
+}
+
+/**
+ * Returns the next character and advances the cursor, counting lines the same way get_char
+ * does. Running off the end of the scene is an error.
+ *
+ * @param cursor - position in the scene
+ * @returns the character
+ */
+static inline int cursor_next(JsonCursor *cursor) {
+	int token;
+	
+	if(cursor->position >= cursor->end) {
+		cursor_error(cursor, -1, "Error, line number %d; unexpected end-of-file.\n", cursor->line);
+		
+	}
+	
+	token = (unsigned char)*cursor->position++;
+	if((token == '\n') || (token == '\r') || (token == '\f')) {
+		cursor->line = cursor->line + 1;
+		
+	}
+	
+	return token;
+	
+}
+
+
+/**
+ * Advances the cursor past whitespace. Like skip_whitespace, reaching the end of the scene is
+ * an error.
+ *
+ * @param cursor - position in the scene
+ */
+static inline void cursor_skip_whitespace(JsonCursor *cursor) {
+	int token;
+	
+	while(cursor->position < cursor->end) {
+		token = (unsigned char)*cursor->position;
+		
+		if((token == ' ') || (token == '\t') || (token == '\v')) {
+			cursor->position++;
+			
+		} else if((token == '\n') || (token == '\r') || (token == '\f')) {
+			cursor->position++;
+			cursor->line = cursor->line + 1;
+			
+		} else {
+			return;
+			
+		}
+		
+	}
+	
+	cursor_error(cursor, -1, "Error, line number %d; unexpected end-of-file.\n", cursor->line);
+	
+}
+
+
+/**
+ * Reads a string delimited by quotation marks without copying it, with the checks get_string
+ * makes.
+ *
+ * @param cursor - position in the scene, at the opening quotation mark
+ * @param length - receives the length of the string
+ * @returns pointer to the first character of the string inside the scene
+ */
+static const char *cursor_string(JsonCursor *cursor, int *length) {
+	const char *start;
+	int token;
+	
+	token = cursor_next(cursor);
+	if(token != '"') {
+		cursor_error(cursor, -1, "Error, line number %d; unexpected character '%c', expected character '%c'.\n", cursor->line, token, '"');
+		
+	}
+	
+	start = cursor->position;
+	token = cursor_next(cursor);
+	
+	while(token != '"') {
+		if(cursor->position - start > MAX_STRING) {
+			cursor_error(cursor, -1, "Error, line number %d; Strings with a length greater than 256 characters are not supported.\n", cursor->line);
+			
+		}
+		
+		if(token == '\\') {
+			cursor_error(cursor, -1, "Error, line number %d; Strings with escape character codes are not supported.\n", cursor->line);
+			
+		}
+		
+		if((token < 32) || (token > 126)) {
+			cursor_error(cursor, -1, "Error, line number %d; Strings can contain ascii characters only.\n", cursor->line);
+			
+		}
+		
+		token = cursor_next(cursor);
+		
+	}
+	
+	*length = (int)(cursor->position - start - 1);
+	return start;
+	
+}
+
+
+/**
+ * Parses a decimal number in place. Numbers with at most 19 significant digits whose value
+ * and power of ten are exactly representable are computed directly, which gives the correctly
+ * rounded result; anything else (long mantissas, large exponents, inf, nan, hex) goes through
+ * strtod, so every number parses exactly as fscanf would have parsed it.
+ *
+ * @param cursor - position in the scene, at the number
+ * @returns the number
+ */
+static double cursor_double(JsonCursor *cursor) {
+	const char *position = cursor->position;
+	const char *end = cursor->end;
+	unsigned long long mantissa = 0;
+	char buffer[64], *stop;
+	int negative = 0, digits = 0, significant = 0, exponent = 0, exponent_sign = 1, exponent_value = 0;
+	int length, sign, hex;
+	double value;
+	
+	if((position < end) && ((*position == '-') || (*position == '+'))) {
+		negative = (*position == '-');
+		position++;
+		
+	}
+	
+	// Integer digits, leading zeros do not count against the mantissa
+	while((position < end) && (*position >= '0') && (*position <= '9')) {
+		if((mantissa != 0) || (*position != '0')) {
+			significant++;
+			
+		}
+		mantissa = mantissa * 10 + (*position - '0');
+		digits++;
+		position++;
+		
+	}
+	
+	// Fraction digits lower the exponent
+	if((position < end) && (*position == '.')) {
+		position++;
+		
+		while((position < end) && (*position >= '0') && (*position <= '9')) {
+			if((mantissa != 0) || (*position != '0')) {
+				significant++;
+				
+			}
+			mantissa = mantissa * 10 + (*position - '0');
+			exponent--;
+			digits++;
+			position++;
+			
+		}
+		
+	}
+	
+	if((digits > 0) && (position < end) && ((*position == 'e') || (*position == 'E'))) {
+		const char *mark = position;
+		
+		position++;
+		if((position < end) && ((*position == '-') || (*position == '+'))) {
+			exponent_sign = (*position == '-') ? -1 : 1;
+			position++;
+			
+		}
+		
+		if((position < end) && (*position >= '0') && (*position <= '9')) {
+			while((position < end) && (*position >= '0') && (*position <= '9')) {
+				if(exponent_value < 100000) {
+					exponent_value = exponent_value * 10 + (*position - '0');
+					
+				}
+				position++;
+				
+			}
+			
+			exponent = exponent + exponent_sign * exponent_value;
+			
+		} else {
+			// An 'e' without digits is not part of the number
+			position = mark;
+			
+		}
+		
+	}
+	
+	// The fast path covers the numbers scenes are made of, hex and other forms go to strtod
+	if((digits > 0) && ((position == end) || ((isalnum((unsigned char)*position) == 0) && (*position != '.'))) && (significant <= 19) && (mantissa <= (1ULL << 53)) && (exponent >= -22) && (exponent <= 22)) {
+		value = (double)mantissa;
+		value = (exponent < 0) ? (value / powers_of_ten[-exponent]) : (value * powers_of_ten[exponent]);
+		
+		cursor->position = position;
+		return negative ? -value : value;
+		
+	}
+	
+	// Let strtod sort out everything else
+	length = 0;
+	while((cursor->position + length < end) && (length < (int)sizeof(buffer) - 1) && (strchr(",]}\" \t\n\r\f\v", cursor->position[length]) == NULL)) {
+		buffer[length] = cursor->position[length];
+		length++;
+		
+	}
+	buffer[length] = '\0';
+	
+	value = strtod(buffer, &stop);
+	if(stop == buffer) {
+		cursor_error(cursor, -1, "Error, line number %d; expected numeric value.\n", cursor->line);
+		
+	}
+	
+	// fscanf also swallows an exponent marker no digits follow, and stops a nan at its parenthesis
+	sign = ((buffer[0] == '-') || (buffer[0] == '+')) ? 1 : 0;
+	hex = (buffer[sign] == '0') && ((buffer[sign + 1] == 'x') || (buffer[sign + 1] == 'X'));
+	if(strncasecmp(buffer + sign, "nan", 3) == 0) {
+		stop = buffer + sign + 3;
+		
+	} else if((hex == 0) ? ((*stop == 'e') || (*stop == 'E')) : ((*stop == 'p') || (*stop == 'P'))) {
+		stop++;
+		if((*stop == '-') || (*stop == '+')) {
+			stop++;
+			
+		}
+		
+	}
+	
+	cursor->position = cursor->position + (stop - buffer);
+	return value;
+	
+}
+
+
+/**
+ * Checks the next character after optional whitespace.
+ *
+ * @param cursor - position in the scene
+ * @param expected - the character expected
+ * @param message - start of the error message
+ * @param status - exit status on error
+ */
+static inline void cursor_expect(JsonCursor *cursor, int expected, const char *message, int status) {
+	int token = cursor_next(cursor);
+	
+	if(token != expected) {
+		cursor_error(cursor, status, "Error, line number %d; %s '%c', expected character '%c'.\n", cursor->line, message, token, expected);
+		
+	}
+	
+}
+
+
+/**
+ * Reads an array with the format pattern [x, y, z], with the checks get_vector makes.
+ *
+ * @param cursor - position in the scene, at the opening bracket
+ * @param vector - receives the three numbers
+ */
+static void cursor_vector(JsonCursor *cursor, double vector[]) {
+	cursor_expect(cursor, '[', "error reading in vector. Unexpected character", -1);
+	cursor_skip_whitespace(cursor);
+	vector[0] = cursor_double(cursor);
+	cursor_skip_whitespace(cursor);
+	cursor_expect(cursor, ',', "error reading in vector. Unexpected character", -1);
+	cursor_skip_whitespace(cursor);
+	vector[1] = cursor_double(cursor);
+	cursor_skip_whitespace(cursor);
+	cursor_expect(cursor, ',', "unexpected character", -1);
+	cursor_skip_whitespace(cursor);
+	vector[2] = cursor_double(cursor);
+	cursor_skip_whitespace(cursor);
+	cursor_expect(cursor, ']', "unexpected character", -1);
+	
+}
+
+
+/**
+ * Resolves a property name with a switch on its length and characters instead of a chain of
+ * string comparisons.
+ *
+ * @param name - the name, not terminated
+ * @param length - length of the name
+ * @returns the key, KEY_UNKNOWN for names the parser does not know
+ */
+static JsonKey json_key(const char *name, int length) {
+	switch(length) {
+		case 3:
+			return (memcmp(name, "ior", 3) == 0) ? KEY_IOR : KEY_UNKNOWN;
+			
+		case 4:
+			return (memcmp(name, "type", 4) == 0) ? KEY_TYPE : KEY_UNKNOWN;
+			
+		case 5:
+			switch(name[0]) {
+				case 'w': return (memcmp(name, "width", 5) == 0) ? KEY_WIDTH : KEY_UNKNOWN;
+				case 't': return (memcmp(name, "theta", 5) == 0) ? KEY_THETA : KEY_UNKNOWN;
+				case 'c': return (memcmp(name, "color", 5) == 0) ? KEY_COLOR : KEY_UNKNOWN;
+				
+			}
+			return KEY_UNKNOWN;
+			
+		case 6:
+			switch(name[0]) {
+				case 'h': return (memcmp(name, "height", 6) == 0) ? KEY_HEIGHT : KEY_UNKNOWN;
+				case 'r': return (memcmp(name, "radius", 6) == 0) ? KEY_RADIUS : KEY_UNKNOWN;
+				case 'n': return (memcmp(name, "normal", 6) == 0) ? KEY_NORMAL : KEY_UNKNOWN;
+				
+			}
+			return KEY_UNKNOWN;
+			
+		case 8:
+			return (memcmp(name, "position", 8) == 0) ? KEY_POSITION : KEY_UNKNOWN;
+			
+		case 9:
+			if(memcmp(name, "radial-a", 8) == 0) {
+				switch(name[8]) {
+					case '0': return KEY_RADIAL_A0;
+					case '1': return KEY_RADIAL_A1;
+					case '2': return KEY_RADIAL_A2;
+					
+				}
+				return KEY_UNKNOWN;
+				
+			}
+			return (memcmp(name, "direction", 9) == 0) ? KEY_DIRECTION : KEY_UNKNOWN;
+			
+		case 10:
+			return (memcmp(name, "angular-a0", 10) == 0) ? KEY_ANGULAR_A0 : KEY_UNKNOWN;
+			
+		case 12:
+			if(memcmp(name, "ref", 3) == 0) {
+				switch(name[3]) {
+					case 'l': return (memcmp(name, "reflectivity", 12) == 0) ? KEY_REFLECTIVITY : KEY_UNKNOWN;
+					case 'r': return (memcmp(name, "refractivity", 12) == 0) ? KEY_REFRACTIVITY : KEY_UNKNOWN;
+					
+				}
+				
+			}
+			return KEY_UNKNOWN;
+			
+		case 13:
+			return (memcmp(name, "diffuse_color", 13) == 0) ? KEY_DIFFUSE_COLOR : KEY_UNKNOWN;
+			
+		case 14:
+			return (memcmp(name, "specular_color", 14) == 0) ? KEY_SPECULAR_COLOR : KEY_UNKNOWN;
+			
+	}
+	
+	return KEY_UNKNOWN;
+	
+}
+
+
+/**
+ * Returns the shared arena copy of a type string and its resolved type.
+ *
+ * @param arena - arena the copies are stored in
+ * @param table - the copies made so far
+ * @param name - the type string, not terminated
+ * @param length - length of the type string
+ * @param type - receives the resolved type
+ * @returns the shared copy
+ */
+static char *intern_span(Arena *arena, TypeTable *table, const char *name, int length, JsonType *type) {
+	char *copy;
+	int index;
+	
+	for(index = 0; index < table->count; index++) {
+		if((strncmp(table->names[index], name, length) == 0) && (table->names[index][length] == '\0')) {
+			*type = table->types[index];
+			return (table->names[index]);
+			
+		}
+		
+	}
+	
+	copy = (char *)arena_alloc(arena, length + 1);
+	memcpy(copy, name, length);
+	copy[length] = '\0';
+	
+	if(strcmp(copy, "camera") == 0) {
+		*type = JSON_CAMERA;
+		
+	} else if(strcmp(copy, "sphere") == 0) {
+		*type = JSON_SPHERE;
+		
+	} else if(strcmp(copy, "plane") == 0) {
+		*type = JSON_PLANE;
+		
+	} else if(strcmp(copy, "light") == 0) {
+		*type = JSON_LIGHT;
+		
+	} else {
+		*type = JSON_OTHER;
+		
+	}
+	
+	// Past the table every further type keeps a copy of its own
+	if(table->count < MAX_TYPES) {
+		table->names[table->count] = copy;
+		table->types[table->count] = *type;
+		table->count++;
+		
+	}
+	
+	return (copy);
+	
+}
+
+
+/**
+ * Stores a color array, checking the 0 to 1.0 tolerance first.
+ *
+ * @param cursor - position in the scene, for errors
+ * @param object - the object
+ * @param destination - the color array of the object, NULL when the type has none
+ * @param vector - the color read in
+ */
+static void store_color(JsonCursor *cursor, Object *object, double *destination, double vector[]) {
+	if(color_tolerance(vector) != 1) {
+		cursor_error(cursor, -1, "Error, invalid color tolerance in %s color array.\n", object->type);
+		
+	}
+	
+	// Only spheres and planes keep their colors
+	if(destination == NULL) {
+		return;
+		
+	}
+	
+	destination[0] = vector[0];
+	destination[1] = vector[1];
+	destination[2] = vector[2];
+	
+}
+
+
+/**
+ * Parses the name/value pairs of one object, assigning properties by the rules of
+ * json_read_scene. Properties that do not apply to the object's type are read and ignored.
+ *
+ * @param cursor - position in the scene, just past the opening brace
+ * @param object - zeroed object that receives the properties
+ * @param arena - arena type strings are stored in
+ * @param table - shared type strings
+ */
+static void parse_object(JsonCursor *cursor, Object *object, Arena *arena, TypeTable *table) {
+	JsonType type = JSON_NONE;
+	const char *name, *value;
+	double vector[3], number;
+	int token, length;
+	JsonKey key;
+	
+	cursor_skip_whitespace(cursor);
+	token = cursor_next(cursor);
+	
+	while(token != '}') {
+		// Anything but a quotation mark is taken as the opening of the name, as get_string does
+		if(token == '"') {
+			cursor->position--;
+			
+		}
+		name = cursor_string(cursor, &length);
+		key = json_key(name, length);
+		
+		if(key == KEY_UNKNOWN) {
+			cursor_error(cursor, -1, "Error, line number %d; invalid type '%.*s'.\n", cursor->line, length, name);
+			
+		}
+		
+		cursor_skip_whitespace(cursor);
+		if((key == KEY_DIFFUSE_COLOR) || (key == KEY_SPECULAR_COLOR) || (key == KEY_NORMAL) || (key == KEY_DIRECTION)) {
+			cursor_expect(cursor, ':', "unexpected character", -1);
+			
+		} else {
+			cursor_expect(cursor, ':', "invalid separator", ((key == KEY_TYPE) || (key == KEY_WIDTH) || (key == KEY_HEIGHT)) ? -3 : -1);
+			
+		}
+		cursor_skip_whitespace(cursor);
+		
+		switch(key) {
+			case KEY_TYPE:
+				value = cursor_string(cursor, &length);
+				object->type = intern_span(arena, table, value, length, &type);
+				break;
+				
+			case KEY_DIFFUSE_COLOR:
+			case KEY_SPECULAR_COLOR:
+			case KEY_COLOR:
+			case KEY_POSITION:
+			case KEY_NORMAL:
+			case KEY_DIRECTION:
+				cursor_vector(cursor, vector);
+				
+				if(key == KEY_NORMAL) {
+					memcpy(object->properties.plane.normal, vector, sizeof(vector));
+					
+				} else if(key == KEY_DIRECTION) {
+					memcpy(object->properties.light.direction, vector, sizeof(vector));
+					
+				} else if(type == JSON_NONE) {
+					// Properties of objects without a type are ignored
+					
+				} else if(key == KEY_POSITION) {
+					if(type == JSON_SPHERE) {
+						memcpy(object->properties.sphere.position, vector, sizeof(vector));
+						
+					} else if(type == JSON_PLANE) {
+						memcpy(object->properties.plane.position, vector, sizeof(vector));
+						
+					} else if(type == JSON_LIGHT) {
+						memcpy(object->properties.light.position, vector, sizeof(vector));
+						
+					} else if(type == JSON_CAMERA) {
+						memcpy(object->properties.camera.position, vector, sizeof(vector));
+						
+					}
+					
+				} else if((key == KEY_COLOR) && (type == JSON_LIGHT)) {
+					memcpy(object->properties.light.color, vector, sizeof(vector));
+					
+				} else if(key == KEY_COLOR) {
+					store_color(cursor, object, (type == JSON_PLANE) ? object->properties.plane.color : ((type == JSON_SPHERE) ? object->properties.sphere.color : NULL), vector);
+					
+				} else if(key == KEY_DIFFUSE_COLOR) {
+					store_color(cursor, object, (type == JSON_PLANE) ? object->properties.plane.diffuse_color : ((type == JSON_SPHERE) ? object->properties.sphere.diffuse_color : NULL), vector);
+					
+				} else {
+					store_color(cursor, object, (type == JSON_PLANE) ? object->properties.plane.specular_color : ((type == JSON_SPHERE) ? object->properties.sphere.specular_color : NULL), vector);
+					
+				}
+				break;
+				
+			default:
+				// Like json_read_scene, material values of other types are not even read
+				if(((key == KEY_REFLECTIVITY) || (key == KEY_REFRACTIVITY) || (key == KEY_IOR)) && (type != JSON_SPHERE) && (type != JSON_PLANE)) {
+					break;
+					
+				}
+				
+				number = cursor_double(cursor);
+				
+				switch(key) {
+					case KEY_WIDTH: object->properties.camera.width = number; break;
+					case KEY_HEIGHT: object->properties.camera.height = number; break;
+					case KEY_RADIUS: object->properties.sphere.radius = number; break;
+					case KEY_RADIAL_A0: object->properties.light.radial_a0 = number; break;
+					case KEY_RADIAL_A1: object->properties.light.radial_a1 = number; break;
+					case KEY_RADIAL_A2: object->properties.light.radial_a2 = number; break;
+					case KEY_ANGULAR_A0: object->properties.light.angular_a0 = number; break;
+					case KEY_THETA: object->properties.light.theta = number; break;
+					
+					case KEY_REFLECTIVITY:
+						if(type == JSON_SPHERE) {
+							object->properties.sphere.reflectivity = number;
+							
+						} else {
+							object->properties.plane.reflectivity = number;
+							
+						}
+						break;
+						
+					case KEY_REFRACTIVITY:
+						if(type == JSON_SPHERE) {
+							object->properties.sphere.refractivity = number;
+							
+						} else {
+							object->properties.plane.refractivity = number;
+							
+						}
+						break;
+						
+					case KEY_IOR:
+						if(type == JSON_SPHERE) {
+							object->properties.sphere.ior = number;
+							
+						} else {
+							object->properties.plane.ior = number;
+							
+						}
+						break;
+						
+					default:
+						break;
+						
+				}
+				break;
+				
+		}
+		
+		cursor_skip_whitespace(cursor);
+		token = cursor_next(cursor);
+		
+		if(token == ',') {
+			cursor_skip_whitespace(cursor);
+			token = cursor_next(cursor);
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Parses a scene held in memory on the calling thread.
+ *
+ * @param data - the scene, need not be terminated
+ * @param size - size of the scene in bytes
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @param abort - where errors return to, NULL to report them and exit
+ * @returns the array of objects read in
+ */
+static Object* parse_scene(const char *data, size_t size, Arena *arena, int *num_objects, JsonAbort *abort) {
+	JsonCursor cursor;
+	TypeTable table;
+	Object *objects;
+	int token, index, capacity;
+	
+	cursor.position = data;
+	cursor.end = data + size;
+	cursor.line = 0;
+	cursor.abort = abort;
+	table.count = 0;
+	
+	index = 0;
+	capacity = INITIAL_OBJECTS;
+	objects = (Object *)arena_alloc(arena, sizeof(Object) * capacity);
+	
+	cursor_skip_whitespace(&cursor);
+	cursor_expect(&cursor, '[', "invalid scene definition", -2);
+	
+	cursor_skip_whitespace(&cursor);
+	token = cursor_next(&cursor);
+	
+	while(token != ']') {
+		if(token != '{') {
+			cursor_error(&cursor, -2, "Error, line number %d; invalid object definition '%c', expected character '%c'.\n", cursor.line, token, '{');
+			
+		}
+		
+		// Double the object array when it is full
+		if(index == capacity) {
+			objects = (Object *)arena_resize(arena, objects, sizeof(Object) * capacity, sizeof(Object) * capacity * 2);
+			capacity = capacity * 2;
+			
+		}
+		memset(&objects[index], 0, sizeof(Object));
+		
+		parse_object(&cursor, &objects[index], arena, &table);
+		index = index + 1;
+		
+		cursor_skip_whitespace(&cursor);
+		token = cursor_next(&cursor);
+		
+		if(token == ',') {
+			cursor_skip_whitespace(&cursor);
+			token = cursor_next(&cursor);
+			
+		}
+		
+	}
+	
+	*num_objects = index;
+	return (objects);
+	
+}
+
+
+/**
+ * Parses a scene held in memory, accepting the same documents as json_read_scene and producing
+ * the same objects and error messages. Nothing is copied out of the scene except the type
+ * strings, which are stored once each.
+ *
+ * @param data - the scene, need not be terminated
+ * @param size - size of the scene in bytes
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @returns the array of objects read in
+ */
+Object* json_parse_scene(const char *data, size_t size, Arena *arena, int *num_objects) {
+	return parse_scene(data, size, arena, num_objects, NULL);
+	
+}
+
+
+/**
+ * Object ranges of a parallel parse. Every task parses a contiguous run of objects straight
+ * into its slots of the shared array, so the objects come out in file order without a merge.
+ */
+typedef struct ParseJob {
+	const char *data;
+	const char *end;
+	size_t *bounds;
+	Object *objects;
+	int num_objects;
+	int num_tasks;
+	TypeTable *types;
+	Arena *arenas;
+	int *failed;
+	
+} ParseJob;
+
+/**
+ * Returns the first character at or after position that is not whitespace.
+ *
+ * @param position - start of the search
+ * @param end - end of the scene
+ * @returns the character's position, end if there is none
+ */
+static const char *scan_whitespace(const char *position, const char *end) {
+	while((position < end) && ((*position == ' ') || (*position == '\t') || (*position == '\v') || (*position == '\n') || (*position == '\r') || (*position == '\f'))) {
+		position++;
+		
+	}
+	
+	return (position);
+	
+}
+
+
+/**
+ * Finds where every object of the top-level array begins and ends without parsing it. Only
+ * braces, quotation marks and the separators between objects are looked at, strings are
+ * skipped whole so braces inside them do not count.
+ *
+ * @param data - the scene
+ * @param size - size of the scene in bytes
+ * @param count - receives the number of objects found
+ * @returns offsets of each object's opening and closing brace, two per object, to be freed by
+ *          the caller; NULL for empty scenes and anything but an array of flat objects, which
+ *          are left to the serial parser to read or report
+ */
+static size_t *scan_objects(const char *data, size_t size, int *count) {
+	const char *position, *end = data + size;
+	size_t *bounds = NULL, *grown;
+	int found = 0, capacity = 0;
+	
+	position = scan_whitespace(data, end);
+	if((position == end) || (*position != '[')) {
+		return (NULL);
+		
+	}
+	position = scan_whitespace(position + 1, end);
+	
+	while((position < end) && (*position == '{')) {
+		if(found == capacity) {
+			capacity = (capacity == 0) ? INITIAL_OBJECTS : (capacity * 2);
+			grown = (size_t *)realloc(bounds, sizeof(size_t) * 2 * capacity);
+			if(grown == NULL) {
+				fprintf(stderr, "Failed to allocate memory.\n");
+				exit(-1);
+				
+			}
+			bounds = grown;
+			
+		}
+		bounds[2 * found] = position - data;
+		
+		// Objects hold no objects of their own, the first closing brace ends them
+		for(position++; (position < end) && (*position != '}'); position++) {
+			if(*position == '"') {
+				position = (const char *)memchr(position + 1, '"', end - position - 1);
+				
+			} else if(*position == '{') {
+				position = NULL;
+				
+			}
+			
+			if(position == NULL) {
+				free(bounds);
+				return (NULL);
+				
+			}
+			
+		}
+		
+		if(position == end) {
+			free(bounds);
+			return (NULL);
+			
+		}
+		bounds[2 * found + 1] = position - data;
+		found++;
+		
+		// A comma between objects is optional
+		position = scan_whitespace(position + 1, end);
+		if((position < end) && (*position == ',')) {
+			position = scan_whitespace(position + 1, end);
+			
+		}
+		
+	}
+	
+	if((found == 0) || (position == end) || (*position != ']')) {
+		free(bounds);
+		return (NULL);
+		
+	}
+	
+	*count = found;
+	return (bounds);
+	
+}
+
+
+/**
+ * Parses one run of objects on a worker thread. Type strings the shared table does not hold
+ * yet go to the task's own arena. An error marks the task failed and abandons the run.
+ *
+ * @param context - the ParseJob
+ * @param task - index of the run
+ * @param thread_id - worker running the task, unused
+ */
+static void parse_task(void *context, int task, int thread_id) {
+	ParseJob *job = (ParseJob *)context;
+	JsonAbort abort;
+	JsonCursor cursor;
+	TypeTable table;
+	int index, first, last;
+	
+	first = (int)(((long long)job->num_objects * task) / job->num_tasks);
+	last = (int)(((long long)job->num_objects * (task + 1)) / job->num_tasks);
+	
+	table = *job->types;
+	cursor.end = job->end;
+	cursor.line = 0;
+	cursor.abort = &abort;
+	abort.message = NULL;
+	
+	if(setjmp(abort.jump) != 0) {
+		job->failed[task] = 1;
+		return;
+		
+	}
+	
+	for(index = first; index < last; index++) {
+		cursor.position = job->data + job->bounds[2 * index] + 1;
+		parse_object(&cursor, &job->objects[index], &job->arenas[task], &table);
+		
+		// The parser must agree with the scan on where the object ends
+		if(cursor.position != job->data + job->bounds[2 * index + 1] + 1) {
+			job->failed[task] = 1;
+			return;
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Parses a scene held in memory across a thread pool. A quick scan finds the objects of the
+ * top-level array, then runs of objects are parsed independently straight into the arena's
+ * object array. Small scenes, scenes the scan does not understand and scenes with errors are
+ * handed to the serial parser, so the objects and any error message are exactly those of the
+ * serial parser.
+ *
+ * @param data - the scene, need not be terminated
+ * @param size - size of the scene in bytes
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @param pool - worker threads, NULL to parse on the calling thread
+ * @param abort - where errors of the serial parser return to, NULL to report them and exit
+ * @returns the array of objects read in
+ */
+static Object* parse_scene_parallel(const char *data, size_t size, Arena *arena, int *num_objects, ThreadPool *pool, JsonAbort *abort) {
+	TypeTable types;
+	ParseJob job;
+	JsonType type;
+	int task, failed;
+	
+	if((pool == NULL) || (size < PARALLEL_PARSE_SIZE)) {
+		return parse_scene(data, size, arena, num_objects, abort);
+		
+	}
+	
+	job.bounds = scan_objects(data, size, &job.num_objects);
+	if(job.bounds == NULL) {
+		return parse_scene(data, size, arena, num_objects, abort);
+		
+	}
+	
+	// A few runs per worker so stealing can even out uneven objects
+	job.num_tasks = job.num_objects / PARALLEL_PARSE_OBJECTS;
+	if(job.num_tasks > pool->num_threads * 4) {
+		job.num_tasks = pool->num_threads * 4;
+		
+	} else if(job.num_tasks < 1) {
+		job.num_tasks = 1;
+		
+	}
+	
+	// The usual types are stored once up front and shared by every task
+	types.count = 0;
+	intern_span(arena, &types, "camera", 6, &type);
+	intern_span(arena, &types, "sphere", 6, &type);
+	intern_span(arena, &types, "plane", 5, &type);
+	intern_span(arena, &types, "light", 5, &type);
+	
+	job.data = data;
+	job.end = data + size;
+	job.types = &types;
+	job.objects = (Object *)arena_alloc(arena, sizeof(Object) * job.num_objects);
+	job.arenas = (Arena *)malloc(sizeof(Arena) * job.num_tasks);
+	job.failed = (int *)calloc(job.num_tasks, sizeof(int));
+	if((job.arenas == NULL) || (job.failed == NULL)) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	for(task = 0; task < job.num_tasks; task++) {
+		arena_init(&job.arenas[task]);
+		
+	}
+	
+	threadpool_run(pool, parse_task, &job, job.num_tasks);
+	
+	// Whatever the tasks allocated now belongs to the scene
+	failed = 0;
+	for(task = 0; task < job.num_tasks; task++) {
+		failed = failed | job.failed[task];
+		arena_merge(arena, &job.arenas[task]);
+		
+	}
+	
+	free(job.bounds);
+	free(job.arenas);
+	free(job.failed);
+	
+	// Let the serial parser find and report the first error
+	if(failed != 0) {
+		return parse_scene(data, size, arena, num_objects, abort);
+		
+	}
+	
+	*num_objects = job.num_objects;
+	return (job.objects);
+	
+}
+
+
+/**
+ * Parses a scene held in memory across a thread pool, see parse_scene_parallel.
+ *
+ * @param data - the scene, need not be terminated
+ * @param size - size of the scene in bytes
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @param pool - worker threads, NULL to parse on the calling thread
+ * @returns the array of objects read in
+ */
+Object* json_parse_scene_parallel(const char *data, size_t size, Arena *arena, int *num_objects, ThreadPool *pool) {
+	return parse_scene_parallel(data, size, arena, num_objects, pool, NULL);
+	
+}
+
+
+/**
+ * Parses a scene like json_parse_scene_parallel but returns on errors instead of exiting, for
+ * processes that outlive a bad scene. Whatever the failed parse allocated stays in the arena.
+ *
+ * @param data - the scene, need not be terminated
+ * @param size - size of the scene in bytes
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @param pool - worker threads, NULL to parse on the calling thread
+ * @param error - receives the message of an error, the one json_parse_scene would print
+ * @param error_size - size of the error buffer
+ * @returns the array of objects read in, NULL if the scene has an error
+ */
+Object* json_try_parse_scene(const char *data, size_t size, Arena *arena, int *num_objects, ThreadPool *pool, char *error, size_t error_size) {
+	JsonAbort abort;
+	
+	abort.message = error;
+	abort.message_size = error_size;
+	
+	if(setjmp(abort.jump) != 0) {
+		return (NULL);
+		
+	}
+	
+	return parse_scene_parallel(data, size, arena, num_objects, pool, &abort);
+	
+}
+
+
+/**
+ * Maps a json scene file and parses it in place.
+ *
+ * @param path - the scene file
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @returns the array of objects read in
+ */
+Object* json_load_scene(const char *path, Arena *arena, int *num_objects) {
+	Object *objects;
+	char *data;
+	size_t size;
+	int mapped;
+	
+	data = map_file(path, &size, &mapped);
+	if(data == NULL) {
+		fprintf(stderr, "Error, could not open file.\n");
+		exit(-1);
+		
+	}
+	
+	// Objects keep no pointers into the file, it can go as soon as it is parsed
+	objects = json_parse_scene(data, size, arena, num_objects);
+	unmap_file(data, size, mapped);
+	
+	return (objects);
+	
+}
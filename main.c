@@ -5,18 +5,411 @@
  * File: main.c
  * Copyright © 2016 All rights reserved
  */
- 
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include "math\real.h"
 #include "ppm\ppm.h"
+#include "arena\arena.h"
 #include "json\json.h"
+#include "filemap\filemap.h"
+#include "threadpool\threadpool.h"
+#include "scene\scene.h"
+#include "simd\simd.h"
+#include "bvh\bvh.h"
 #include "raycaster\raycaster.h"
+#include "wavefront\wavefront.h"
+#include "progressive\progressive.h"
+#include "stats\stats.h"
+#include "stream\stream.h"
+#include "mip\mip.h"
+#include "animation\animation.h"
+#include "server\server.h"
+#include "distribute\distribute.h"
+
+/**
+ * Checks that a command line argument only contains digits.
+ *
+ * @param argument - command line argument
+ * @returns 1 if the argument is a non-negative number, 0 otherwise
+ */
+int is_number(char *argument) {
+	int count;
+	
+	if(strlen(argument) == 0) {
+		return (0);
+		
+	}
+	
+	for(count = 0; count < strlen(argument); count++) {
+		if((!(isdigit(argument[count]))) && (argument[count] != '.')){
+			return (0);
+			
+		}
+		
+	}
+	
+	return (1);
+	
+}
+
+
+/**
+ * Checks whether a path names a compiled scene file by its .rtb extension.
+ *
+ * @param path - the path
+ * @returns 1 for compiled scene files, 0 otherwise
+ */
+int is_scene_file(char *path) {
+	size_t length = strlen(path);
+	
+	return ((length > 4) && (strcmp(path + length - 4, ".rtb") == 0));
+	
+}
+
+
+/**
+ * Parses a json scene, compiles it and builds its bounding volume hierarchy, and writes the
+ * result to a compiled scene file that later renders map instead of parsing.
+ *
+ * Usage: raytrace compile [--no-bvh] [--threads n] input.json output.rtb
+ *
+ * @param argc - number of arguments following the compile command
+ * @param argv - the arguments following the compile command
+ * @returns 0 once the file is written
+ */
+int compile_scene(int argc, char *argv[]) {
+	int index, num_objects, num_threads, use_bvh, mapped;
+	ThreadPool *pool;
+	Arena arena;
+	Object *objects;
+	Scene *scene;
+	char *data;
+	size_t size;
+	
+	num_threads = 1;
+	use_bvh = 1;
+	pool = NULL;
+	
+	for(index = 0; (index < argc) && (argv[index][0] == '-'); index++) {
+		if((strcmp(argv[index], "--threads") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			num_threads = atoi(argv[++index]);
+			
+		} else if(strcmp(argv[index], "--no-bvh") == 0) {
+			use_bvh = 0;
+			
+		} else {
+			fprintf(stderr, "Error, unknown or incomplete option '%s'.\n", argv[index]);
+			exit(-1);
+			
+		}
+		
+	}
+	
+	if(argc - index != 2) {
+		fprintf(stderr, "Error, incorrect usage!\nCorrect usage pattern is: raytrace compile [--no-bvh] [--threads n] input.json output.rtb.\n");
+		exit(-1);
+		
+	}
+	
+	data = map_file(argv[index], &size, &mapped);
+	if(data == NULL) {
+		fprintf(stderr, "Error, could not open file.\n");
+		exit(-1);
+		
+	}
+	
+	if(num_threads != 1) {
+		pool = threadpool_create(num_threads);
+		
+	}
+	
+	arena_init(&arena);
+	objects = json_parse_scene_parallel(data, size, &arena, &num_objects, pool);
+	unmap_file(data, size, mapped);
+	
+	if(pool != NULL) {
+		threadpool_destroy(pool);
+		
+	}
+	
+	scene = scene_create(objects, num_objects, use_bvh);
+	size = scene_write_file(scene, argv[index + 1]);
+	
+	printf("Compiled %d objects (%d spheres, %d planes, %d lights) into %s, %zu bytes.\n", num_objects, scene->spheres.count, scene->planes.count, scene->num_lights, argv[index + 1], size);
+	
+	scene_free(scene);
+	arena_free(&arena);
+	
+	return (0);
+	
+}
+
+
+/**
+ * Renders a keyframed animation in one process. The keyframes are parsed once, the scene is
+ * compiled once from the first frame and every further frame only updates its compiled
+ * arrays and refits the bounding volume hierarchy, which is built again when refitting has
+ * made it too slow. The same worker threads render every frame.
+ *
+ * Usage: raytrace animate [options] width height key0.json [key1.json ...] output.ppm
+ *
+ * @param argc - number of arguments following the animate command
+ * @param argv - the arguments following the animate command
+ * @returns 0 once every frame is written
+ */
+int animate_scene(int argc, char *argv[]) {
+	int index, frame, num_frames, num_threads, tile_size, wavefront, use_bvh;
+	int num_keys, refits, rebuilds;
+	double refit_limit, build_cost, start, frame_time;
+	RenderSettings settings;
+	Animation *animation;
+	ThreadPool *pool;
+	Scene *scene;
+	Image image;
+	char *path;
+	
+	num_frames = 1;
+	num_threads = 1;
+	tile_size = DEFAULT_TILE_SIZE;
+	wavefront = 0;
+	use_bvh = 1;
+	refit_limit = DEFAULT_REFIT_LIMIT;
+	pool = NULL;
+	
+	settings.max_depth = DEFAULT_MAX_DEPTH;
+	settings.min_weight = DEFAULT_MIN_WEIGHT;
+	settings.roulette = 0;
+	settings.max_samples = 1;
+	settings.peak_stack = 0;
+	settings.samples = 0;
+	
+	for(index = 0; (index < argc) && (argv[index][0] == '-'); index++) {
+		if((strcmp(argv[index], "--frames") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			num_frames = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--threads") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			num_threads = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--tile-size") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			tile_size = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--max-depth") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			settings.max_depth = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--min-weight") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			settings.min_weight = atof(argv[++index]);
+			
+		} else if(strcmp(argv[index], "--roulette") == 0) {
+			settings.roulette = 1;
+			
+		} else if((strcmp(argv[index], "--aa") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			settings.max_samples = atoi(argv[++index]);
+			
+		} else if(strcmp(argv[index], "--wavefront") == 0) {
+			wavefront = 1;
+			
+		} else if(strcmp(argv[index], "--no-bvh") == 0) {
+			use_bvh = 0;
+			
+		} else if((strcmp(argv[index], "--refit-limit") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			refit_limit = atof(argv[++index]);
+			
+		} else {
+			fprintf(stderr, "Error, unknown or incomplete option '%s'.\n", argv[index]);
+			exit(-1);
+			
+		}
+		
+	}
+	
+	num_keys = argc - index - 3;
+	if((num_keys < 1) || (num_frames < 1) || (is_number(argv[index]) == 0) || (is_number(argv[index + 1]) == 0)) {
+		fprintf(stderr, "Error, incorrect usage!\nCorrect usage pattern is: raytrace animate [options] width height key0.json [key1.json ...] output.ppm.\n");
+		exit(-1);
+		
+	}
+	
+	if((settings.max_samples > 1) && (wavefront != 0)) {
+		fprintf(stderr, "Error, --aa can not be combined with --wavefront.\n");
+		exit(-1);
+		
+	}
+	
+	image.magic_number = "P6";
+	image.width = atoi(argv[index]);
+	image.height = atoi(argv[index + 1]);
+	image.max_color = MAX_COLOR;
+	image.band_start = 0;
+	image.band_height = image.height;
+	image.band_left = 0;
+	image.band_width = image.width;
+	image.image_data = (Pixel *)malloc(sizeof(Pixel) * image.width * image.height);
+	if(image.image_data == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	if(num_threads != 1) {
+		pool = threadpool_create(num_threads);
+		
+	}
+	
+	start = wall_clock();
+	animation = animation_load(argv + index + 2, num_keys, pool);
+	simd_init("auto");
+	
+	scene = scene_create(animation->objects, animation->num_objects, use_bvh);
+	build_cost = (scene->bvh != NULL) ? bvh_cost(scene->bvh) : 0;
+	refits = rebuilds = 0;
+	
+	printf("Loaded %d keyframes of %d objects in %lf ms.\n", num_keys, animation->num_objects, (wall_clock() - start) * 1000.0);
+	
+	for(frame = 0; frame < num_frames; frame++) {
+		frame_time = wall_clock();
+		
+		// Only the compiled values change between frames, the hierarchy keeps its shape
+		if(frame > 0) {
+			animation_frame(animation, frame, num_frames);
+			scene_update(scene);
+			
+			if(scene->bvh != NULL) {
+				bvh_refit(scene->bvh, scene);
+				refits = refits + 1;
+				
+				if(bvh_cost(scene->bvh) > build_cost * refit_limit) {
+					bvh_free(scene->bvh);
+					scene->bvh = bvh_build(scene);
+					build_cost = bvh_cost(scene->bvh);
+					rebuilds = rebuilds + 1;
+					
+				}
+				
+			}
+			
+		}
+		
+		render_image(scene, &image, pool, tile_size, wavefront, &settings);
+		
+		path = animation_path(argv[argc - 1], frame, num_frames);
+		if(is_png_file(path) != 0) {
+			write_png_image(path, &image, pool);
+			
+		} else {
+			write_p6_image(path, &image);
+			
+		}
+		
+		printf("Frame %d: %s, %lf ms\n", frame, path, (wall_clock() - frame_time) * 1000.0);
+		free(path);
+		
+	}
+	
+	printf("Rendered %d frames in %lf ms, hierarchy refit %d times and built again %d times.\n", num_frames, (wall_clock() - start) * 1000.0, refits, rebuilds);
+	
+	scene_free(scene);
+	animation_free(animation);
+	free(image.image_data);
+	
+	if(pool != NULL) {
+		threadpool_destroy(pool);
+		
+	}
+	
+	return (0);
+	
+}
+
+
+/**
+ * Assembles the partial images of renders of regions into the whole image.
+ *
+ * Usage: raytrace merge output.ppm part.ppm [part.ppm ...]
+ *
+ * @param argc - number of arguments following the merge command
+ * @param argv - the arguments following the merge command
+ * @returns 0 once the image is written
+ */
+int merge_images(int argc, char *argv[]) {
+	if(argc < 2) {
+		fprintf(stderr, "Error, incorrect usage!\nCorrect usage pattern is: raytrace merge output.ppm part.ppm [part.ppm ...].\n");
+		exit(-1);
+		
+	}
+	
+	return merge_regions(argv[0], argv + 1, argc - 1);
+	
+}
+
+
+/**
+ * Renders an image on several worker processes of this program, each rendering a strip of
+ * rows with --region, and merges their strips into the output. Every option other than
+ * --workers is handed on to the workers.
+ *
+ * Usage: raytrace distribute [--workers n] [options] width height input.json output.ppm
+ *
+ * @param program - path this program was run as, the workers run it again
+ * @param argc - number of arguments following the distribute command
+ * @param argv - the arguments following the distribute command
+ * @returns 0 once the image is written, -1 if a worker failed
+ */
+int distribute_scene(char *program, int argc, char *argv[]) {
+	DistributeJob job;
+	double start;
+	int index;
+	
+	if((argc < 4) || (is_number(argv[argc - 4]) == 0) || (is_number(argv[argc - 3]) == 0)) {
+		fprintf(stderr, "Error, incorrect usage!\nCorrect usage pattern is: raytrace distribute [--workers n] [options] width height input.json output.ppm.\n");
+		exit(-1);
+		
+	}
+	
+	job.program = program;
+	job.num_workers = 0;
+	job.num_options = 0;
+	job.options = (char **)malloc(sizeof(char *) * argc);
+	if(job.options == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	// The options are everything in front of the four positional arguments
+	for(index = 0; index < argc - 4; index++) {
+		if((strcmp(argv[index], "--workers") == 0) && (index + 1 < argc - 4) && is_number(argv[index + 1])) {
+			job.num_workers = atoi(argv[++index]);
+			
+		} else {
+			job.options[job.num_options++] = argv[index];
+			
+		}
+		
+	}
+	
+	job.width = atoi(argv[argc - 4]);
+	job.height = atoi(argv[argc - 3]);
+	job.scene = argv[argc - 2];
+	job.output = argv[argc - 1];
+	
+	start = wall_clock();
+	index = distribute_render(&job);
+	
+	if(index == 0) {
+		printf("Rendered %s in %lf ms.\n", job.output, (wall_clock() - start) * 1000.0);
+		
+	}
+	
+	free(job.options);
+	
+	return (index);
+	
+}
 
-// Allocate object array, specifications do not support more then 128 objects in a scene
-Object objects[MAX_OBJECTS];
 
 /**
  * main
@@ -27,9 +420,110 @@ Object objects[MAX_OBJECTS];
  * @description main function called by the operating system when the user runs the program. 
  */
 int main(int argc, char *argv[]){
-	int num_objects, count, index;
-	FILE *fpointer;
-	Image *ppm_image;
+	int num_objects, index;
+	int num_threads, tile_size;
+	int use_bvh, show_report, show_scene, wavefront, progressive;
+	double render_time, write_time, flush_interval;
+	const char *simd_preference, *simd_name;
+	char *stats_path, *serve_path;
+	FILE *stats_file;
+	char *scene_data;
+	size_t scene_size;
+	int scene_mapped, compiled;
+	int streamed, band_height, peak_stack;
+	int map_output, output_mapped;
+	int mip_levels;
+	int has_region, region[4];
+	long long samples;
+	ImageStream *stream;
+	Image *ppm_image, *band;
+	ThreadPool *pool;
+	Scene *scene;
+	RenderSettings settings;
+	Arena scene_arena;
+	Object *objects;
+	RenderStats stats;
+	StatsTimes times;
+	ServerConfig server;
+	
+	// Compile a json scene into a scene file instead of rendering
+	if((argc > 1) && (strcmp(argv[1], "compile") == 0)) {
+		return compile_scene(argc - 2, argv + 2);
+		
+	}
+	
+	// Render a keyframed animation instead of a single image
+	if((argc > 1) && (strcmp(argv[1], "animate") == 0)) {
+		return animate_scene(argc - 2, argv + 2);
+		
+	}
+	
+	// Assemble the partial images of region renders
+	if((argc > 1) && (strcmp(argv[1], "merge") == 0)) {
+		return merge_images(argc - 2, argv + 2);
+		
+	}
+	
+	// Split the render over worker processes
+	if((argc > 1) && (strcmp(argv[1], "distribute") == 0)) {
+		return distribute_scene(argv[0], argc - 2, argv + 2);
+		
+	}
+	
+	// Render on the calling thread unless told otherwise
+	num_threads = 1;
+	tile_size = DEFAULT_TILE_SIZE;
+	pool = NULL;
+	
+	// Accelerate ray traversal with a bounding volume hierarchy by default
+	use_bvh = 1;
+	show_report = 0;
+	
+	// Print the parsed objects of small scenes only, large ones would flood the terminal
+	show_scene = 0;
+	
+	// Follow the rays of one pixel at a time unless asked for wavefront tracing
+	wavefront = 0;
+	
+	// Render the image in one go unless asked for preview snapshots
+	progressive = 0;
+	flush_interval = DEFAULT_FLUSH_INTERVAL;
+	
+	// Pick the widest packet kernels the processor supports
+	simd_preference = "auto";
+	
+	// Hold the whole image in memory unless asked to stream it out in bands
+	streamed = 0;
+	band_height = 0;
+	
+	// Render into a buffer that is written out afterwards unless asked to render into the file
+	map_output = 0;
+	output_mapped = 0;
+	
+	// Only the full size image is written unless a mip pyramid is asked for
+	mip_levels = 0;
+	
+	// Render every pixel unless asked for a region of the image
+	has_region = 0;
+	
+	// Counters are off unless a statistics report is asked for
+	stats_path = NULL;
+	
+	// Render the one image given on the command line unless asked to serve jobs
+	serve_path = NULL;
+	memset(&times, 0, sizeof(StatsTimes));
+	
+	// Follow up to seven reflection and refraction bounces per view ray
+	settings.max_depth = DEFAULT_MAX_DEPTH;
+	settings.peak_stack = 0;
+	
+	// Drop secondary rays too faint to change a pixel
+	settings.min_weight = DEFAULT_MIN_WEIGHT;
+	settings.roulette = 0;
+	
+	// One sample per pixel unless anti-aliasing is asked for
+	settings.max_samples = 1;
+	settings.samples = 0;
 	
 	// Allocate memory for Image
 	ppm_image = (Image *)malloc(sizeof(Image));
@@ -39,34 +533,204 @@ int main(int argc, char *argv[]){
 		
 	}
 	
+	// Parse options, they precede the positional arguments
+	for(index = 1; (index < argc) && (argv[index][0] == '-'); index++) {
+		if((strcmp(argv[index], "--threads") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			// 0 selects one thread per processor
+			num_threads = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--tile-size") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			tile_size = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--max-depth") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			settings.max_depth = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--min-weight") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			settings.min_weight = atof(argv[++index]);
+			
+		} else if(strcmp(argv[index], "--roulette") == 0) {
+			settings.roulette = 1;
+			
+		} else if((strcmp(argv[index], "--aa") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			settings.max_samples = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--simd") == 0) && (index + 1 < argc)) {
+			simd_preference = argv[++index];
+			
+		} else if(strcmp(argv[index], "--wavefront") == 0) {
+			wavefront = 1;
+			
+		} else if(strcmp(argv[index], "--progressive") == 0) {
+			progressive = 1;
+			
+		} else if((strcmp(argv[index], "--flush-interval") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			flush_interval = atof(argv[++index]);
+			
+		} else if(strcmp(argv[index], "--no-bvh") == 0) {
+			use_bvh = 0;
+			
+		} else if(strcmp(argv[index], "--map-output") == 0) {
+			map_output = 1;
+			
+		} else if(strcmp(argv[index], "--stream") == 0) {
+			streamed = 1;
+			
+		} else if((strcmp(argv[index], "--band-height") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			band_height = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--mip-levels") == 0) && (index + 1 < argc) && is_number(argv[index + 1])) {
+			mip_levels = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--region") == 0) && (index + 1 < argc) && (sscanf(argv[index + 1], "%d,%d,%d,%d", &region[0], &region[1], &region[2], &region[3]) == 4)) {
+			has_region = 1;
+			index++;
+			
+		} else if(strcmp(argv[index], "--bvh-report") == 0) {
+			show_report = 1;
+			
+		} else if(strcmp(argv[index], "--print-scene") == 0) {
+			show_scene = 1;
+			
+		} else if((strcmp(argv[index], "--serve") == 0) && (index + 1 < argc)) {
+			serve_path = argv[++index];
+			
+		} else if((strcmp(argv[index], "--stats") == 0) && (index + 1 < argc)) {
+			stats_path = argv[++index];
+			
+		} else {
+			fprintf(stderr, "Error, unknown or incomplete option '%s'.\n", argv[index]);
+			exit(-1);
+			
+		}
+		
+	}
+	
+	if((wavefront != 0) && (progressive != 0)) {
+		fprintf(stderr, "Error, --wavefront and --progressive can not be combined.\n");
+		exit(-1);
+		
+	}
+	
+	if((settings.max_samples > 1) && ((wavefront != 0) || (progressive != 0))) {
+		fprintf(stderr, "Error, --aa can not be combined with --wavefront or --progressive.\n");
+		exit(-1);
+		
+	}
+	
+	if((streamed != 0) && ((settings.max_samples > 1) || (progressive != 0))) {
+		fprintf(stderr, "Error, --stream can not be combined with --aa or --progressive.\n");
+		exit(-1);
+		
+	}
+	
+	if((map_output != 0) && ((streamed != 0) || (progressive != 0))) {
+		fprintf(stderr, "Error, --map-output can not be combined with --stream or --progressive.\n");
+		exit(-1);
+		
+	}
+	
+	if((mip_levels > 0) && (streamed != 0)) {
+		fprintf(stderr, "Error, --mip-levels needs the whole image and can not be combined with --stream.\n");
+		exit(-1);
+		
+	}
+	
+	if((has_region != 0) && ((streamed != 0) || (progressive != 0) || (map_output != 0) || (mip_levels > 0) || (settings.max_samples > 1))) {
+		fprintf(stderr, "Error, --region can not be combined with --stream, --progressive, --map-output, --mip-levels or --aa.\n");
+		exit(-1);
+		
+	}
+	
+	// Serve render jobs on a socket instead, with the render options given here
+	if(serve_path != NULL) {
+		if((streamed != 0) || (progressive != 0) || (map_output != 0) || (mip_levels > 0) || (has_region != 0) || (stats_path != NULL) || (index != argc)) {
+			fprintf(stderr, "Error, --serve takes no image arguments and can not be combined with --stream, --progressive, --map-output, --mip-levels, --region or --stats.\n");
+			exit(-1);
+			
+		}
+		
+		if(num_threads != 1) {
+			pool = threadpool_create(num_threads);
+			
+		}
+		simd_init(simd_preference);
+		
+		server.pool = pool;
+		server.tile_size = tile_size;
+		server.wavefront = wavefront;
+		server.use_bvh = use_bvh;
+		server.settings = settings;
+		
+		index = server_run(serve_path, &server);
+		
+		if(pool != NULL) {
+			threadpool_destroy(pool);
+			
+		}
+		free(ppm_image);
+		
+		return (index);
+		
+	}
+	
+	// Bands as tall as the tiles keep every worker busy on one band
+	if(band_height < 1) {
+		band_height = (tile_size > 0) ? tile_size : DEFAULT_TILE_SIZE;
+		
+	}
+	
+	// Shift the positional arguments so they start at argv[1]
+	argc = argc - (index - 1);
+	argv = argv + (index - 1);
+	
 	// Validate command line input(s)
 	if(argc != 5){
-		fprintf(stderr, "Error, incorrect usage!\nCorrect usage pattern is: raycast width height input.json output.ppm.\n");
+		fprintf(stderr, "Error, incorrect usage!\nCorrect usage pattern is: raycast [options] width height input.json output.ppm.\n");
 		exit(-1);
 		
 	} else {
-		// Loop through the first two inputs to check if they are integers
+		// Check the first two inputs are integers
 		for(index = 1; index < 3; index++){
-			for(count = 0; count < strlen(argv[index]); count++) {
-				if((!(isdigit((argv[index])[count]))) && (((argv[index])[count]) != '.')){
-					fprintf(stderr, "Error, incorrect width and/or height value(s).\n");
-					exit(-1);
-					
-				}
+			if(is_number(argv[index]) == 0) {
+				fprintf(stderr, "Error, incorrect width and/or height value(s).\n");
+				exit(-1);
 				
 			}
-
+			
 		}		
 		
 	}
-
-	// Open json file for reading
-	fpointer = fopen(argv[3], "r");
+	
+	if(((map_output != 0) || (streamed != 0)) && (is_png_file(argv[4]) != 0)) {
+		fprintf(stderr, "Error, --stream and --map-output write P6 images, not PNG.\n");
+		exit(-1);
+		
+	}
+	
+	// A region is written as a partial P6 image that raytrace merge assembles
+	if(has_region != 0) {
+		if(is_png_file(argv[4]) != 0) {
+			fprintf(stderr, "Error, --region writes a partial P6 image, not PNG.\n");
+			exit(-1);
+			
+		}
 		
-	if(fpointer == NULL) {
+		if((region[0] < 0) || (region[1] < 0) || (region[2] <= region[0]) || (region[3] <= region[1]) || (region[2] > atoi(argv[1])) || (region[3] > atoi(argv[2]))) {
+			fprintf(stderr, "Error, the region must lie inside the image and hold at least one pixel.\n");
+			exit(-1);
+			
+		}
+		
+	}
+	
+	// Map json file for reading, the parser works on it in place. Compiled scene files are
+	// mapped as they are by scene_load_file
+	compiled = is_scene_file(argv[3]);
+	scene_data = (compiled != 0) ? NULL : map_file(argv[3], &scene_size, &scene_mapped);
+	scene = NULL;
+	
+	if((compiled == 0) && (scene_data == NULL)) {
 		fprintf(stderr, "Error, could not open file.\n");
-		// Close file stream flush all buffers
-		fclose(fpointer);
 		exit(-1);
 		
 	} else {
@@ -74,35 +738,215 @@ int main(int argc, char *argv[]){
 		ppm_image->width = atoi(argv[1]);
 		ppm_image->height = atoi(argv[2]);
 		ppm_image->max_color = MAX_COLOR;
+		ppm_image->band_start = 0;
+		ppm_image->band_height = ppm_image->height;
+		ppm_image->band_left = 0;
+		ppm_image->band_width = ppm_image->width;
 		
-		// Allocate memory size for image data
-		ppm_image->image_data = malloc(sizeof(Pixel) * ppm_image->width * ppm_image->height);
-		if((ppm_image->image_data) == NULL) {
+		// Only the region's rows and columns are rendered, the camera still covers the whole image
+		if(has_region != 0) {
+			ppm_image->band_left = region[0];
+			ppm_image->band_width = region[2] - region[0];
+			ppm_image->band_start = region[1];
+			ppm_image->band_height = region[3] - region[1];
+			
+		}
+		
+		// Allocate memory size for image data, a streamed image only holds a few bands at a time
+		// and a mapped one is rendered into the output file
+		ppm_image->image_data = ((streamed != 0) || (map_output != 0)) ? NULL : malloc(sizeof(Pixel) * ppm_image->band_width * ppm_image->band_height);
+		if((streamed == 0) && (map_output == 0) && ((ppm_image->image_data) == NULL)) {
 			fprintf(stderr, "Failed to allocate memory.\n");
 			exit(-1);
-
+			
 		}
 		
-		// Read in json scene return number of objects
-		num_objects = json_read_scene(fpointer, objects);
+		// The same workers parse large scenes and render them
+		if(num_threads != 1) {
+			pool = threadpool_create(num_threads);
+			
+		}
+		
+		// Read in json scene return number of objects, everything it keeps lives in the arena
+		times.parse = wall_clock();
+		arena_init(&scene_arena);
+		if(compiled != 0) {
+			scene = scene_load_file(argv[3], use_bvh);
+			num_objects = scene->num_objects;
+			objects = NULL;
+			
+		} else {
+			objects = json_parse_scene_parallel(scene_data, scene_size, &scene_arena, &num_objects, pool);
+			unmap_file(scene_data, scene_size, scene_mapped);
+			
+		}
+		times.parse = wall_clock() - times.parse;
 		
 		if(num_objects <= 0) {
 			// Empty Scene
+			scene_free(scene);
 			
 		} else {
-			// Print objects read in from the json file
-			print_scene(objects, num_objects);
+			// Print objects read in from the json file, unless asked to only if the scene is small
+			// enough to be parsed on one thread
+			if((objects != NULL) && ((show_scene != 0) || (scene_size < PARALLEL_PARSE_SIZE))) {
+				print_scene(objects, num_objects);
+				
+			}
+			
+			// Select the ray packet kernels
+			times.build = wall_clock();
+			simd_name = simd_init(simd_preference);
+			
+			// Prepare the scene and build the acceleration structure, a loaded scene is ready
+			if(scene == NULL) {
+				scene = scene_create(objects, num_objects, use_bvh);
+				
+			}
+			if((scene->bvh != NULL) && (show_report != 0)) {
+				scene->bvh->collect_stats = 1;
+				
+			}
+			times.build = wall_clock() - times.build;
+			stats_enabled = (stats_path != NULL);
+			
+			// Render straight into the output file, the buffer is only kept for files that can not be mapped
+			if(map_output != 0) {
+				output_mapped = map_p6_image(argv[4], ppm_image);
+				
+				if(output_mapped == 0) {
+					ppm_image->image_data = malloc(sizeof(Pixel) * ppm_image->width * ppm_image->height);
+					if((ppm_image->image_data) == NULL) {
+						fprintf(stderr, "Failed to allocate memory.\n");
+						exit(-1);
+						
+					}
+					
+				}
+				
+			}
+			
+			// Raycast scene
+			render_time = wall_clock();
+			if(streamed != 0) {
+				// Each band is written out while the next ones render
+				stream = stream_open(argv[4], ppm_image->width, ppm_image->height, ppm_image->max_color, band_height, STREAM_BANDS);
+				samples = 0;
+				peak_stack = 0;
+				
+				while((band = stream_acquire(stream)) != NULL) {
+					render_image(scene, band, pool, tile_size, wavefront, &settings);
+					stream_submit(stream, band);
+					
+					samples = samples + settings.samples;
+					peak_stack = (settings.peak_stack > peak_stack) ? settings.peak_stack : peak_stack;
+					
+				}
+				
+				// Writing overlaps rendering, only the wait for the last bands counts as writing
+				times.write = wall_clock();
+				stream_close(stream);
+				times.write = wall_clock() - times.write;
+				
+				settings.samples = samples;
+				settings.peak_stack = peak_stack;
+				
+			} else if(progressive != 0) {
+				raycaster_progressive(scene, ppm_image, pool, &settings, argv[4], flush_interval);
+				
+			} else {
+				render_image(scene, ppm_image, pool, tile_size, wavefront, &settings);
+				
+			}
+			
+			render_time = wall_clock() - render_time - times.write;
+			times.render = render_time;
+			stats_enabled = 0;
 			
-			// Raycast scene, write out to ppm6 image
-			write_p6_image(argv[4], raycaster(objects, ppm_image, num_objects));
+			if(settings.max_samples > 1) {
+				printf("Samples: %lld (%lf per pixel)\n", settings.samples, (double)settings.samples / ((double)ppm_image->width * ppm_image->height));
+				
+			}
+			
+			if(show_report != 0) {
+				if(scene->bvh != NULL) {
+					bvh_report(scene->bvh, scene, stdout);
+					
+				}
+				printf("Precision: %s\n", PRECISION_NAME);
+				printf("Packet kernels: %s\n", simd_name);
+				if(wavefront == 0) {
+					printf("Peak ray stack: %d of %d entries\n", settings.peak_stack, settings.max_depth + 2);
+					
+				}
+				printf("Scene arena: %zu bytes used, %zu reserved in %d blocks\n", scene_arena.used, scene_arena.reserved, scene_arena.num_blocks);
+				printf("Render time: %lf ms\n", render_time * 1000.0);
+				
+			}
+			
+			// Downsample the finished image while it is still held, a mapped one is read from the file's pages
+			write_time = wall_clock();
+			if(mip_levels > 0) {
+				mip_write(argv[4], ppm_image, mip_levels, pool);
+				
+			}
+			
+			// Write out to ppm6 or png image, a streamed image is already written and a mapped one only unmapped
+			if(output_mapped != 0) {
+				unmap_p6_image(ppm_image);
+				
+			} else if(is_png_file(argv[4]) != 0) {
+				write_png_image(argv[4], ppm_image, pool);
+				
+			} else if(streamed == 0) {
+				write_p6_image(argv[4], ppm_image);
+				
+			}
+			
+			if(streamed == 0) {
+				times.write = wall_clock() - write_time;
+				
+			}
+			
+			// Report the counters of every render thread, "-" writes them to stderr
+			if(stats_path != NULL) {
+				stats_file = (strcmp(stats_path, "-") == 0) ? stderr : fopen(stats_path, "w");
+				
+				if(stats_file == NULL) {
+					fprintf(stderr, "Error, could not open file '%s'.\n", stats_path);
+					
+				} else {
+					stats_merge(&stats);
+					stats_write(stats_file, &stats, &times, &scene_arena, settings.max_depth);
+					
+					if(stats_file != stderr) {
+						fclose(stats_file);
+						
+					}
+					
+				}
+				
+				stats_free();
+				
+			}
+			
+			scene_free(scene);
 			
 			// Deallocate memory previously allocated by calls to malloc
 			free(ppm_image->image_data);
 			free(ppm_image);
 		}
 		
+		if(pool != NULL) {
+			threadpool_destroy(pool);
+			
+		}
+		
+		// Release the parsed scene in one go
+		arena_free(&scene_arena);
+		
 	}
-
+	
 	return(0);
 	
 } 
\ No newline at end of file
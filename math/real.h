@@ -0,0 +1,36 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: real.h
+ * Copyright © 2016 All rights reserved 
+ */
+ 
+#ifndef real_h
+#define real_h
+
+/**
+ * Floating point type used by the renderer's vector math, compiled scene, intersection and
+ * shading code. Building with -DSINGLE_PRECISION renders in float, which doubles the number of
+ * values per vector register and halves the memory traffic of the scene. The json parser always
+ * reads doubles.
+ */
+#ifdef SINGLE_PRECISION
+	typedef float real;
+	
+	#define real_sqrt sqrtf
+	#define real_pow powf
+	#define real_cos cosf
+	#define real_fabs fabsf
+	#define PRECISION_NAME "single"
+#else
+	typedef double real;
+	
+	#define real_sqrt sqrt
+	#define real_pow pow
+	#define real_cos cos
+	#define real_fabs fabs
+	#define PRECISION_NAME "double"
+#endif
+
+#endif
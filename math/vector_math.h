@@ -15,8 +15,8 @@
  *
  * @param vector_a - single dimensional array of three double precision numbers
  */
-static inline void normalize(double *vector_a) {
-	double len = sqrt(pow(vector_a[0], 2) + pow(vector_a[1], 2) + pow(vector_a[2], 2));
+static inline void normalize(real *vector_a) {
+	real len = real_sqrt(real_pow(vector_a[0], 2) + real_pow(vector_a[1], 2) + real_pow(vector_a[2], 2));
 	vector_a[0] /= len;
 	vector_a[1] /= len;
 	vector_a[2] /= len;
@@ -34,7 +34,7 @@ static inline void normalize(double *vector_a) {
  * @param vector_b - an array representing a vector in Euclidean space
  * @param vector_c - vector used to store the computational result
  */
-static inline void vector_add(double *vector_a, double *vector_b, double *vector_c) {
+static inline void vector_add(real *vector_a, real *vector_b, real *vector_c) {
   vector_c[0] = vector_a[0] + vector_b[0];
   vector_c[1] = vector_a[1] + vector_b[1];
   vector_c[2] = vector_a[2] + vector_b[2];
@@ -51,7 +51,7 @@ static inline void vector_add(double *vector_a, double *vector_b, double *vector
  * @param vector_b - an array representing a vector in Euclidean space
  * @param vector_c - vector used to store the computational result
  */
-static inline void vector_subtract(double *vector_a, double *vector_b, double *vector_c) {
+static inline void vector_subtract(real *vector_a, real *vector_b, real *vector_c) {
   vector_c[0] = vector_a[0] - vector_b[0];
   vector_c[1] = vector_a[1] - vector_b[1];
   vector_c[2] = vector_a[2] - vector_b[2];
@@ -67,7 +67,7 @@ static inline void vector_subtract(double *vector_a, double *vector_b, double *v
  * @param scalar - value used to scale vector 'a' with
  * @param vector_c - vector used to store the computational result
  */
-static inline void vector_scale(double *vector_a, double scalar, double *vector_c) {
+static inline void vector_scale(real *vector_a, real scalar, real *vector_c) {
   vector_c[0] = scalar * vector_a[0];
   vector_c[1] = scalar * vector_a[1];
   vector_c[2] = scalar * vector_a[2];
@@ -87,7 +87,7 @@ static inline void vector_scale(double *vector_a, double scalar, double *vector_
  * @param vector_c - vector used to store the computational result
  * @returns double used typically as a scalar value
  */
-static inline double vector_dot_product(double *vector_a, double *vector_b) {
+static inline real vector_dot_product(real *vector_a, real *vector_b) {
   return (vector_a[0] * vector_b[0]) + (vector_a[1] * vector_b[1]) + (vector_a[2] * vector_b[2]);
   
 }
@@ -101,7 +101,7 @@ static inline double vector_dot_product(double *vector_a, double *vector_b) {
  * @param vector_b - an array containing three double precision numbers
  * @param vector_c - vector used to store the computational results
  */
-static inline void vector_cross_product(double *vector_a, double *vector_b, double *vector_c) {
+static inline void vector_cross_product(real *vector_a, real *vector_b, real *vector_c) {
   vector_c[0] = (vector_a[1] * vector_b[2]) - (vector_a[2] * vector_b[1]);
   vector_c[1] = (vector_a[2] * vector_b[0]) - (vector_a[0] * vector_b[2]);
   vector_c[2] = (vector_a[0] * vector_b[1]) - (vector_a[1] * vector_b[0]);
@@ -117,9 +117,9 @@ static inline void vector_cross_product(double *vector_a, double *vector_b, doub
  * @param vector_b - an array containing three double precision numbers
  * @param vector_c - vector used to store the computational result
  */
-static inline void vector_reflection(double *vector_a, double *vector_b, double *vector_c) {
-	double scalar;
-	double vector_o[3] = {0, 0, 0};
+static inline void vector_reflection(real *vector_a, real *vector_b, real *vector_c) {
+	real scalar;
+	real vector_o[3] = {0, 0, 0};
 
 	scalar = vector_dot_product(vector_a, vector_b);
 	vector_scale(vector_b, (2.0 * scalar), vector_o);
@@ -134,8 +134,8 @@ static inline void vector_reflection(double *vector_a, double *vector_b, double
  * @param vector_a - an array containing three double precision numbers
  * @returns scalar that reprents a vectors magnitude (length)
  */
-static inline double vector_length(double *vector_a) {
-	return sqrt(pow(vector_a[0], 2) + pow(vector_a[1], 2) + pow(vector_a[2], 2));
+static inline real vector_length(real *vector_a) {
+	return real_sqrt(real_pow(vector_a[0], 2) + real_pow(vector_a[1], 2) + real_pow(vector_a[2], 2));
   
 }
 
@@ -146,11 +146,25 @@ static inline double vector_length(double *vector_a) {
  * @param vector_a - an array containing three double precision numbers
  * @param vector_c - an array containing the contents of vector_a
  */
-static inline void vector_copy(double *vector_a, double *vector_b) {
+static inline void vector_copy(real *vector_a, real *vector_b) {
 	vector_b[0] = vector_a[0];
 	vector_b[1] = vector_a[1];
 	vector_b[2] = vector_a[2];
 	
 }
 
-#endif
\ No newline at end of file
+/**
+ * Copies a vector read by the json parser, which is always double precision, into a vector of
+ * the precision the renderer was built with.
+ * 
+ * @param vector_a - an array containing three double precision numbers
+ * @param vector_b - an array receiving the contents of vector_a
+ */
+static inline void vector_load(double *vector_a, real *vector_b) {
+	vector_b[0] = vector_a[0];
+	vector_b[1] = vector_a[1];
+	vector_b[2] = vector_a[2];
+	
+}
+
+#endif
@@ -0,0 +1,373 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: mip.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "..\ppm\ppm.h"
+#include "..\threadpool\threadpool.h"
+#include "mip.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define SIMD_X86 1
+#endif
+
+/**
+ * Scalar pair kernel.
+ *
+ * @param top - sums of the upper row
+ * @param bottom - sums of the lower row
+ * @param length - number of sums produced, both rows hold length + 3
+ * @param out - receives the sums of each 2x2 block, at the index of its upper left channel
+ */
+static void mip_pairs_scalar(const unsigned int *top, const unsigned int *bottom, int length, unsigned int *out) {
+	int index;
+	
+	for(index = 0; index < length; index++) {
+		out[index] = top[index] + top[index + 3] + bottom[index] + bottom[index + 3];
+		
+	}
+	
+}
+
+
+#ifdef SIMD_X86
+/**
+ * SSE2 pair kernel, four channel sums per instruction.
+ *
+ * @param top - sums of the upper row
+ * @param bottom - sums of the lower row
+ * @param length - number of sums produced, both rows hold length + 3
+ * @param out - receives the sums of each 2x2 block, at the index of its upper left channel
+ */
+__attribute__((target("sse2")))
+static void mip_pairs_sse2(const unsigned int *top, const unsigned int *bottom, int length, unsigned int *out) {
+	__m128i column, neighbour;
+	int index;
+	
+	for(index = 0; index + 4 <= length; index += 4) {
+		column = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(top + index)), _mm_loadu_si128((const __m128i *)(bottom + index)));
+		neighbour = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(top + index + 3)), _mm_loadu_si128((const __m128i *)(bottom + index + 3)));
+		_mm_storeu_si128((__m128i *)(out + index), _mm_add_epi32(column, neighbour));
+		
+	}
+	
+	mip_pairs_scalar(top + index, bottom + index, length - index, out + index);
+	
+}
+
+
+/**
+ * AVX2 pair kernel, eight channel sums per instruction.
+ *
+ * @param top - sums of the upper row
+ * @param bottom - sums of the lower row
+ * @param length - number of sums produced, both rows hold length + 3
+ * @param out - receives the sums of each 2x2 block, at the index of its upper left channel
+ */
+__attribute__((target("avx2")))
+static void mip_pairs_avx2(const unsigned int *top, const unsigned int *bottom, int length, unsigned int *out) {
+	__m256i column, neighbour;
+	int index;
+	
+	for(index = 0; index + 8 <= length; index += 8) {
+		column = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(top + index)), _mm256_loadu_si256((const __m256i *)(bottom + index)));
+		neighbour = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(top + index + 3)), _mm256_loadu_si256((const __m256i *)(bottom + index + 3)));
+		_mm256_storeu_si256((__m256i *)(out + index), _mm256_add_epi32(column, neighbour));
+		
+	}
+	
+	mip_pairs_scalar(top + index, bottom + index, length - index, out + index);
+	
+}
+#endif
+
+
+/**
+ * Picks the widest pair kernel the processor supports.
+ *
+ * @returns the kernel
+ */
+static mip_kernel mip_select_kernel(void) {
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		return (mip_pairs_avx2);
+		
+	} else if(__builtin_cpu_supports("sse2")) {
+		return (mip_pairs_sse2);
+		
+	}
+#endif
+
+	return (mip_pairs_scalar);
+	
+}
+
+
+/**
+ * Reduces two rows of a level to one row of the next, then carries on down the pyramid every
+ * second row. The sums stay exact, each level divides and rounds its own copy of them once
+ * when it quantizes its pixels.
+ *
+ * @param job - the pyramid
+ * @param rows - two sum rows per level, rows[2 * k] and rows[2 * k + 1] for level k
+ * @param pairs - scratch space as long as a full resolution sum row
+ * @param level - level of the row produced, 1 for half size
+ * @param row - the row produced
+ * @param top - sums of row 2 * row of the level above
+ * @param bottom - sums of row 2 * row + 1 of the level above
+ */
+static void mip_reduce(MipJob *job, unsigned int **rows, unsigned int *pairs, int level, int row, unsigned int *top, unsigned int *bottom) {
+	Image *image = &job->levels[level - 1];
+	unsigned int *sums = rows[2 * level + (row & 1)];
+	unsigned char *channels;
+	unsigned int half;
+	int column, channel, shift;
+	
+	// The parent row is twice as wide, plus any odd column left out
+	job->kernel(top, bottom, image->width * 6 - 3, pairs);
+	
+	shift = 2 * level;
+	half = 1u << (shift - 1);
+	channels = (unsigned char *)image_pixel(image, row, 0);
+	
+	for(column = 0; column < image->width; column++) {
+		for(channel = 0; channel < 3; channel++) {
+			sums[column * 3 + channel] = pairs[column * 6 + channel];
+			channels[column * 3 + channel] = (pairs[column * 6 + channel] + half) >> shift;
+			
+		}
+		
+	}
+	
+	if((level < job->num_levels) && ((row & 1) == 1) && (row / 2 < job->levels[level].height)) {
+		mip_reduce(job, rows, pairs, level + 1, row / 2, rows[2 * level], rows[2 * level + 1]);
+		
+	}
+	
+}
+
+
+/**
+ * Builds every level of one strip of the pyramid, called by the thread pool once per strip.
+ *
+ * @param context - pointer to the MipJob describing the pyramid
+ * @param task - index of the strip
+ * @param thread_id - worker executing the strip
+ */
+static void mip_task(void *context, int task, int thread_id) {
+	MipJob *job = (MipJob *)context;
+	Image *source = job->source;
+	unsigned int *rows[2 * (32 + 1)];
+	unsigned int *pairs;
+	unsigned char *channels;
+	int level, row, first, last, index, width;
+	
+	// Sum rows of the full resolution image and of every level
+	width = source->width;
+	for(level = 0; level <= job->num_levels; level++) {
+		rows[2 * level] = (unsigned int *)malloc(sizeof(unsigned int) * width * 3);
+		rows[2 * level + 1] = (unsigned int *)malloc(sizeof(unsigned int) * width * 3);
+		if((rows[2 * level] == NULL) || (rows[2 * level + 1] == NULL)) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
+			
+		}
+		
+		width = (level < job->num_levels) ? job->levels[level].width : width;
+		
+	}
+	
+	pairs = (unsigned int *)malloc(sizeof(unsigned int) * source->width * 3);
+	if(pairs == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	// Rows of the first level in this strip
+	first = task << (job->num_levels - 1);
+	last = first + (1 << (job->num_levels - 1));
+	last = (last > job->levels[0].height) ? job->levels[0].height : last;
+	
+	for(row = first; row < last; row++) {
+		channels = (unsigned char *)image_pixel(source, 2 * row, 0);
+		for(index = 0; index < source->width * 3; index++) {
+			rows[0][index] = channels[index];
+			
+		}
+		
+		channels = (unsigned char *)image_pixel(source, 2 * row + 1, 0);
+		for(index = 0; index < source->width * 3; index++) {
+			rows[1][index] = channels[index];
+			
+		}
+		
+		mip_reduce(job, rows, pairs, 1, row, rows[0], rows[1]);
+		
+	}
+	
+	for(level = 0; level <= job->num_levels; level++) {
+		free(rows[2 * level]);
+		free(rows[2 * level + 1]);
+		
+	}
+	free(pairs);
+	
+}
+
+
+/**
+ * Builds a mip pyramid from a rendered image, each level half the width and height of the one
+ * before, rounded down, and box filtered: every pixel is the mean of the block of full
+ * resolution pixels it covers. The means are taken of exact sums and rounded once, when the
+ * level's pixels are quantized, so no level inherits the rounding of another. The image is
+ * read once, in strips that are reduced on the pool's workers.
+ *
+ * @param image - the rendered image, held whole
+ * @param levels - number of levels wanted, fewer are built once a side would drop below 1
+ * @param pool - thread pool that builds the strips, NULL to build them on the calling thread
+ * @param num_levels - receives the number of levels built
+ * @returns the levels, the half size level first, NULL if none was built
+ */
+Image* mip_build(Image *image, int levels, ThreadPool *pool, int *num_levels) {
+	MipJob job;
+	Image *level;
+	int count, width, height, task, tasks;
+	
+	// Sums of 4^levels channel values have to fit in 32 bits
+	levels = (levels > 12) ? 12 : levels;
+	
+	width = image->width;
+	height = image->height;
+	for(count = 0; (count < levels) && (width >= 2) && (height >= 2); count++) {
+		width = width / 2;
+		height = height / 2;
+		
+	}
+	
+	*num_levels = count;
+	if(count == 0) {
+		return (NULL);
+		
+	}
+	
+	job.source = image;
+	job.num_levels = count;
+	job.kernel = mip_select_kernel();
+	job.levels = (Image *)malloc(sizeof(Image) * count);
+	if(job.levels == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	width = image->width;
+	height = image->height;
+	for(count = 0; count < job.num_levels; count++) {
+		width = width / 2;
+		height = height / 2;
+		
+		level = &job.levels[count];
+		level->magic_number = "P6";
+		level->width = width;
+		level->height = height;
+		level->max_color = image->max_color;
+		level->band_start = 0;
+		level->band_height = height;
+		level->band_left = 0;
+		level->band_width = width;
+		level->image_data = (Pixel *)malloc(sizeof(Pixel) * width * height);
+		if(level->image_data == NULL) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
+			
+		}
+		
+	}
+	
+	// Strips of 2^levels rows make whole rows of every level
+	tasks = (job.levels[0].height + (1 << (job.num_levels - 1)) - 1) >> (job.num_levels - 1);
+	
+	if(pool != NULL) {
+		threadpool_run(pool, mip_task, &job, tasks);
+		
+	} else {
+		for(task = 0; task < tasks; task++) {
+			mip_task(&job, task, 0);
+			
+		}
+		
+	}
+	
+	return (job.levels);
+	
+}
+
+
+/**
+ * Frees the levels of a pyramid.
+ *
+ * @param levels - the levels, as returned by mip_build
+ * @param num_levels - number of levels
+ */
+void mip_free(Image *levels, int num_levels) {
+	int index;
+	
+	for(index = 0; index < num_levels; index++) {
+		free(levels[index].image_data);
+		
+	}
+	
+	free(levels);
+	
+}
+
+
+/**
+ * Builds the mip pyramid of a rendered image and writes every level next to the full size
+ * output, in the same format.
+ *
+ * @param path - path of the full size output
+ * @param image - the rendered image, held whole
+ * @param levels - number of levels wanted
+ * @param pool - thread pool that builds the levels and deflates PNG output, may be NULL
+ * @returns the number of levels written
+ */
+int mip_write(char *path, Image *image, int levels, ThreadPool *pool) {
+	Image *pyramid;
+	char *name;
+	int index, num_levels;
+	
+	pyramid = mip_build(image, levels, pool, &num_levels);
+	
+	for(index = 0; index < num_levels; index++) {
+		name = path_with_suffix(path, "-mip%d", index + 1);
+		
+		if(is_png_file(path) != 0) {
+			write_png_image(name, &pyramid[index], pool);
+			
+		} else {
+			write_p6_image(name, &pyramid[index]);
+			
+		}
+		
+		free(name);
+		
+	}
+	
+	if(pyramid != NULL) {
+		mip_free(pyramid, num_levels);
+		
+	}
+	
+	return (num_levels);
+	
+}
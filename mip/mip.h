@@ -0,0 +1,36 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: mip.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef mip_h
+	#define mip_h
+	
+	/**
+	 * Adds neighbouring pixel pairs of two rows of channel sums, out[i] = top[i] + top[i + 3] +
+	 * bottom[i] + bottom[i + 3] for i below length.
+	 */
+	typedef void (*mip_kernel)(const unsigned int *top, const unsigned int *bottom, int length, unsigned int *out);
+	
+	/**
+	 * Describes a pyramid handed to the thread pool. Task i reduces the strip of 2^num_levels
+	 * full resolution rows starting at row i * 2^num_levels down through every level, so the
+	 * strips are independent of each other.
+	 */
+	typedef struct MipJob {
+		Image *source;
+		Image *levels;					//<= level 1 at index 0, each half the size of the one before
+		int num_levels;
+		mip_kernel kernel;
+		
+	} MipJob;
+	
+	// function declarations
+	Image* mip_build(Image *image, int levels, ThreadPool *pool, int *num_levels);
+	void mip_free(Image *levels, int num_levels);
+	int mip_write(char *path, Image *image, int levels, ThreadPool *pool);
+	
+#endif
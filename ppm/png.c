@@ -0,0 +1,1098 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: png.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "..\threadpool\threadpool.h"
+#include "ppm.h"
+
+// Filtered bytes compressed by one task, each band becomes one IDAT chunk
+#define PNG_BAND_BYTES (1 << 20)
+
+// Symbols coded with one set of Huffman codes before a new block starts
+#define DEFLATE_BLOCK_SYMBOLS (1 << 15)
+
+// Match finder, candidates are found through a hash of the next three bytes
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_MAX_CHAIN 16
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+
+// Literals 0-255, end of block 256 and lengths 257-285, distances 0-29, code lengths 0-18
+#define LITERAL_CODES 286
+#define DISTANCE_CODES 30
+#define LENGTH_CODES 19
+
+static const int length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Order the code length code lengths are stored in
+static const int length_order[LENGTH_CODES] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Tables filled by png_init, the crc of each byte value and the code of each length and distance
+static unsigned int crc_table[256];
+static unsigned char length_table[DEFLATE_MAX_MATCH + 1];
+static unsigned char distance_table[512];
+
+/**
+ * Growable buffer that deflate output is written to, least significant bit first.
+ */
+typedef struct BitWriter {
+	unsigned char *data;
+	size_t size, capacity;
+	unsigned long long bits;
+	int count;
+	
+} BitWriter;
+
+/**
+ * A literal, or a match of length bytes at distance bytes back when distance is non zero.
+ */
+typedef struct DeflateSymbol {
+	unsigned short length;
+	unsigned short distance;
+	
+} DeflateSymbol;
+
+/**
+ * Compressed output of one band of rows.
+ */
+typedef struct PngBand {
+	BitWriter output;
+	unsigned int adler;			//<= adler-32 of the band's filtered bytes
+	size_t length;				//<= number of filtered bytes
+	unsigned int crc;			//<= crc of the IDAT chunk holding the band
+	
+} PngBand;
+
+/**
+ * Describes a PNG encode handed to the thread pool, task i compresses band i.
+ */
+typedef struct PngJob {
+	Image *image;
+	PngBand *bands;
+	int num_bands;
+	int band_rows;
+	
+} PngJob;
+
+
+/**
+ * Continues a crc over more bytes.
+ *
+ * @param crc - crc of the bytes so far, 0xFFFFFFFF to start
+ * @param data - the bytes
+ * @param length - number of bytes
+ * @returns crc including the bytes, xor with 0xFFFFFFFF to finish it
+ */
+static unsigned int crc_update(unsigned int crc, const unsigned char *data, size_t length) {
+	size_t index;
+	
+	for(index = 0; index < length; index++) {
+		crc = crc_table[(crc ^ data[index]) & 255] ^ (crc >> 8);
+		
+	}
+	
+	return (crc);
+	
+}
+
+
+/**
+ * Computes the adler-32 checksum of the zlib stream.
+ *
+ * @param data - the bytes
+ * @param length - number of bytes
+ * @returns the checksum
+ */
+static unsigned int adler32(const unsigned char *data, size_t length) {
+	unsigned int a = 1, b = 0;
+	size_t index, chunk;
+	
+	while(length > 0) {
+		// 5552 bytes is the most that can be summed before b overflows
+		chunk = (length < 5552) ? length : 5552;
+		for(index = 0; index < chunk; index++) {
+			a += data[index];
+			b += a;
+			
+		}
+		
+		a %= 65521;
+		b %= 65521;
+		data += chunk;
+		length -= chunk;
+		
+	}
+	
+	return ((b << 16) | a);
+	
+}
+
+
+/**
+ * Combines the adler-32 checksums of two consecutive runs of bytes.
+ *
+ * @param first - checksum of the first run
+ * @param second - checksum of the second run
+ * @param length - length of the second run
+ * @returns checksum of both runs
+ */
+static unsigned int adler32_combine(unsigned int first, unsigned int second, size_t length) {
+	unsigned int remainder, sum1, sum2;
+	
+	remainder = length % 65521;
+	sum1 = first & 0xFFFF;
+	sum2 = (unsigned int)(((unsigned long long)remainder * sum1) % 65521);
+	sum1 += (second & 0xFFFF) + 65521 - 1;
+	sum2 += ((first >> 16) & 0xFFFF) + ((second >> 16) & 0xFFFF) + 65521 - remainder;
+	
+	sum1 = (sum1 >= 65521) ? sum1 - 65521 : sum1;
+	sum1 = (sum1 >= 65521) ? sum1 - 65521 : sum1;
+	sum2 = (sum2 >= 2 * 65521) ? sum2 - 2 * 65521 : sum2;
+	sum2 = (sum2 >= 65521) ? sum2 - 65521 : sum2;
+	
+	return ((sum2 << 16) | sum1);
+	
+}
+
+
+/**
+ * Appends bits to the output, least significant bit first.
+ *
+ * @param writer - the output
+ * @param value - the bits
+ * @param length - number of bits, at most 32
+ */
+static void put_bits(BitWriter *writer, unsigned int value, int length) {
+	writer->bits |= (unsigned long long)value << writer->count;
+	writer->count += length;
+	
+	if(writer->size + 8 > writer->capacity) {
+		writer->capacity = writer->capacity * 2 + 64;
+		writer->data = (unsigned char *)realloc(writer->data, writer->capacity);
+		if(writer->data == NULL) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
+			
+		}
+		
+	}
+	
+	while(writer->count >= 8) {
+		writer->data[writer->size++] = writer->bits & 255;
+		writer->bits >>= 8;
+		writer->count -= 8;
+		
+	}
+	
+}
+
+
+/**
+ * Pads the output with zero bits to a whole byte.
+ *
+ * @param writer - the output
+ */
+static void align_bits(BitWriter *writer) {
+	if(writer->count > 0) {
+		put_bits(writer, 0, 8 - writer->count);
+		
+	}
+	
+}
+
+
+/**
+ * Finds the code of a length or distance, the last entry of the table not above the value.
+ *
+ * @param base - first value of each code
+ * @param count - number of codes
+ * @param value - the length or distance
+ * @returns the code
+ */
+static int find_code(const int *base, int count, int value) {
+	int low = 0, high = count - 1, middle;
+	
+	while(low < high) {
+		middle = (low + high + 1) / 2;
+		if(base[middle] <= value) {
+			low = middle;
+			
+		} else {
+			high = middle - 1;
+			
+		}
+		
+	}
+	
+	return (low);
+	
+}
+
+
+/**
+ * Fills the crc table of the PNG chunk checksums and the tables that map match lengths and
+ * distances to their codes. Distances up to 256 have an entry each, longer ones one entry per
+ * 128, no code boundary lies in between.
+ */
+static void png_init(void) {
+	unsigned int value;
+	int index, bit;
+	
+	for(index = 0; index < 256; index++) {
+		value = index;
+		for(bit = 0; bit < 8; bit++) {
+			value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+			
+		}
+		crc_table[index] = value;
+		
+	}
+	
+	for(index = DEFLATE_MIN_MATCH; index <= DEFLATE_MAX_MATCH; index++) {
+		length_table[index] = find_code(length_base, 29, index);
+		
+	}
+	
+	for(index = 0; index < 256; index++) {
+		distance_table[index] = find_code(distance_base, 30, index + 1);
+		distance_table[256 + index] = find_code(distance_base, 30, (index << 7) + 1);
+		
+	}
+	
+}
+
+
+/**
+ * Returns the code of a match distance.
+ *
+ * @param distance - the distance, 1 to 32768
+ * @returns the code
+ */
+static int distance_code(int distance) {
+	return ((distance <= 256) ? distance_table[distance - 1] : distance_table[256 + ((distance - 1) >> 7)]);
+	
+}
+
+
+/**
+ * Computes Huffman code lengths no longer than limit bits. Symbols that do not occur get
+ * length 0. When the optimal code is too deep the frequencies are flattened and the code
+ * is built again.
+ *
+ * @param frequencies - occurrences of each symbol
+ * @param count - number of symbols, at most LITERAL_CODES
+ * @param limit - longest code allowed
+ * @param lengths - receives the code length of each symbol
+ */
+static void huffman_lengths(const unsigned int *frequencies, int count, int limit, unsigned char *lengths) {
+	unsigned int weights[2 * LITERAL_CODES];
+	int parents[2 * LITERAL_CODES];
+	int alive[2 * LITERAL_CODES];
+	int nodes, leaves, index, first, second, depth, deepest, node;
+	
+	memset(lengths, 0, count);
+	
+	for(index = 0; index < count; index++) {
+		weights[index] = frequencies[index];
+		
+	}
+	
+	for(;;) {
+		nodes = count;
+		leaves = 0;
+		for(index = 0; index < count; index++) {
+			alive[index] = (weights[index] > 0);
+			parents[index] = -1;
+			leaves += alive[index];
+			
+		}
+		
+		// Join the two lightest trees until one is left
+		for(; leaves > 1; leaves--) {
+			first = second = -1;
+			for(index = 0; index < nodes; index++) {
+				if(alive[index] == 0) {
+					continue;
+					
+				}
+				
+				if((first == -1) || (weights[index] < weights[first])) {
+					second = first;
+					first = index;
+					
+				} else if((second == -1) || (weights[index] < weights[second])) {
+					second = index;
+					
+				}
+				
+			}
+			
+			weights[nodes] = weights[first] + weights[second];
+			alive[nodes] = 1;
+			parents[nodes] = -1;
+			alive[first] = alive[second] = 0;
+			parents[first] = parents[second] = nodes;
+			nodes++;
+			
+		}
+		
+		deepest = 0;
+		for(index = 0; index < count; index++) {
+			depth = 0;
+			for(node = index; parents[node] != -1; node = parents[node]) {
+				depth++;
+				
+			}
+			
+			lengths[index] = depth;
+			deepest = (depth > deepest) ? depth : deepest;
+			
+		}
+		
+		if(deepest <= limit) {
+			break;
+			
+		}
+		
+		// Too deep, flatten the frequencies and try again
+		for(index = 0; index < count; index++) {
+			weights[index] = (frequencies[index] > 0) ? (weights[index] >> 1) | 1 : 0;
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Assigns canonical Huffman codes from code lengths, bit reversed for the least significant
+ * bit first output.
+ *
+ * @param lengths - code length of each symbol
+ * @param count - number of symbols
+ * @param codes - receives the code of each symbol
+ */
+static void huffman_codes(const unsigned char *lengths, int count, unsigned int *codes) {
+	unsigned int next[16], code, reversed;
+	int totals[16], index, bit, bits;
+	
+	memset(totals, 0, sizeof(totals));
+	for(index = 0; index < count; index++) {
+		totals[lengths[index]]++;
+		
+	}
+	
+	totals[0] = 0;
+	code = 0;
+	for(bits = 1; bits < 16; bits++) {
+		code = (code + totals[bits - 1]) << 1;
+		next[bits] = code;
+		
+	}
+	
+	for(index = 0; index < count; index++) {
+		if(lengths[index] == 0) {
+			codes[index] = 0;
+			continue;
+			
+		}
+		
+		code = next[lengths[index]]++;
+		reversed = 0;
+		for(bit = 0; bit < lengths[index]; bit++) {
+			reversed = (reversed << 1) | ((code >> bit) & 1);
+			
+		}
+		codes[index] = reversed;
+		
+	}
+	
+}
+
+
+/**
+ * Writes a block of symbols with Huffman codes fitted to it.
+ *
+ * @param writer - the output
+ * @param symbols - the symbols of the block
+ * @param count - number of symbols
+ * @param final - 1 for the last block of the stream
+ */
+static void write_block(BitWriter *writer, DeflateSymbol *symbols, int count, int final) {
+	unsigned int literal_frequencies[LITERAL_CODES], distance_frequencies[DISTANCE_CODES], length_frequencies[LENGTH_CODES];
+	unsigned char lengths[LITERAL_CODES + DISTANCE_CODES], length_lengths[LENGTH_CODES];
+	unsigned int literal_codes[LITERAL_CODES], distance_codes[DISTANCE_CODES], length_codes[LENGTH_CODES];
+	unsigned char runs[LITERAL_CODES + DISTANCE_CODES], extras[LITERAL_CODES + DISTANCE_CODES];
+	int literals, distances, stored, num_runs, index, run, code, symbol;
+	
+	memset(literal_frequencies, 0, sizeof(literal_frequencies));
+	memset(distance_frequencies, 0, sizeof(distance_frequencies));
+	memset(length_frequencies, 0, sizeof(length_frequencies));
+	
+	for(index = 0; index < count; index++) {
+		if(symbols[index].distance == 0) {
+			literal_frequencies[symbols[index].length]++;
+			
+		} else {
+			literal_frequencies[257 + length_table[symbols[index].length]]++;
+			distance_frequencies[distance_code(symbols[index].distance)]++;
+			
+		}
+		
+	}
+	literal_frequencies[256] = 1;
+	
+	// Keep both codes complete, some decoders refuse a code of a single symbol
+	literal_frequencies[0] += (literal_frequencies[0] == 0);
+	distance_frequencies[0] += (distance_frequencies[0] == 0);
+	distance_frequencies[1] += (distance_frequencies[1] == 0);
+	
+	huffman_lengths(literal_frequencies, LITERAL_CODES, 15, lengths);
+	huffman_lengths(distance_frequencies, DISTANCE_CODES, 15, lengths + LITERAL_CODES);
+	
+	for(literals = LITERAL_CODES; lengths[literals - 1] == 0; literals--);
+	for(distances = DISTANCE_CODES; lengths[LITERAL_CODES + distances - 1] == 0; distances--);
+	
+	huffman_codes(lengths, LITERAL_CODES, literal_codes);
+	huffman_codes(lengths + LITERAL_CODES, DISTANCE_CODES, distance_codes);
+	
+	// Both sets of lengths are stored as one sequence, runs coded with 16, 17 and 18
+	memmove(lengths + literals, lengths + LITERAL_CODES, distances);
+	stored = literals + distances;
+	num_runs = 0;
+	
+	for(index = 0; index < stored; index += run) {
+		for(run = 1; (index + run < stored) && (lengths[index + run] == lengths[index]); run++);
+		
+		if((lengths[index] == 0) && (run >= 11)) {
+			run = (run > 138) ? 138 : run;
+			runs[num_runs] = 18;
+			extras[num_runs++] = run - 11;
+			
+		} else if((lengths[index] == 0) && (run >= 3)) {
+			runs[num_runs] = 17;
+			extras[num_runs++] = run - 3;
+			
+		} else if(run >= 4) {
+			// The first length is stored, the repeats follow as one code 16
+			run = (run > 7) ? 7 : run;
+			runs[num_runs] = lengths[index];
+			extras[num_runs++] = 0;
+			runs[num_runs] = 16;
+			extras[num_runs++] = run - 4;
+			
+		} else {
+			run = 1;
+			runs[num_runs] = lengths[index];
+			extras[num_runs++] = 0;
+			
+		}
+		
+	}
+	
+	for(index = 0; index < num_runs; index++) {
+		length_frequencies[runs[index]]++;
+		
+	}
+	length_frequencies[length_order[0]] += (length_frequencies[length_order[0]] == 0);
+	length_frequencies[length_order[1]] += (length_frequencies[length_order[1]] == 0);
+	
+	huffman_lengths(length_frequencies, LENGTH_CODES, 7, length_lengths);
+	huffman_codes(length_lengths, LENGTH_CODES, length_codes);
+	for(code = LENGTH_CODES; (code > 4) && (length_lengths[length_order[code - 1]] == 0); code--);
+	
+	// Block header
+	put_bits(writer, final, 1);
+	put_bits(writer, 2, 2);
+	put_bits(writer, literals - 257, 5);
+	put_bits(writer, distances - 1, 5);
+	put_bits(writer, code - 4, 4);
+	
+	for(index = 0; index < code; index++) {
+		put_bits(writer, length_lengths[length_order[index]], 3);
+		
+	}
+	
+	for(index = 0; index < num_runs; index++) {
+		put_bits(writer, length_codes[runs[index]], length_lengths[runs[index]]);
+		
+		if(runs[index] == 16) {
+			put_bits(writer, extras[index], 2);
+			
+		} else if(runs[index] == 17) {
+			put_bits(writer, extras[index], 3);
+			
+		} else if(runs[index] == 18) {
+			put_bits(writer, extras[index], 7);
+			
+		}
+		
+	}
+	
+	// Restore the distance lengths to their own array position
+	memmove(lengths + LITERAL_CODES, lengths + literals, distances);
+	memset(lengths + literals, 0, LITERAL_CODES - literals);
+	memset(lengths + LITERAL_CODES + distances, 0, DISTANCE_CODES - distances);
+	
+	for(index = 0; index < count; index++) {
+		if(symbols[index].distance == 0) {
+			put_bits(writer, literal_codes[symbols[index].length], lengths[symbols[index].length]);
+			
+		} else {
+			code = length_table[symbols[index].length];
+			put_bits(writer, literal_codes[257 + code], lengths[257 + code]);
+			put_bits(writer, symbols[index].length - length_base[code], length_extra[code]);
+			
+			code = distance_code(symbols[index].distance);
+			symbol = LITERAL_CODES + code;
+			put_bits(writer, distance_codes[code], lengths[symbol]);
+			put_bits(writer, symbols[index].distance - distance_base[code], distance_extra[code]);
+			
+		}
+		
+	}
+	
+	// End of block
+	put_bits(writer, literal_codes[256], lengths[256]);
+	
+}
+
+
+/**
+ * Returns the hash of the three bytes at a position, used to find earlier matches.
+ *
+ * @param data - the bytes
+ * @returns index into the hash table
+ */
+static unsigned int deflate_hash(const unsigned char *data) {
+	return ((((unsigned int)data[0] << 16) | ((unsigned int)data[1] << 8) | data[2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+	
+}
+
+
+/**
+ * Compresses bytes into deflate blocks with greedy matching over hash chains. Matches never
+ * reach in front of the data, so runs of data compressed apart can be joined into one stream.
+ *
+ * @param writer - the output
+ * @param data - the bytes
+ * @param length - number of bytes
+ * @param final - 1 if the data ends the stream, otherwise the output ends with an empty stored
+ *                block so it stops on a byte boundary
+ */
+static void deflate_data(BitWriter *writer, const unsigned char *data, size_t length, int final) {
+	DeflateSymbol *symbols;
+	int *head, *chain;
+	size_t position, candidate, limit, best_distance;
+	int count, best, match, steps, index;
+	unsigned int hash;
+	
+	symbols = (DeflateSymbol *)malloc(sizeof(DeflateSymbol) * DEFLATE_BLOCK_SYMBOLS);
+	head = (int *)malloc(sizeof(int) * (1 << DEFLATE_HASH_BITS));
+	chain = (int *)malloc(sizeof(int) * DEFLATE_WINDOW);
+	if((symbols == NULL) || (head == NULL) || (chain == NULL)) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	// Positions are stored plus one, 0 marks an empty slot
+	memset(head, 0, sizeof(int) * (1 << DEFLATE_HASH_BITS));
+	count = 0;
+	position = 0;
+	
+	while(position < length) {
+		best = 0;
+		best_distance = 0;
+		
+		if(position + DEFLATE_MIN_MATCH <= length) {
+			limit = length - position;
+			limit = (limit > DEFLATE_MAX_MATCH) ? DEFLATE_MAX_MATCH : limit;
+			hash = deflate_hash(data + position);
+			candidate = head[hash];
+			
+			for(steps = 0; (candidate != 0) && (steps < DEFLATE_MAX_CHAIN); steps++) {
+				candidate = candidate - 1;
+				if(position - candidate > DEFLATE_WINDOW) {
+					break;
+					
+				}
+				
+				if(data[candidate + best] == data[position + best]) {
+					for(match = 0; (match < limit) && (data[candidate + match] == data[position + match]); match++);
+					
+					if(match > best) {
+						best = match;
+						best_distance = position - candidate;
+						if(best == limit) {
+							break;
+							
+						}
+						
+					}
+					
+				}
+				
+				candidate = chain[candidate % DEFLATE_WINDOW];
+				
+			}
+			
+		}
+		
+		if(best >= DEFLATE_MIN_MATCH) {
+			symbols[count].length = best;
+			symbols[count++].distance = best_distance;
+			
+		} else {
+			best = 1;
+			symbols[count].length = data[position];
+			symbols[count++].distance = 0;
+			
+		}
+		
+		// Every position the symbol covers becomes a candidate for later matches
+		for(index = 0; index < best; index++, position++) {
+			if(position + DEFLATE_MIN_MATCH <= length) {
+				hash = deflate_hash(data + position);
+				chain[position % DEFLATE_WINDOW] = head[hash];
+				head[hash] = position + 1;
+				
+			}
+			
+		}
+		
+		if(count == DEFLATE_BLOCK_SYMBOLS) {
+			write_block(writer, symbols, count, final && (position == length));
+			count = 0;
+			
+		}
+		
+	}
+	
+	if((count > 0) || (final != 0)) {
+		write_block(writer, symbols, count, final);
+		
+	}
+	
+	if(final == 0) {
+		// Empty stored block
+		put_bits(writer, 0, 3);
+		align_bits(writer);
+		put_bits(writer, 0x0000, 16);
+		put_bits(writer, 0xFFFF, 16);
+		
+	}
+	
+	align_bits(writer);
+	
+	free(symbols);
+	free(head);
+	free(chain);
+	
+}
+
+
+/**
+ * Returns the Paeth predictor of a byte from its left, upper and upper left neighbours.
+ *
+ * @param a - byte to the left
+ * @param b - byte above
+ * @param c - byte above and to the left
+ * @returns the neighbour closest to a + b - c
+ */
+static int paeth(int a, int b, int c) {
+	int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - c - c);
+	
+	return (((pa <= pb) && (pa <= pc)) ? a : ((pb <= pc) ? b : c));
+	
+}
+
+
+/**
+ * Applies one PNG filter to a row. The first pixel has no left neighbour, its left and upper
+ * left bytes count as 0.
+ *
+ * @param filter - 0 none, 1 sub, 2 up, 3 average, 4 paeth
+ * @param row - the row's bytes
+ * @param above - bytes of the row above
+ * @param length - bytes per row, at least 3
+ * @param output - receives the filtered row
+ * @returns sum of the absolute values of the filtered bytes, read as signed bytes
+ */
+static long apply_filter(int filter, const unsigned char *row, const unsigned char *above, int length, unsigned char *output) {
+	long sum = 0;
+	int index;
+	
+	// One loop per filter so each stays free of branches
+	if(filter == 0) {
+		memcpy(output, row, length);
+		
+	} else if(filter == 1) {
+		memcpy(output, row, 3);
+		for(index = 3; index < length; index++) {
+			output[index] = row[index] - row[index - 3];
+			
+		}
+		
+	} else if(filter == 2) {
+		for(index = 0; index < length; index++) {
+			output[index] = row[index] - above[index];
+			
+		}
+		
+	} else if(filter == 3) {
+		for(index = 0; index < 3; index++) {
+			output[index] = row[index] - (above[index] >> 1);
+			
+		}
+		for(index = 3; index < length; index++) {
+			output[index] = row[index] - ((row[index - 3] + above[index]) >> 1);
+			
+		}
+		
+	} else {
+		for(index = 0; index < 3; index++) {
+			output[index] = row[index] - above[index];
+			
+		}
+		for(index = 3; index < length; index++) {
+			output[index] = row[index] - paeth(row[index - 3], above[index], above[index - 3]);
+			
+		}
+		
+	}
+	
+	for(index = 0; index < length; index++) {
+		sum += abs((signed char)output[index]);
+		
+	}
+	
+	return (sum);
+	
+}
+
+
+/**
+ * Filters one image row. All five PNG filters are tried and the one whose output has the
+ * smallest sum of absolute values, read as signed bytes, is kept.
+ *
+ * @param row - the row's bytes, scaled to 0 - 255
+ * @param above - bytes of the row above, zeros for the first row
+ * @param length - bytes per row
+ * @param candidates - scratch space of 5 * length bytes
+ * @param output - receives the filter type followed by the filtered row
+ */
+static void filter_row(const unsigned char *row, const unsigned char *above, int length, unsigned char *candidates, unsigned char *output) {
+	long sum, best_sum;
+	int filter, best;
+	
+	best = 0;
+	best_sum = -1;
+	
+	for(filter = 0; filter < 5; filter++) {
+		sum = apply_filter(filter, row, above, length, candidates + (size_t)filter * length);
+		if((best_sum < 0) || (sum < best_sum)) {
+			best = filter;
+			best_sum = sum;
+			
+		}
+		
+	}
+	
+	output[0] = best;
+	memcpy(output + 1, candidates + (size_t)best * length, length);
+	
+}
+
+
+/**
+ * Copies an image row into bytes, scaling channels to 0 - 255 when the image uses another
+ * maximum color value.
+ *
+ * @param image - the image
+ * @param row - the row
+ * @param scale - value of each channel value in 0 - 255
+ * @param output - receives width * 3 bytes
+ */
+static void scale_row(Image *image, int row, const unsigned char *scale, unsigned char *output) {
+	const unsigned char *channels = (const unsigned char *)image_pixel(image, row, 0);
+	int index;
+	
+	for(index = 0; index < image->width * 3; index++) {
+		output[index] = scale[channels[index]];
+		
+	}
+	
+}
+
+
+/**
+ * Filters and compresses one band of rows, called by the thread pool once per band.
+ *
+ * @param context - pointer to the PngJob describing the encode
+ * @param task - index of the band
+ * @param thread_id - worker executing the band
+ */
+static void png_task(void *context, int task, int thread_id) {
+	PngJob *job = (PngJob *)context;
+	PngBand *band = &job->bands[task];
+	unsigned char scale[256];
+	unsigned char *filtered, *candidates, *current, *above, *swap;
+	int row, first, last, stride, value;
+	
+	first = task * job->band_rows;
+	last = first + job->band_rows;
+	last = (last > job->image->height) ? job->image->height : last;
+	stride = job->image->width * 3;
+	
+	for(value = 0; value < 256; value++) {
+		scale[value] = (value >= job->image->max_color) ? 255 : (value * 255 + job->image->max_color / 2) / job->image->max_color;
+		
+	}
+	
+	band->length = (size_t)(last - first) * (stride + 1);
+	filtered = (unsigned char *)malloc(band->length);
+	candidates = (unsigned char *)malloc((size_t)stride * 5);
+	current = (unsigned char *)malloc(stride);
+	above = (unsigned char *)calloc(stride, 1);
+	if((filtered == NULL) || (candidates == NULL) || (current == NULL) || (above == NULL)) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	// The row above the band is filtered against, not compressed
+	if(first > 0) {
+		scale_row(job->image, first - 1, scale, above);
+		
+	}
+	
+	for(row = first; row < last; row++) {
+		scale_row(job->image, row, scale, current);
+		filter_row(current, above, stride, candidates, filtered + (size_t)(row - first) * (stride + 1));
+		
+		swap = above;
+		above = current;
+		current = swap;
+		
+	}
+	
+	band->adler = adler32(filtered, band->length);
+	
+	band->output.data = NULL;
+	band->output.size = band->output.capacity = 0;
+	band->output.bits = 0;
+	band->output.count = 0;
+	
+	if(task == 0) {
+		// zlib header, deflate with a 32K window
+		put_bits(&band->output, 0x78, 8);
+		put_bits(&band->output, 0x9C, 8);
+		
+	}
+	
+	deflate_data(&band->output, filtered, band->length, task == job->num_bands - 1);
+	
+	// The last band's chunk also holds the checksum of the whole stream, its crc comes later
+	if(task != job->num_bands - 1) {
+		band->crc = crc_update(crc_update(0xFFFFFFFFu, (const unsigned char *)"IDAT", 4), band->output.data, band->output.size) ^ 0xFFFFFFFFu;
+		
+	}
+	
+	free(filtered);
+	free(candidates);
+	free(current);
+	free(above);
+	
+}
+
+
+/**
+ * Stores a 32 bit value in network byte order.
+ *
+ * @param output - receives 4 bytes
+ * @param value - the value
+ */
+static void put_u32(unsigned char *output, unsigned int value) {
+	output[0] = value >> 24;
+	output[1] = value >> 16;
+	output[2] = value >> 8;
+	output[3] = value;
+	
+}
+
+
+/**
+ * Writes a PNG chunk.
+ *
+ * @param fpointer - the file
+ * @param type - the four letter chunk type
+ * @param data - the chunk data
+ * @param length - length of the chunk data
+ * @param crc - crc of the type and data
+ * @returns 1 if the chunk was written, 0 otherwise
+ */
+static int write_chunk(FILE *fpointer, const char *type, const unsigned char *data, size_t length, unsigned int crc) {
+	unsigned char header[8], trailer[4];
+	
+	put_u32(header, length);
+	memcpy(header + 4, type, 4);
+	put_u32(trailer, crc);
+	
+	return ((fwrite(header, 1, 8, fpointer) == 8) && (fwrite(data, 1, length, fpointer) == length) && (fwrite(trailer, 1, 4, fpointer) == 4));
+	
+}
+
+
+/**
+ * Checks whether a file name asks for a PNG image by its .png extension.
+ *
+ * @param filename - string pointer that represents a file name
+ * @returns 1 for PNG images, 0 otherwise
+ */
+int is_png_file(char *filename) {
+	size_t length = strlen(filename);
+	
+	return ((length > 4) && (strcmp(filename + length - 4, ".png") == 0));
+	
+}
+
+
+/**
+ * Writes an image as an 8 bit RGB PNG. The rows are split into bands of about 1 MB that are
+ * filtered and deflated on the pool's workers, each into its own IDAT chunk. A band's matches
+ * never reach into the band before it and every band but the last ends with an empty stored
+ * block, so the chunks join into one valid zlib stream whose checksum is combined from the
+ * bands' checksums. Returns on errors instead of exiting, for processes that outlive a failed
+ * write; a partly written file is removed.
+ *
+ * @param filename - string pointer that represents a file name
+ * @param image - an image structure, holding the whole image
+ * @param pool - thread pool that compresses the bands, NULL to compress on the calling thread
+ * @param error - receives the message of an error, the one write_png_image would print
+ * @param error_size - size of the error buffer
+ * @returns 1 when the image was written, 0 otherwise
+ */
+int try_write_png_image(char *filename, Image *image, struct ThreadPool *pool, char *error, size_t error_size) {
+	static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+	unsigned char header[13], checksum[4];
+	unsigned int adler;
+	PngBand *last;
+	PngJob job;
+	FILE *fpointer;
+	int index, written;
+	
+	png_init();
+	
+	job.image = image;
+	job.band_rows = PNG_BAND_BYTES / (image->width * 3 + 1);
+	job.band_rows = (job.band_rows < 1) ? 1 : job.band_rows;
+	job.num_bands = (image->height + job.band_rows - 1) / job.band_rows;
+	job.num_bands = (job.num_bands < 1) ? 1 : job.num_bands;
+	job.bands = (PngBand *)malloc(sizeof(PngBand) * job.num_bands);
+	if(job.bands == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	if(pool != NULL) {
+		threadpool_run(pool, png_task, &job, job.num_bands);
+		
+	} else {
+		for(index = 0; index < job.num_bands; index++) {
+			png_task(&job, index, 0);
+			
+		}
+		
+	}
+	
+	// Checksum of the whole stream goes at the end of the last band
+	adler = job.bands[0].adler;
+	for(index = 1; index < job.num_bands; index++) {
+		adler = adler32_combine(adler, job.bands[index].adler, job.bands[index].length);
+		
+	}
+	
+	last = &job.bands[job.num_bands - 1];
+	put_u32(checksum, adler);
+	for(index = 0; index < 4; index++) {
+		put_bits(&last->output, checksum[index], 8);
+		
+	}
+	last->crc = crc_update(crc_update(0xFFFFFFFFu, (const unsigned char *)"IDAT", 4), last->output.data, last->output.size) ^ 0xFFFFFFFFu;
+	
+	fpointer = fopen(filename, "wb");
+	if(fpointer == NULL) {
+		for(index = 0; index < job.num_bands; index++) {
+			free(job.bands[index].output.data);
+			
+		}
+		free(job.bands);
+		
+		snprintf(error, error_size, "Error, unable to open file.");
+		return (0);
+		
+	}
+	
+	// Width, height, 8 bits per channel, RGB, deflate, adaptive filtering, not interlaced
+	put_u32(header, image->width);
+	put_u32(header + 4, image->height);
+	header[8] = 8;
+	header[9] = 2;
+	header[10] = header[11] = header[12] = 0;
+	
+	written = (fwrite(signature, 1, 8, fpointer) == 8);
+	written &= write_chunk(fpointer, "IHDR", header, 13, crc_update(crc_update(0xFFFFFFFFu, (const unsigned char *)"IHDR", 4), header, 13) ^ 0xFFFFFFFFu);
+	
+	for(index = 0; index < job.num_bands; index++) {
+		written &= write_chunk(fpointer, "IDAT", job.bands[index].output.data, job.bands[index].output.size, job.bands[index].crc);
+		free(job.bands[index].output.data);
+		
+	}
+	
+	written &= write_chunk(fpointer, "IEND", NULL, 0, crc_update(0xFFFFFFFFu, (const unsigned char *)"IEND", 4) ^ 0xFFFFFFFFu);
+	free(job.bands);
+	
+	// Close file stream flush all buffers
+	if((fclose(fpointer) != 0) || (written == 0)) {
+		snprintf(error, error_size, "Error, unable to write file.");
+		remove_partial_image(filename);
+		return (0);
+		
+	}
+	
+	return (1);
+	
+}
+
+
+/**
+ * Writes an image as a PNG like try_write_png_image, exiting the program on errors.
+ *
+ * @param filename - string pointer that represents a file name
+ * @param image - an image structure, holding the whole image
+ * @param pool - thread pool that compresses the bands, NULL to compress on the calling thread
+ */
+void write_png_image(char *filename, Image *image, struct ThreadPool *pool) {
+	char message[PPM_ERROR_SIZE];
+	
+	if(try_write_png_image(filename, image, pool, message, sizeof(message)) == 0) {
+		fprintf(stderr, "%s\n", message);
+		exit(-1);
+		
+	}
+	
+}
@@ -9,8 +9,15 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "ppm.h"
+#include "..\filemap\filemap.h"
 
 /**
  * This function checks if three integer values against a maximum and minimum values and its primary function 
@@ -35,225 +42,639 @@ int check_rgb_bits(int red, int green, int blue, int max, int min) {
 
 
 /**
- * Takes in two pointers as parameters, a filename of a ppm image and image structure
- * use to store data read in from the ppm image file.
+ * Reads a decimal number of the header the way fscanf's %d does, skipping the whitespace and
+ * any comments in front of it.
  *
- * @param filename - string pointer that represents a file name
- * @param image - an image structure 
+ * @param data - contents of the file
+ * @param size - size of the file
+ * @param position - offset to read from, advanced past the number
+ * @param value - receives the number, values past 999999999 are capped there
+ * @returns 1 if a number was read, 0 otherwise
  */
-void read_image(char *filename, Image *image) {
+static int read_number(char *data, size_t size, size_t *position, int *value) {
+	size_t index = *position;
+	int sign, number, digits;
 	
-    char buffer[64];
-	FILE *fpointer;
-	int row, column, red, green, blue;
+	while((index < size) && (isspace((unsigned char)data[index]) || (data[index] == '#'))) {
+		// A comment runs to the end of the line
+		if(data[index] == '#') {
+			while((index < size) && (data[index] != '\n')) {
+				index++;
+				
+			}
+			
+		} else {
+			index++;
+			
+		}
+		
+	}
 	
-	// Open file steam for reading
-	fpointer = fopen(filename, "r");
+	sign = 1;
+	if((index < size) && ((data[index] == '-') || (data[index] == '+'))) {
+		sign = (data[index] == '-') ? -1 : 1;
+		index++;
+		
+	}
 	
-	// Check to see if file was opened successfully
-	if(fpointer == NULL) {
-		fprintf(stderr, "Error, unable to open file.\n");
-
-		// Close file stream flush all buffers
-		fclose(fpointer);
-		exit(-1);
-		 
-	} else {
-		// Make sure we are reading from the beginning of the file
-		rewind(fpointer);
-
-		// Read in the first to characters
-		buffer[0] = fgetc(fpointer);
-		buffer[1] = fgetc(fpointer);
-
-		// Check the magic number
-		if((buffer[0] == 'P') && (buffer[1] == '6')) {
-			image->magic_number = "P6";
-
-		} else if((buffer[0] == 'P') && (buffer[1] == '3')) {
-			image->magic_number = "P3";
-
+	number = 0;
+	for(digits = 0; (index < size) && (data[index] >= '0') && (data[index] <= '9'); digits++) {
+		if(number < 100000000) {
+			number = number * 10 + (data[index] - '0');
+			
 		} else {
-			 fprintf(stderr, "Error, unacceptable image format while reading in the file.\n Magic number must be P6 or P3.\n");
-			 exit(-2);
-			 
+			number = 999999999;
+			
 		}
+		index++;
+		
+	}
+	
+	if(digits == 0) {
+		return (0);
+		
+	}
+	
+	*position = index;
+	*value = sign * number;
+	return (1);
+	
+}
 
-		// Ignore comments, whitespaces, carrage returns, and tabs
-		while(isdigit(buffer[0]) == 0){
-			// If you run into a comment proceed till you reach an newline character
-			if(buffer[0] == '#') {
-				do {
-					buffer[0] = fgetc(fpointer);
-					
-				} while(buffer[0] != '\n');
 
-			} else {
-				buffer[0] = fgetc(fpointer);
+/**
+ * Reads the ascii pixel data of a P3 image, three decimal channel values per pixel separated
+ * by whitespace. Works straight on the mapped file, a channel takes a table lookup per
+ * character instead of a call to fscanf.
+ *
+ * @param data - contents of the file
+ * @param size - size of the file
+ * @param position - offset of the first channel value
+ * @param image - image that receives the pixels, image_data already allocated
+ */
+static void read_p3_pixels(char *data, size_t size, size_t position, Image *image) {
+	unsigned char classes[256];			//<= 1 for whitespace, 2 for digits, 0 otherwise
+	unsigned char *channel, *end;
+	size_t index;
+	int value, character;
+	
+	memset(classes, 0, sizeof(classes));
+	for(character = 0; character < 256; character++) {
+		if(isspace(character)) {
+			classes[character] = 1;
+			
+		} else if((character >= '0') && (character <= '9')) {
+			classes[character] = 2;
+			
+		}
+		
+	}
+	
+	// Pixel is three packed channels, red, green and blue
+	channel = (unsigned char *)image->image_data;
+	end = channel + (size_t)(image->width) * image->height * 3;
+	index = position;
+	
+	while(channel < end) {
+		while((index < size) && (classes[(unsigned char)data[index]] == 1)) {
+			index++;
+			
+		}
+		
+		if((index < size) && (classes[(unsigned char)data[index]] == 2)) {
+			value = 0;
+			while((index < size) && (classes[(unsigned char)data[index]] == 2)) {
+				value = (value <= 255) ? value * 10 + (data[index] - '0') : value;
+				index++;
 				
 			}
-
+			
+		} else if((index < size) && (data[index] == '-') && (index + 1 < size) && (classes[(unsigned char)data[index + 1]] == 2)) {
+			// Negative values are out of range like those over 255
+			value = -1;
+			
+		} else {
+			fprintf(stderr, "Error, missing or invalid color value in the image data.\n");
+			exit(-2);
+			
 		}
 		
-		// Move back one character, tried using 
-		ungetc(buffer[0], fpointer);
-
-		// Read in <width> whitespace <height>
-		if(fscanf(fpointer, "%d %d", &image->width, &image->height) != 2) {
-			 fprintf(stderr, "Error, invalid width and/or height while reading in the file.\n");
-			 exit(-2);
-			 
+		if((value > 255) || (value < 0)) {
+			fprintf(stderr, "Error, a channel color value is not 8-bits.\n");
+			exit(-3);
+			
 		}
 		
-		// Read in <maximum color value>
-		if(fscanf(fpointer, "%d", &image->max_color) != 1) {
-			 fprintf(stderr, "Error, invalid maximum color value.\n");
-			 exit(-2);
-			 
-		}
+		*channel++ = (unsigned char)value;
+		
+	}
+	
+}
+
 
-		// Validate 8-bit color value
-		if((image->max_color > 255) || (image->max_color < 0)) {
-			 fprintf(stderr, "Error, input file's maximum color value is not 8-bits per channel.\n");
-			 exit(-2);
-			 
+/**
+ * Reads the offset and full size out of a region comment, "# region x y width height".
+ *
+ * @param data - image file data
+ * @param size - size of the data in bytes
+ * @param position - offset of the '#' that starts the comment
+ * @param region - receives the column, row, full width and full height
+ * @returns 1 when the comment is a region comment, 0 otherwise
+ */
+static int read_region_comment(char *data, size_t size, size_t position, int *region) {
+	size_t end;
+	int index;
+	
+	if((size - position < 8) || (memcmp(data + position, "# region", 8) != 0)) {
+		return 0;
+		
+	}
+	
+	// Numbers are only read up to the end of the comment's line
+	for(end = position; (end < size) && (data[end] != '\n'); end++);
+	
+	position += 8;
+	for(index = 0; index < 4; index++) {
+		if(read_number(data, end, &position, &region[index]) == 0) {
+			return 0;
+			
 		}
 		
-		// Allocated memory size for image data
-		image->image_data = malloc(sizeof(Pixel) * image->width * image->height);
+	}
+	
+	return 1;
+	
+}
 
-		// If magic number is P6 fread, if magic number is P3 for loop
-		if(image->magic_number[1] == '6') {
-			// Advance the file pointer by one char
-			fgetc(fpointer);
-			
-			// Read in raw image data
-			fread(image->image_data, sizeof(Pixel), image->width * image->height, fpointer);
-						
-		} else if(image->magic_number[1] == '3') {
-			// Read in ascii image data
-			for(row = 0; row < image->height; row++) {
-				for(column = 0; column < image->width; column++) {					
-
-					// Have to store values into int, larger values more then 1 byte will be truncated
-					// therefore making it not possible to check for color channels values over 8-bits	
-					fscanf(fpointer, "%d", &red);
-					fscanf(fpointer, "%d", &green);
-					fscanf(fpointer, "%d", &blue);					
-					
-					if(check_rgb_bits(red, green, blue, 255, 0) == 1) {
-						fprintf(stderr, "Error, a channel color value is not 8-bits.\n");
-						exit(-3);
-						
-					} else {
-						image->image_data[(image->width) * row + column].red = red;
-						image->image_data[(image->width) * row + column].green = green;
-						image->image_data[(image->width) * row + column].blue = blue;
-						
-					}					
-		
-				}
+
+/**
+ * Reads a ppm image into an image structure. The file is mapped into memory and parsed in
+ * place, P6 pixel data is copied as it is. With keep_region set, a P6 image that carries a
+ * region comment is read as that region of its full size image.
+ *
+ * @param filename - string pointer that represents a file name
+ * @param image - an image structure
+ * @param keep_region - 1 to honour a region comment, 0 to read the pixels as a whole image
+ */
+static void load_image(char *filename, Image *image, int keep_region) {
+	char *data;
+	size_t size, position, count;
+	int mapped, has_region;
+	int region[4];
+	
+	// Map file for reading
+	data = map_file(filename, &size, &mapped);
+	
+	// Check to see if file was opened successfully
+	if(data == NULL) {
+		fprintf(stderr, "Error, unable to open file.\n");
+		exit(-1);
+		 
+	}
+	
+	// Check the magic number
+	if((size >= 2) && (data[0] == 'P') && (data[1] == '6')) {
+		image->magic_number = "P6";
+
+	} else if((size >= 2) && (data[0] == 'P') && (data[1] == '3')) {
+		image->magic_number = "P3";
+
+	} else {
+		 fprintf(stderr, "Error, unacceptable image format while reading in the file.\n Magic number must be P6 or P3.\n");
+		 exit(-2);
+		 
+	}
+
+	// Ignore comments, whitespaces, carrage returns, and tabs
+	position = 2;
+	has_region = 0;
+	while((position < size) && (isdigit((unsigned char)data[position]) == 0)) {
+		// If you run into a comment proceed till you reach an newline character
+		if(data[position] == '#') {
+			if((keep_region != 0) && (image->magic_number[1] == '6') && (read_region_comment(data, size, position, region) != 0)) {
+				has_region = 1;
 				
 			}
 			
+			while((position < size) && (data[position] != '\n')) {
+				position++;
+				
+			}
+
 		} else {
-			fprintf(stderr, "Error, invalid magic number.\n");
+			position++;
+			
+		}
+
+	}
+
+	// Read in <width> whitespace <height>
+	if((read_number(data, size, &position, &image->width) == 0) || (read_number(data, size, &position, &image->height) == 0)) {
+		 fprintf(stderr, "Error, invalid width and/or height while reading in the file.\n");
+		 exit(-2);
+		 
+	}
+	
+	// Read in <maximum color value>
+	if(read_number(data, size, &position, &image->max_color) == 0) {
+		 fprintf(stderr, "Error, invalid maximum color value.\n");
+		 exit(-2);
+		 
+	}
+
+	// Validate 8-bit color value
+	if((image->max_color > 255) || (image->max_color < 0)) {
+		 fprintf(stderr, "Error, input file's maximum color value is not 8-bits per channel.\n");
+		 exit(-2);
+		 
+	}
+	
+	if((image->width < 0) || (image->height < 0)) {
+		 fprintf(stderr, "Error, invalid width and/or height while reading in the file.\n");
+		 exit(-2);
+		 
+	}
+	
+	// Allocated memory size for image data, the whole image is held unless it is a region
+	count = (size_t)(image->width) * image->height;
+	image->image_data = malloc(sizeof(Pixel) * count);
+	image->band_start = 0;
+	image->band_height = image->height;
+	image->band_left = 0;
+	image->band_width = image->width;
+	
+	if(has_region != 0) {
+		if((region[0] < 0) || (region[1] < 0) || (region[2] - region[0] < image->width) || (region[3] - region[1] < image->height)) {
+			fprintf(stderr, "Error, the region comment does not fit the image.\n");
 			exit(-2);
 			
 		}
+		
+		image->band_left = region[0];
+		image->band_start = region[1];
+		image->width = region[2];
+		image->height = region[3];
+		
+	}
+	
+	if((image->image_data == NULL) && (count > 0)) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
 
-		// Close file stream flush all buffers
-		fclose(fpointer);	
+	// If magic number is P6 copy the raw data, if magic number is P3 parse the ascii data
+	if(image->magic_number[1] == '6') {
+		// Skip the single whitespace character after the header
+		position++;
+		
+		if((position > size) || (size - position < sizeof(Pixel) * count)) {
+			fprintf(stderr, "Error, the image data is shorter than the image.\n");
+			exit(-2);
+			
+		}
+		
+		memcpy(image->image_data, data + position, sizeof(Pixel) * count);
+					
+	} else {
+		read_p3_pixels(data, size, position, image);
 		
 	}
+
+	// Release the mapping
+	unmap_file(data, size, mapped);
 	
 }
 
 
 /**
- * This function writes ASCII data into ppm p6 format. Accepts two parameters, a pointer to a file stream 
- * and a poiner to an image structure. Writes to the file stream using fwrite.
+ * Takes in two pointers as parameters, a filename of a ppm image and image structure
+ * use to store data read in from the ppm image file. The file is mapped into memory and
+ * parsed in place, P6 pixel data is copied as it is.
  *
  * @param filename - string pointer that represents a file name
  * @param image - an image structure
- * @returns void
  */
-void write_p6_image(char *filename, Image *image) {
+void read_image(char *filename, Image *image) {
+	load_image(filename, image, 0);
+	
+}
+
+
+/**
+ * Reads a partial image written by write_p6_image for a region of a render. width and height
+ * are set to the size of the whole image and the band fields to the region held in
+ * image_data. An image without a region comment is read as a region covering all of it.
+ *
+ * @param filename - string pointer that represents a file name
+ * @param image - an image structure
+ */
+void read_region_image(char *filename, Image *image) {
+	load_image(filename, image, 1);
+	
+}
+
+
+/**
+ * Removes what a failed write left of an image. Only regular files are removed, an output such
+ * as /dev/full is left alone.
+ *
+ * @param filename - string pointer that represents a file name
+ */
+void remove_partial_image(char *filename) {
+	struct stat status;
+	
+	if((stat(filename, &status) == 0) && S_ISREG(status.st_mode)) {
+		remove(filename);
+		
+	}
+	
+}
+
+
+/**
+ * This function writes ASCII data into ppm p6 format. Accepts two parameters, a pointer to a file stream
+ * and a poiner to an image structure. Writes to the file stream using fwrite. An image that
+ * only holds a region of its rows and columns is written as an image of the region's size,
+ * with a "# region x y width height" comment giving its offset and the size of the whole image.
+ * Returns on errors instead of exiting, for processes that outlive a failed write; a partly
+ * written file is removed.
+ *
+ * @param filename - string pointer that represents a file name
+ * @param image - an image structure
+ * @param error - receives the message of an error, the one write_p6_image would print
+ * @param error_size - size of the error buffer
+ * @returns 1 when the image was written, 0 otherwise
+ */
+int try_write_p6_image(char *filename, Image *image, char *error, size_t error_size) {
 	FILE *fpointer;
+	size_t count;
+	int failed;
+	
 	fpointer = fopen(filename, "wb");
 	
 	if(fpointer == NULL) {
-		fprintf(stderr, "Error, unable to open file.\n");
+		snprintf(error, error_size, "Error, unable to open file.");
+		return (0);
+		 
+	}
+	
+	fprintf(fpointer, "%s\n", "P6");
+	
+	if((image->band_left != 0) || (image->band_start != 0) || (image->band_width != image->width) || (image->band_height != image->height)) {
+		fprintf(fpointer, "# region %d %d %d %d\n", image->band_left, image->band_start, image->width, image->height);
+		
+	}
+	
+	fprintf(fpointer, "%d %d\n", image->band_width, image->band_height);
+	fprintf(fpointer, "%d\n", image->max_color);
+	
+	// ASCII code is a 7-bit code stored in a byte
+	count = (size_t)(image->band_width) * image->band_height;
+	failed = (fwrite(image->image_data, sizeof(Pixel), count, fpointer) != count);
+	
+	// Close file stream flush all buffers
+	if((fclose(fpointer) != 0) || (failed != 0)) {
+		snprintf(error, error_size, "Error, unable to write file.");
+		remove_partial_image(filename);
+		return (0);
+		
+	}
+	
+	return (1);
+	
+}
 
-		// Close file stream flush all buffers
-		fclose(fpointer);
+
+/**
+ * Writes an image as a P6 image like try_write_p6_image, exiting the program on errors.
+ *
+ * @param filename - string pointer that represents a file name
+ * @param image - an image structure
+ */
+void write_p6_image(char *filename, Image *image) {
+	char message[PPM_ERROR_SIZE];
+	
+	if(try_write_p6_image(filename, image, message, sizeof(message)) == 0) {
+		fprintf(stderr, "%s\n", message);
 		exit(-1);
-		 
-	} else {
-		fprintf(fpointer, "%s\n", "P6");
-		fprintf(fpointer, "%d %d\n", image->width, image->height);
-		fprintf(fpointer, "%d\n", image->max_color);
-			
-		// ASCII code is a 7-bit code stored in a byte
-		fwrite(image->image_data, sizeof(Pixel), image->width * image->height, fpointer);
 		
-		// Close file stream flush all buffers
-		fclose(fpointer);
+	}
+	
+}
+
+
+/**
+ * Writes the header of a P6 image, the same one write_p6_image writes.
+ *
+ * @param buffer - receives the header, 64 bytes is enough for any size
+ * @param image - an image structure
+ * @returns length of the header
+ */
+static int p6_header(char *buffer, Image *image) {
+	return sprintf(buffer, "%s\n%d %d\n%d\n", "P6", image->width, image->height, image->max_color);
+	
+}
+
+
+/**
+ * Creates a P6 file at its final size and maps it into memory, so the image is rendered
+ * straight into the file instead of a buffer that is written out afterwards. Points the
+ * image's image_data at the pixels of the mapping, whose offsets are fixed by the header.
+ * Unrendered pixels read as black, so the file can be looked at while it renders. Release
+ * the mapping with unmap_p6_image.
+ *
+ * @param filename - string pointer that represents a file name
+ * @param image - an image structure, its width, height and max_color set
+ * @returns 1 once the image is mapped, 0 if the file can not be mapped, e.g. a pipe, and has
+ *          to be written with write_p6_image instead
+ */
+int map_p6_image(char *filename, Image *image) {
+	char header[64];
+	struct stat status;
+	size_t size;
+	char *data;
+	int fd, length, error;
+	
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if(fd < 0) {
+		fprintf(stderr, "Error, unable to open file.\n");
+		exit(-1);
+		
+	}
+	
+	if((fstat(fd, &status) != 0) || (S_ISREG(status.st_mode) == 0)) {
+		close(fd);
+		return (0);
+		
+	}
+	
+	length = p6_header(header, image);
+	size = length + sizeof(Pixel) * image->width * image->height;
+	
+	// Reserve the blocks up front, a full disk is reported here rather than faulting mid render
+	error = posix_fallocate(fd, 0, size);
+	if((error != 0) && (error != EINVAL) && (error != EOPNOTSUPP)) {
+		fprintf(stderr, "Error, unable to write file.\n");
+		exit(-1);
 		
+	}
+	
+	if((error != 0) && (ftruncate(fd, size) != 0)) {
+		fprintf(stderr, "Error, unable to write file.\n");
+		exit(-1);
 		
 	}
 	
+	data = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	
+	if(data == MAP_FAILED) {
+		return (0);
+		
+	}
+	
+	memcpy(data, header, length);
+	image->image_data = (Pixel *)(data + length);
+	
+	return (1);
+	
+}
+
+
+/**
+ * Releases the mapping of an image mapped by map_p6_image, the file is complete once it
+ * returns.
+ *
+ * @param image - an image structure
+ */
+void unmap_p6_image(Image *image) {
+	char header[64];
+	int length;
+	
+	length = p6_header(header, image);
+	munmap((char *)(image->image_data) - length, length + sizeof(Pixel) * image->width * image->height);
+	image->image_data = NULL;
+	
 }
 
 
 /**
  * This function writes raw data into ppm p3 ASCII format. Accepts two parameters, a pointer to a file
- * stream and a poiner to an image structure. This function uses fprintf to write to the file stream
- * using a nested loop, converting integers to strings using sprintf then wites the string to an output.
+ * stream and a poiner to an image structure. Every channel value goes on a line of its own, the
+ * text of the 256 possible values is looked up in a table and collected in a large buffer that
+ * is written out with fwrite.
  *
  * @param filename - string pointer that represents a file name
  * @param image - an image structure
  * @returns void
- * @description 
  */
 void write_p3_image(char *filename, Image *image) {
-	int row, column;
-	char buffer[64];
+	char text[256][4];					//<= decimal text of every channel value and its newline
+	unsigned char lengths[256];
+	unsigned char *channel, *end;
+	char *buffer;
+	size_t used;
+	int value, failed;
 	FILE *fpointer;
 	
 	fpointer = fopen(filename, "w");
 	
 	if(fpointer == NULL) {
 		fprintf(stderr, "Error, unable to open file.\n");
-
-		// Close file stream flush all buffers
-		fclose(fpointer);
 		exit(-1);
 		 
-	} else {
-		fprintf(fpointer, "%s\n", "P3");
-		fprintf(fpointer, "%d %d\n", image->width, image->height);
-		fprintf(fpointer, "%d\n", image->max_color);
-		
-		// Read in ascii image data
-		for(row = 0; row < (image->height); row++) {
-			for(column = 0; column < (image->width); column++) {
-				sprintf(buffer, "%d", image->image_data[(image->width) * row + column].red);
-				fprintf(fpointer, "%s\n", buffer);
-				
-				sprintf(buffer, "%d", image->image_data[(image->width) * row + column].green);
-				fprintf(fpointer, "%s\n", buffer);
-				
-				sprintf(buffer, "%d", image->image_data[(image->width) * row + column].blue);
-				fprintf(fpointer, "%s\n", buffer);				
+	}
+	
+	buffer = (char *)malloc(PPM_BUFFER_SIZE);
+	if(buffer == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
 		
-			}
+	}
+	
+	for(value = 0; value < 256; value++) {
+		lengths[value] = sprintf(buffer, "%d\n", value);
+		memcpy(text[value], buffer, 4);
+		
+	}
+	
+	fprintf(fpointer, "%s\n", "P3");
+	fprintf(fpointer, "%d %d\n", image->width, image->height);
+	fprintf(fpointer, "%d\n", image->max_color);
+	
+	// Pixel is three packed channels, red, green and blue
+	channel = (unsigned char *)image->image_data;
+	end = channel + (size_t)(image->width) * image->height * 3;
+	used = 0;
+	failed = 0;
+	
+	while(channel < end) {
+		// Every value copies 4 bytes, room for the longest value is kept at the end
+		if(used > PPM_BUFFER_SIZE - 4) {
+			failed |= (fwrite(buffer, 1, used, fpointer) != used);
+			used = 0;
 			
 		}
 		
-		// Close file stream flush all buffers
-		fclose(fpointer);
+		memcpy(buffer + used, text[*channel], 4);
+		used += lengths[*channel++];
 		
 	}
 	
-}
\ No newline at end of file
+	failed |= (fwrite(buffer, 1, used, fpointer) != used);
+	free(buffer);
+	
+	// Close file stream flush all buffers
+	if((fclose(fpointer) != 0) || (failed != 0)) {
+		fprintf(stderr, "Error, unable to write file.\n");
+		exit(-1);
+		
+	}
+	
+}
+
+
+/**
+ * Names a file after another by inserting a printf formatted suffix before its extension,
+ * out.png with "-mip%d" and 1 gives out-mip1.png.
+ *
+ * @param path - path the file is named after
+ * @param format - printf format of the suffix
+ * @returns the path, to be freed by the caller
+ */
+char* path_with_suffix(char *path, const char *format, ...) {
+	va_list arguments, copy;
+	char *name, *extension;
+	size_t stem;
+	int length;
+	
+	// Only a dot after the last directory separator starts an extension
+	extension = strrchr(path, '.');
+	if((extension == NULL) || (strchr(extension, '/') != NULL) || (strchr(extension, '\\') != NULL)) {
+		extension = path + strlen(path);
+		
+	}
+	
+	stem = extension - path;
+	
+	va_start(arguments, format);
+	va_copy(copy, arguments);
+	length = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+	
+	name = (char *)malloc(stem + length + strlen(extension) + 1);
+	if(name == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	memcpy(name, path, stem);
+	vsprintf(name + stem, format, arguments);
+	va_end(arguments);
+	strcpy(name + stem + length, extension);
+	
+	return (name);
+	
+}
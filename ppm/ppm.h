@@ -8,7 +8,15 @@
  
 #ifndef ppm_h
 	#define ppm_h
-
+	
+	#include <stddef.h>
+	
+	// Bytes gathered before each write of an ascii image, and the first read size of a pipe
+	#define PPM_BUFFER_SIZE (1 << 20)
+	
+	// Size of the buffer the image writers' error messages are put in
+	#define PPM_ERROR_SIZE 256
+	
 	/**
 	 * Three 1 byte unsigned characters used to store RGB color
 	 * values of a pixel.
@@ -27,11 +35,40 @@
 		int width, height;
 		int max_color;
 		Pixel *image_data;
+		int band_start, band_height;	//<= rows held in image_data, the whole image unless streamed
+		int band_left, band_width;		//<= columns held in image_data, the whole width unless a region
 
 	} Image;
 
+	/**
+	 * Returns the pixel at a row and column of an image, rows and columns are counted from the
+	 * upper left corner of the whole image even when image_data only holds a band or region of
+	 * it. The offset is computed in 64 bits so images of more than 2^31 pixels index correctly.
+	 *
+	 * @param image - the image
+	 * @param row - pixel row, within the band held in image_data
+	 * @param column - pixel column, within the columns held in image_data
+	 * @returns pointer to the pixel
+	 */
+	static inline Pixel* image_pixel(Image *image, int row, int column) {
+		return (&image->image_data[(size_t)(image->band_width) * (row - image->band_start) + (column - image->band_left)]);
+		
+	}
+
+	struct ThreadPool;
+	
 	// function declarations
+	void read_image(char *filename, Image *image);
+	void read_region_image(char *filename, Image *image);
+	void remove_partial_image(char *filename);
+	int try_write_p6_image(char *filename, Image *image, char *error, size_t error_size);
 	void write_p6_image(char *filename, Image *image);
+	int map_p6_image(char *filename, Image *image);
+	void unmap_p6_image(Image *image);
+	int is_png_file(char *filename);
+	char* path_with_suffix(char *path, const char *format, ...);
+	int try_write_png_image(char *filename, Image *image, struct ThreadPool *pool, char *error, size_t error_size);
+	void write_png_image(char *filename, Image *image, struct ThreadPool *pool);
 	void write_p3_image(char *filename, Image *image);
  
 #endif
\ No newline at end of file
@@ -0,0 +1,258 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: progressive.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "..\math\real.h"
+#include "..\math\vector_math.h"
+#include "..\ppm\ppm.h"
+#include "..\json\json.h"
+#include "..\threadpool\threadpool.h"
+#include "..\scene\scene.h"
+#include "..\simd\simd.h"
+#include "..\bvh\bvh.h"
+#include "..\raycaster\raycaster.h"
+#include "..\stats\stats.h"
+#include "progressive.h"
+
+/**
+ * Writes the image as it currently is to a temporary file and renames it over the snapshot
+ * path, so a viewer never sees a half written file. A path ending in .png gets a PNG snapshot.
+ *
+ * @param path - file the snapshot is written to
+ * @param image - the image being rendered
+ * @param pool - thread pool that compresses PNG snapshots, NULL to compress on the calling thread
+ */
+static void write_snapshot(char *path, Image *image, ThreadPool *pool) {
+	char *temporary;
+	
+	temporary = (char *)malloc(strlen(path) + 5);
+	if(temporary == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	sprintf(temporary, "%s.tmp", path);
+	if(is_png_file(path) != 0) {
+		write_png_image(temporary, image, pool);
+		
+	} else {
+		write_p6_image(temporary, image);
+		
+	}
+	
+	if(rename(temporary, path) != 0) {
+		fprintf(stderr, "Error, unable to write snapshot '%s'.\n", path);
+		
+	}
+	
+	free(temporary);
+	
+}
+
+
+/**
+ * Copies a pixel over the block it stands for in a coarse pass, clipped to the image.
+ *
+ * @param image - the image being rendered
+ * @param row - row of the rendered pixel, the upper left corner of the block
+ * @param column - column of the rendered pixel
+ * @param size - width and height of the block
+ */
+static void fill_block(Image *image, int row, int column, int size) {
+	Pixel pixel = *image_pixel(image, row, column);
+	int y, x;
+	
+	for(y = row; (y < row + size) && (y < image->height); y++) {
+		for(x = column; (x < column + size) && (x < image->width); x++) {
+			*image_pixel(image, y, x) = pixel;
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Renders the pixels of one image row that belong to a pass, four to a packet.
+ *
+ * @param scene - the scene
+ * @param state - rendering state of the calling thread
+ * @param image - image that receives the pixels
+ * @param view - camera and pixel scaling values
+ * @param pass - the pass being rendered
+ * @param row - image row, a multiple of the pass stride
+ */
+static void raycast_pass_row(Scene *scene, WorkerState *state, Image *image, View *view, Pass *pass, int row) {
+	RayPacket packet;					//<= view vectors of the gathered pixels
+	real ro[3], rd[3];				//<= view vector orgin and direction
+	int columns[PACKET_SIZE];			//<= column of the pixel in each lane
+	int column, lanes, lane;
+	
+	ro[0] = ro[1] = ro[2] = 0.0;
+	column = 0;
+	
+	while(column < image->width) {
+		// Gather the next pixels of the pass
+		lanes = 0;
+		while((lanes < PACKET_SIZE) && (column < image->width)) {
+			if((pass->skip == 0) || ((row % pass->skip) != 0) || ((column % pass->skip) != 0)) {
+				columns[lanes++] = column;
+				
+			}
+			
+			column = column + pass->stride;
+			
+		}
+		
+		for(lane = 0; lane < PACKET_SIZE; lane++) {
+			if(lane < lanes) {
+				view_ray(view, row, columns[lane], rd);
+				
+			} else {
+				// Inactive lane, a NaN direction never hits anything
+				rd[0] = rd[1] = rd[2] = NAN;
+				
+			}
+			
+			packet.ox[lane] = ro[0];
+			packet.oy[lane] = ro[1];
+			packet.oz[lane] = ro[2];
+			packet.dx[lane] = rd[0];
+			packet.dy[lane] = rd[1];
+			packet.dz[lane] = rd[2];
+			packet.ignore[lane] = -1;
+			
+		}
+		
+		packet_closest(scene, &packet);
+		
+		for(lane = 0; lane < lanes; lane++) {
+			rd[0] = packet.dx[lane];
+			rd[1] = packet.dy[lane];
+			rd[2] = packet.dz[lane];
+			
+			shade_pixel(scene, state, image, row, columns[lane], ro, rd, packet.object[lane], packet.distance[lane]);
+			
+			if(pass->stride > 1) {
+				fill_block(image, row, columns[lane], pass->stride);
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Renders one row of a pass, called by the thread pool once per row.
+ *
+ * @param context - pointer to the PassJob describing the slice
+ * @param task - index of the row within the slice
+ * @param thread_id - worker executing the row
+ */
+static void raycast_pass_task(void *context, int task, int thread_id) {
+	PassJob *job = (PassJob *)context;
+	
+	raycast_pass_row(job->scene, &job->states[thread_id], job->image, job->view, job->pass, (job->first_row + task) * job->pass->stride);
+	
+}
+
+
+/**
+ * Progressive version of raycaster. A coarse pass renders every 8th pixel of every 8th row with
+ * few bounces and paints it over its block, then passes at strides 4, 2 and 1 refine the image
+ * at full depth. The image is written to the snapshot path after the coarse pass and whenever
+ * flush_interval seconds have passed since the last snapshot, so a render can be judged long
+ * before it finishes. The finished image is identical to the one raycaster produces.
+ *
+ * @param scene - scene created from the objects read in from the json parser
+ * @param image - is an Image object used to store image data
+ * @param pool - thread pool that renders the rows, NULL to render on the calling thread
+ * @param settings - per render parameters, receives the peak ray stack usage
+ * @param snapshot_path - file snapshots are written to, NULL for none
+ * @param flush_interval - seconds between snapshots
+ * @returns Image - pointer to the rendered image
+ */
+Image* raycaster_progressive(Scene *scene, Image *image, ThreadPool *pool, RenderSettings *settings, char *snapshot_path, double flush_interval) {
+	Pass passes[4] = {{8, 0, COARSE_DEPTH}, {4, 0, 0}, {2, 4, 0}, {1, 2, 0}};
+	View view;
+	PassJob job;
+	double last_flush;
+	int count, index, pass, rows, slice, row;
+	
+	count = (pool != NULL) ? pool->num_threads : 1;
+	
+	setup_view(scene, image, &view);
+	
+	job.scene = scene;
+	job.states = worker_states_create(scene, count, settings);
+	job.image = image;
+	job.view = &view;
+	
+	// Slices keep every worker busy while letting the calling thread write snapshots in between
+	slice = count * 8;
+	last_flush = wall_clock();
+	
+	for(pass = 0; pass < 4; pass++) {
+		job.pass = &passes[pass];
+		
+		if((passes[pass].max_depth == 0) || (passes[pass].max_depth > settings->max_depth)) {
+			passes[pass].max_depth = settings->max_depth;
+			
+		}
+		
+		for(index = 0; index < count; index++) {
+			job.states[index].max_depth = passes[pass].max_depth;
+			
+		}
+		
+		rows = (image->height + passes[pass].stride - 1) / passes[pass].stride;
+		
+		for(job.first_row = 0; job.first_row < rows; job.first_row += slice) {
+			if(pool != NULL) {
+				threadpool_run(pool, raycast_pass_task, &job, (rows - job.first_row < slice) ? (rows - job.first_row) : slice);
+				
+			} else {
+				for(row = job.first_row; (row < rows) && (row < job.first_row + slice); row++) {
+					raycast_pass_row(scene, &job.states[0], image, &view, &passes[pass], row * passes[pass].stride);
+					
+				}
+				
+			}
+			
+			if((snapshot_path != NULL) && (wall_clock() - last_flush >= flush_interval)) {
+				write_snapshot(snapshot_path, image, pool);
+				last_flush = wall_clock();
+				
+			}
+			
+		}
+		
+		// Show the coarse preview right away
+		if((snapshot_path != NULL) && (pass == 0)) {
+			write_snapshot(snapshot_path, image, pool);
+			last_flush = wall_clock();
+			
+		}
+		
+	}
+	
+	settings->peak_stack = worker_states_peak(job.states, count);
+	settings->samples = (long long)image->width * image->height;
+	worker_states_free(job.states, count);
+	
+	return image;
+	
+}
@@ -0,0 +1,45 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: progressive.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef progressive_h
+	#define progressive_h
+	
+	// Reflection and refraction bounces followed by the coarse preview pass
+	#define COARSE_DEPTH 1
+	#define DEFAULT_FLUSH_INTERVAL 2.0
+	
+	/**
+	 * One pass of a progressive render. The pass renders every pixel whose row and column are
+	 * multiples of stride, except those that are also multiples of skip and so were finished by
+	 * an earlier pass, and paints each over its stride by stride block. A skip of 0 skips nothing.
+	 */
+	typedef struct Pass {
+		int stride;
+		int skip;
+		int max_depth;
+		
+	} Pass;
+	
+	/**
+	 * Describes a slice of pass rows handed to the thread pool, task i renders pass row
+	 * first_row + i.
+	 */
+	typedef struct PassJob {
+		Scene *scene;
+		WorkerState *states;
+		Image *image;
+		View *view;
+		Pass *pass;
+		int first_row;
+		
+	} PassJob;
+	
+	// function declarations
+	Image* raycaster_progressive(Scene *scene, Image *image, ThreadPool *pool, RenderSettings *settings, char *snapshot_path, double flush_interval);
+	
+#endif
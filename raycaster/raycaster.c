@@ -5,18 +5,23 @@
  * File: raycaster.c
  * Copyright © 2016 All rights reserved 
  */
- 
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include "..\math\real.h"
 #include "..\math\vector_math.h"
 #include "..\ppm\ppm.h"
 #include "..\json\json.h"
+#include "..\threadpool\threadpool.h"
+#include "..\scene\scene.h"
+#include "..\simd\simd.h"
+#include "..\bvh\bvh.h"
+#include "..\stats\stats.h"
 #include "raycaster.h"
-
-int MAXIMUM_RECURSION_DEPTH = 7;
+#include "..\wavefront\wavefront.h"
 
 /**
  * Calculates specular highlighting by taking a light ray that hits the surface of an object 
@@ -30,25 +35,25 @@ int MAXIMUM_RECURSION_DEPTH = 7;
  * @param light_color - color of the light 
  * @param color - vector that stores computational values that is used 
  */
-void specular_highlight(double *normal, double *incident_ray, double *reflected_ray, double *rd, double *specular_color, double *light_color, double *color) {
-    double scalar1 = 0.0, scalar2 = 0.0, scalar3 = 0.0;
-	
+void specular_highlight(real *normal, real *incident_ray, real *reflected_ray, real *rd, real *specular_color, real *light_color, real *color) {
+    real scalar1 = 0.0, scalar2 = 0.0, scalar3 = 0.0;
+
 	scalar1 = vector_dot_product(normal, incident_ray);
 	scalar2 = vector_dot_product(rd, reflected_ray);
 	
     if ((scalar1 > 0) && (scalar2 > 0)) {
-        scalar3 = pow(scalar2, 25);
+        scalar3 = real_pow(scalar2, 25);
         color[0] = scalar3 * specular_color[0] * light_color[0];
         color[1] = scalar3 * specular_color[1] * light_color[1];
         color[2] = scalar3 * specular_color[2] * light_color[2];
-		
+
     } else {
         color[0] = 0;
         color[1] = 0;
         color[2] = 0;
-		
+
     }
-	
+
 }
 
 
@@ -62,16 +67,16 @@ void specular_highlight(double *normal, double *incident_ray, double *reflected_
  * @param diffuse_color - color emitted by the light
  * @param color - vector that stores computational values that is used 
  */
-void diffuse_reflection(double *normal, double *incident_ray, double *light_color, double *diffuse_color, double *color) {
-	double scalar = 0.0;
-
+void diffuse_reflection(real *normal, real *incident_ray, real *light_color, real *diffuse_color, real *color) {
+	real scalar = 0.0;
+	
 	scalar = vector_dot_product(normal, incident_ray);
 	
 	if(scalar > 0) {
 		color[0] = scalar * diffuse_color[0] * light_color[0];
 		color[1] = scalar * diffuse_color[1] * light_color[1];
 		color[2] = scalar * diffuse_color[2] * light_color[2];
-
+		
 	} else {
 		color[0] = 0;
 		color[1] = 0;
@@ -86,25 +91,24 @@ void diffuse_reflection(double *normal, double *incident_ray, double *light_colo
  * Calculates the angular attenuation value used for spotlights.
  * 
  * @param a0 - scalar value
- * @param theta - angle from the direction vector expressed in degrees
- * @param direction - direction of a spotlight
+ * @param light - compiled light, holds the spotlight direction and precomputed cone cosine
  * @param distance - fall off distance
  * @returns angular attenuation scalar value
  */
-double fang(double a0, double theta, double *direction, double *distance) {
-	double scalar = 0.0;
-	double new_distance[3] = {0, 0, 0};
+real fang(real a0, SceneLight *light, real *distance) {
+	real scalar = 0.0;
+	real new_distance[3] = {0, 0, 0};
 	
 	// Check the type of light
-	if((theta == 0.0) && (direction[0] == 0) && (direction[1] == 0) && (direction[2] == 0)) {
+	if(light->spotlight == 0) {
 		return (1.0);	// <= point light
 		
 	} else {
 		vector_scale(distance, -1, new_distance);
-		scalar = vector_dot_product(direction, new_distance);
+		scalar = vector_dot_product(light->direction, new_distance);
 		
-		if(scalar >= cos((theta * M_PI) / 180)) { // <= Convert degrees into radians; (degrees * pi) / 180
-			return (pow(scalar, a0));
+		if(scalar >= light->cos_theta) {
+			return (real_pow(scalar, a0));
 			
 		} else {
 			return (0);
@@ -112,7 +116,7 @@ double fang(double a0, double theta, double *direction, double *distance) {
 		}
 		
 	}
-		
+	
 }
 
 
@@ -125,18 +129,18 @@ double fang(double a0, double theta, double *direction, double *distance) {
  * @param distance - fall off distance of the light
  * @returns radial attenuation scalar value
  */
-double frad(double a0, double a1, double a2, double distance) {
-	double scalar = 0.0;
+real frad(real a0, real a1, real a2, real distance) {
+	real scalar = 0.0;
 	
 	if(distance < INFINITY) {
-		return ((1)/(a0 + (a1 * distance) + (a2 * pow(distance, 2))));
+		return ((1)/(a0 + (a1 * distance) + (a2 * real_pow(distance, 2))));
 		
 	} else {
 		// Some default value, distance = infinity
 		return (1.0);
 		
 	}
-
+	
 }
 
 
@@ -148,7 +152,7 @@ double frad(double a0, double a1, double a2, double distance) {
  * @param max - number that is the upper limit
  * @returns min if value is below lower limit, max if number is above upper limit, number otherwise
  */
-double clamp(double number, double min, double max) {
+real clamp(real number, real min, real max) {
 	if(number > max) {
 		return max;
 		
@@ -163,527 +167,1214 @@ double clamp(double number, double min, double max) {
 
 
 /**
- * Iterates through a scene or array of objects looking for an object with type camera and returns the index 
- * of that object in the scene array or -1 if no camera was found.
+ * Bends a ray passing through a surface by Snell's law. The normal may face either side of
+ * the surface, a ray leaving an object is bent by the object's index of refraction inverted.
  *
- * @param objects - an array of objects
- * @param num_objects - used to set the counter that iterates through an array of objects 
- * @returns the index value within the array the camera was found, -1 otherwise if the camera was not found
+ * @param direction - normalized direction of the incoming ray
+ * @param normal - normalized outward normal of the surface
+ * @param ior - index of refraction of the object, values below or equal to 0 are treated as 1
+ * @param refraction_vector - receives the direction of the transmitted ray
+ * @returns 1 if a ray is transmitted, 0 on total internal reflection
  */
-int get_camera(Object objects[], int num_objects) {
-	int i;
+int refraction(real *direction, real *normal, real ior, real *refraction_vector) {
+	real cos_i, eta, k;
+	real facing[3];
 	
-	for(i = 0; i < num_objects; i++) {
-		if(strcmp((objects[i].type), "camera") == 0) {
-			return (i);
-			
-		}
+	if(ior <= 0) {
+		ior = 1;
+		
+	}
+	
+	cos_i = -vector_dot_product(direction, normal);
+	
+	// Entering the object when the ray faces the normal, leaving it otherwise
+	if(cos_i >= 0) {
+		eta = 1 / ior;
+		vector_copy(normal, facing);
+		
+	} else {
+		eta = ior;
+		cos_i = -cos_i;
+		vector_scale(normal, -1, facing);
+		
+	}
+	
+	k = 1 - (eta * eta * (1 - (cos_i * cos_i)));
+	if(k < 0) {
+		return (0);
 		
 	}
 	
-	return(-1); //<= no camera found
+	vector_scale(direction, eta, refraction_vector);
+	vector_scale(facing, (eta * cos_i) - real_sqrt(k), facing);
+	vector_add(refraction_vector, facing, refraction_vector);
+	normalize(refraction_vector);
+	
+	return (1);
+	
+}
+
+/**
+ * Computes the unnormalized surface normal of a sphere or plane at a point.
+ *
+ * @param scene - the scene
+ * @param object - array index of the object
+ * @param point - point on the surface
+ * @param normal - receives the normal vector
+ */
+void surface_normal(Scene *scene, int object, real *point, real *normal) {
+	int slot = scene->slots[object];
+	
+	if(scene->types[object] == TYPE_SPHERE) {
+		normal[0] = point[0] - scene->spheres.x[slot];
+		normal[1] = point[1] - scene->spheres.y[slot];
+		normal[2] = point[2] - scene->spheres.z[slot];
+		
+	} else if(scene->types[object] == TYPE_PLANE) {
+		normal[0] = scene->planes.x[slot];
+		normal[1] = scene->planes.y[slot];
+		normal[2] = scene->planes.z[slot];
+		
+	}
 	
 }
 
 
 /**
- * This function calculates the distance a ray vector intersects the sphere.
+ * Computes the light a surface point reflects towards the viewer from one light, assuming
+ * nothing blocks the light.
  *
- * @param ro - ray vector orgin
- * @param rd - ray vector direction
- * @param center - sphere center aka position
- * @param radius - sphere radius
- * @returns double percision float t value that represents length of the intersecting vector, and -1 if no intersection was detected.
- */     
-double sphere_intersection(double *ro, double *rd, double *center, double radius) {
-	double a = 0.0, b = 0.0, c = 0.0, discriminant = 0.0, t1 = 0.0, t0 = 0.0;
+ * @param light - the light
+ * @param material - surface properties of the object the point lies on
+ * @param rd - normalized direction of the ray that hit the point
+ * @param light_rd - normalized direction from the point to the light
+ * @param light_distance - distance from the point to the light
+ * @param normal - normalized surface normal at the point
+ * @param color - receives the reflected light
+ */
+void light_contribution(SceneLight *light, Material *material, real *rd, real *light_rd, real light_distance, real *normal, real *color) {
+	real reflection_vector[3];		//<= reflection vector
+	real diffuse_out[3];				//<= diffuse scalar
+	real specular_out[3];				//<= specular scalar
+	real fang_out, frad_out;			//<= angular and radial attenuation output
+	
+	vector_reflection(light_rd, normal, reflection_vector);
 	
-	// Step 1.) Find the equation for the object you are interested in..  
-	// Step 2.) Parameterize the equation with a center point
-	// Step 3.) Substitute the eq for a ray into our object equation.
-	// Step 4.) Solve for t.
-	// Step 5.) Rewrite the equation (flatten).
+	diffuse_reflection(normal, light_rd, light->color, material->diffuse_color, diffuse_out);
+	specular_highlight(normal, light_rd, reflection_vector, rd, material->specular_color, light->color, specular_out);
 	
-	a = pow(rd[0], 2) + pow(rd[1], 2) + pow(rd[2], 2);
-	b = (2 * (rd[0] * (ro[0] - center[0]) + rd[1] * (ro[1] - center[1]) + rd[2] * (ro[2] - center[2])));
-	c = pow((ro[0] - center[0]), 2) + pow((ro[1] - center[1]), 2) + pow((ro[2] - center[2]), 2) - pow(radius, 2);
+	// Get angular and radial attenuation values
+	fang_out = fang(light->radial_a0, light, light_rd); 
+	frad_out = frad(light->radial_a0, light->radial_a1, light->radial_a2, light_distance);
 	
-	discriminant = pow(b, 2) - 4 * a * c;
+	// Combine angular attenuation, radial attenuation, diffuse color and specular color
+	color[0] = fang_out * frad_out * (diffuse_out[0] + specular_out[0]);
+	color[1] = fang_out * frad_out * (diffuse_out[1] + specular_out[1]);
+	color[2] = fang_out * frad_out * (diffuse_out[2] + specular_out[2]);
 	
-	if(discriminant < 0) {
-		return (-1); // <= has no solution
+}
+
+
+/**
+ * Shadow ray test towards one light. The object that blocked this light for the thread's
+ * previous shadow ray is tried first, neighbouring pixels usually share their occluders.
+ *
+ * @param scene - the scene
+ * @param state - rendering state of the calling thread
+ * @param light - index of the light
+ * @param point - orgin of the shadow ray
+ * @param light_rd - normalized direction from the point to the light
+ * @param ignore - object index excluded from the test, -1 to test every object
+ * @param light_distance - distance from the point to the light
+ * @returns array index of an object blocking the light, -1 if the light is visible
+ */
+int light_occluder(Scene *scene, WorkerState *state, int light, real *point, real *light_rd, int ignore, real light_distance) {
+	int occluder = state->last_occluder[light];
+	
+	if((occluder == -1) || (occluder == ignore) || (object_occludes(scene, occluder, point, light_rd, light_distance) == 0)) {
+		occluder = scene_occluded(scene, point, light_rd, ignore, light_distance);
+		state->last_occluder[light] = occluder;
+		
+	}
+	
+	STATS_ADD(shadow_rays, 1);
+	if(occluder != -1) {
+		STATS_ADD(occluded_shadow_rays, 1);
 		
 	}
+	
+	return (occluder);
+	
+}
+
 
-	// Quadratic Equation
-	t1 = (-1 * b + sqrt(pow(b, 2) - 4 * a * c)) / (2 * a);
-	t0 = (-1 * b - sqrt(pow(b, 2) - 4 * a * c)) / (2 * a);
+/**
+ * Adds up the light a surface point receives directly from every light that is not blocked by
+ * another object.
+ *
+ * @param scene - the scene
+ * @param state - rendering state of the calling thread
+ * @param rd - normalized direction of the ray that hit the point
+ * @param point - point on the surface
+ * @param normal - normalized surface normal at the point
+ * @param closest_object - array index of the object the point lies on
+ * @param color - receives the reflected light
+ */
+void direct_lighting(Scene *scene, WorkerState *state, real *rd, real *point, real *normal, int closest_object, real *color) {
+	real new_rd[3]; 					//<= light vector direction
+	real light_distance;				//<= distance to the light
+	real light_color[3];				//<= light reflected from a single light
+    int index;                          //<= iteration counter
+	int occluder;                       //<= array index of the object blocking the light
+	SceneLight *light;					//<= light being evaluated
+	
+	color[0] = color[1] = color[2] = 0;
 	
-	if(t0 >= 0) {
-		return t0;
+	// Iterate through light objects
+	for(index = 0; index < scene->num_lights; index++) {
+		light = &scene->lights[index];
 		
-	} else if(t1 >= 0) {
-		return t1;
+		// Calcuate new ray direction
+		vector_subtract(light->position, point, new_rd);
+		light_distance = vector_length(new_rd);
+		normalize(new_rd);	//<= Normalize new ray direction
 		
-	} else {
-		return (-1);
+		// Execute shadow intersection test, the closest object is skipped to prevent self intersecting
+		occluder = light_occluder(scene, state, index, point, new_rd, closest_object, light_distance);
+		
+		// No intersection detected
+		if(occluder == -1) {
+			light_contribution(light, &scene->materials[closest_object], rd, new_rd, light_distance, normal, light_color);
+			
+			color[0] += light_color[0];
+			color[1] += light_color[1];
+			color[2] += light_color[2];
+			
+		}
 		
 	}
+	
+}
 
+
+/**
+ * Mixes three integers into a well distributed hash, used to seed pseudo random numbers from
+ * pixel coordinates.
+ *
+ * @param a - first integer
+ * @param b - second integer
+ * @param c - third integer
+ * @returns hash of the three
+ */
+unsigned int sample_hash(unsigned int a, unsigned int b, unsigned int c) {
+	unsigned int hash;
+	
+	// Integer hash by Thomas Wang
+	hash = (a * 73856093u) ^ (b * 19349663u) ^ (c * 83492791u);
+	hash = (hash ^ 61) ^ (hash >> 16);
+	hash = hash + (hash << 3);
+	hash = hash ^ (hash >> 4);
+	hash = hash * 0x27d4eb2du;
+	hash = hash ^ (hash >> 15);
+	
+	return (hash);
+	
 }
 
 
 /**
- * This function calculates the distance a ray vector intersects the plane.
+ * Decides whether a secondary ray is worth tracing from the weight it would carry. A weight
+ * below the thread's min_weight ends the ray. With Russian roulette a weight below
+ * ROULETTE_WEIGHT instead survives with probability weight / ROULETTE_WEIGHT and is raised to
+ * ROULETTE_WEIGHT, which keeps the expected color unchanged.
  *
- * @param ro - ray vector orgin
- * @param rd - ray vector direction
- * @param pos - position
- * @param normal - the orthogonal normal vector to the plane
- * @returns double percision float t value that represents length of the intersecting vector, and -1 if no intersection was detected.
+ * @param state - rendering state of the calling thread
+ * @param weight - weight of the ray, raised when the ray survives the roulette
+ * @returns 1 if the ray should be traced, 0 otherwise
  */
-double plane_intersection(double *ro, double *rd, double *pos, double *normal) {
-	// normal defines the orientation of the plane
-	// the property that the dot product of two perpendicular vectors is equal to 0
-	// p0 = plane position
-	// (p - p0) * normal = 0
-	// p = ro + rd + t
-	// (ro + rd * t - p0) * normal = 0
-	// ((ppos - ro) * normal) / (rd * normal) <- Dot product - a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
-	double numerator = 0.0, denominator = 0.0, t = 0.0;
+int continue_ray(WorkerState *state, real *weight) {
+	real chance;
 	
-	normalize(normal);
+	if(state->roulette == 0) {
+		return ((*weight) >= state->min_weight);
+		
+	}
 	
-	numerator = (normal[0] * (pos[0] - ro[0])) + (normal[1] * (pos[1] - ro[1])) + (normal[2] * (pos[2] - ro[2])); 
-	denominator = (normal[0] * rd[0]) + (normal[1] * rd[1]) + (normal[2] * rd[2]);
+	if((*weight) >= ROULETTE_WEIGHT) {
+		return (1);
+		
+	}
 	
-	t = numerator / denominator;
+	// xorshift32
+	state->random ^= state->random << 13;
+	state->random ^= state->random >> 17;
+	state->random ^= state->random << 5;
+	chance = (state->random >> 8) / 16777216.0;
 	
-	if(t >= 0) {
-		return (t);
+	if(chance * ROULETTE_WEIGHT < (*weight)) {
+		*weight = ROULETTE_WEIGHT;
+		return (1);
 		
-	} else {
-		return (-1);
+	}
+	
+	return (0);
+	
+}
+
+
+/**
+ * Pushes a ray onto the thread's ray stack, a full stack drops the ray.
+ *
+ * @param state - rendering state of the calling thread
+ * @param ro - ray vector orgin
+ * @param rd - ray vector direction
+ * @param weight - fraction of the ray's color that reaches the pixel
+ * @param depth - number of bounces between the view ray and this ray
+ * @param closest_object - array index of the object the ray hits
+ * @param best_distance - distance to that object
+ */
+static void push_ray(WorkerState *state, real *ro, real *rd, real weight, int depth, int closest_object, real best_distance) {
+	RayEntry *entry;
+	
+	if(state->stack_top >= state->stack_size) {
+		return;
+		
+	}
+	
+	entry = &state->stack[state->stack_top++];
+	vector_copy(ro, entry->ro);
+	vector_copy(rd, entry->rd);
+	entry->weight = weight;
+	entry->depth = depth;
+	entry->object = closest_object;
+	entry->distance = best_distance;
+	
+	if(state->stack_top > state->peak_stack) {
+		state->peak_stack = state->stack_top;
 		
 	}
 	
 }
+
+
 /**
- * TODO
+ * Traces a secondary ray and pushes it onto the thread's ray stack if it hits something.
  *
- * @param TODO
- * @param TODO
- * @param TODO
- * @returns TODO
- */
- void refraction(double *direction, double *position, double normal, double ior, double *refraction_vector) {
-	double vector_a[3] = {0, 0, 0};
-	double vector_b[3] = {0, 0, 0};
-
-	normalize(direction);
-	normalize(position);
-	normalize(normal);
-	
-	// calculate vector angle and direction
-	vector_cross_product(normal, direction, vector_a);
-	normalize(vector_a);
-	vector_cross_product(vector_a, normal, vector_b);
-	normalize(vector_b);
-	sin_phi = vector_dot_product(direction, vector_b) * ior;
-	normalize(vector_b);
-	vector_scale(normal, (sqrt(1.0 - pow((vector_dot_product(direction, vector_b) * ior), 2))), normal);
-	vector_scale(vector_b, (vector_dot_product(direction, vector_b) * ior), vector_b);
-	normalize(vector_b);
-	vector_add(vector_b, normal, refraction_vector);
-		
- }
-
-/**
- * TODO
+ * @param scene - the scene
+ * @param state - rendering state of the calling thread
+ * @param ro - ray vector orgin
+ * @param rd - normalized ray vector direction
+ * @param weight - fraction of the ray's color that reaches the pixel
+ * @param depth - number of bounces between the view ray and this ray
+ * @param ignore - object index excluded from the test, -1 to test every object
+ */
+static void trace_secondary(Scene *scene, WorkerState *state, real *ro, real *rd, real weight, int depth, int ignore) {
+	real distance;
+	int object;
+	
+	object = scene_closest(scene, ro, rd, ignore, INFINITY, &distance);
+	if(object != -1) {
+		STATS_ADD(hits, 1);
+		push_ray(state, ro, rd, weight, depth, object, distance);
+		
+	}
+	
+}
+
+
+/**
+ * Colors a view ray hit, following reflected and refracted rays up to the thread's maximum
+ * depth. Secondary rays are kept on the thread's ray stack together with their weight, the
+ * product of the reflectivities and refractivities along their path, instead of recursing.
  *
- * @param TODO
- * @param TODO
- * @param TODO
- * @returns TODO
- */
-void colorer(Object objects[], int num_objects, double *ro, double *rd, double best_distance, int closest_object, double *pixel_coloring, int depth) {
-	double new_ro[3]; 					//<= view vector orgin
-	double new_rd[3]; 					//<= view vector direction
-	double normal[3]; 					//<= normal vector
-	double reflection_vector[3];		//<= reflection vector
-	double distance, best_distance2; 	//<= Shadow intersection distance result(s)
-	double light_distance;				//<= distance to the light
-	double diffuse_color[3];			//<= object's diffuse color
-	double specular_color[3];			//<= object's specular color
-	double diffuse_out[3];				//<= diffuse scalar
-	double specular_out[3];				//<= specular scalar
-	double fang_out, frad_out;			//<= angular and radial attenuation output
-	double reflected_ro[3];             //<= reflected vector orgin
-	double reflected_rd[3];             //<= reflected vector direction
-	double reflection_color[3];         //<= reflected color
-    int index, index2;                  //<= iteration counters
-	int closest_object2;                
-	double light_direction[3];
-
-	// Set vector default values
-	new_ro[0] = new_ro[1] = new_ro[2] = 0.0;
-	new_rd[0] = new_rd[1] = new_rd[2] = 0.0;
-	normal[0] = normal[1] = normal[2] = 0.0;
-	
-	reflected_ro[0] = reflected_ro[1] = reflected_ro[2] = 0;
-	reflected_rd[0] = reflected_rd[1] = reflected_rd[2] = 0;
-	
-	reflection_vector[0] = reflection_vector[1] = reflection_vector[2] = 0.0;
-	reflection_color[0] = reflection_color[1] = reflection_color[2] = 0.0;
-	
-	closest_object2 = 0;
-
-	// Establish orgin for the new ray
-	vector_scale(rd, best_distance, new_ro);
-	vector_add(ro, new_ro, new_ro);
-	
-	// Recursive base case, depth limit
-	if(depth > MAXIMUM_RECURSION_DEPTH) {
-		// Set default color
-		pixel_coloring[0] = pixel_coloring[1] = pixel_coloring[2] = 0;
-		return;
+ * @param scene - the scene
+ * @param state - rendering state of the calling thread
+ * @param ro - view vector orgin
+ * @param rd - view vector direction
+ * @param best_distance - distance to the closest object
+ * @param closest_object - array index of the closest object
+ * @param pixel_coloring - receives the color of the ray
+ */
+void colorer(Scene *scene, WorkerState *state, real *ro, real *rd, real best_distance, int closest_object, real *pixel_coloring) {
+	RayEntry ray;						//<= ray being shaded
+	real point[3];						//<= hit point
+	real normal[3]; 					//<= normal vector
+	real direction[3];					//<= secondary ray direction
+	real origin[3];						//<= secondary ray orgin
+	real color[3];						//<= light reflected at the hit point
+	Material *material;					//<= surface properties of the hit object
+	real weight;						//<= weight of a secondary ray
+	
+	state->stack_top = 0;
+	push_ray(state, ro, rd, 1, 0, closest_object, best_distance);
+	
+	while(state->stack_top > 0) {
+		ray = state->stack[--state->stack_top];
+		material = &scene->materials[ray.object];
+		STATS_DEPTH(ray.depth);
 		
-	} else {
-		// Get normal vector
-		if(strcmp((objects[closest_object].type), "sphere") == 0) {
-			vector_subtract(new_ro, objects[closest_object].properties.sphere.position, normal);
+		// Establish the hit point and its normal
+		vector_scale(ray.rd, ray.distance, point);
+		vector_add(ray.ro, point, point);
+		
+		normalize(ray.rd);
+		surface_normal(scene, ray.object, point, normal);
+		normalize(normal);
+		
+		direct_lighting(scene, state, ray.rd, point, normal, ray.object, color);
+		pixel_coloring[0] += ray.weight * color[0];
+		pixel_coloring[1] += ray.weight * color[1];
+		pixel_coloring[2] += ray.weight * color[2];
+		
+		if(ray.depth >= state->max_depth) {
+			continue;
+			
+		}
+		
+		// Spheres and planes are convex, a reflected ray can not hit its own object again
+		weight = ray.weight * material->reflectivity;
+		if((material->reflectivity > 0) && (continue_ray(state, &weight) != 0)) {
+			vector_reflection(ray.rd, normal, direction);
+			STATS_ADD(reflection_rays, 1);
+			trace_secondary(scene, state, point, direction, weight, ray.depth + 1, ray.object);
 			
-		} else if(strcmp((objects[closest_object].type), "plane") == 0) {
-			vector_copy((objects[closest_object].properties.plane.normal), normal);									
-
 		}
+		
+		// A refracted ray may hit the far side of its own object, step off the surface instead
+		weight = ray.weight * material->refractivity;
+		if((material->refractivity > 0) && (continue_ray(state, &weight) != 0) && (refraction(ray.rd, normal, material->ior, direction) != 0)) {
+			vector_scale(direction, RAY_EPSILON, origin);
+			vector_add(point, origin, origin);
+			STATS_ADD(refraction_rays, 1);
+			trace_secondary(scene, state, origin, direction, weight, ray.depth + 1, -1);
+			
+		}
+		
+	}
+	
+}
 
-		normalize(rd);
-		normalize(normal);
-		vector_reflection(rd, normal, reflection_vector);
-		normalize(reflected_rd);
 
-		// Execute object intersection test on reflection vector
-		for(index = 0; index < num_objects; index++) {
-			distance = 0;
-			
-			if((objects[index].type) != NULL) { // <= Check against type nulls
-				if(strcmp((objects[index].type), "sphere") == 0) {
-					distance = sphere_intersection(reflected_ro, reflected_rd, objects[index].properties.sphere.position, objects[index].properties.sphere.radius);
-				
-				} else if(strcmp((objects[index].type), "plane") == 0) {
-					distance = plane_intersection(reflected_ro, reflected_rd, objects[index].properties.plane.position, objects[index].properties.plane.normal);
+/**
+ * Finds the closest sphere or plane hit by a ray, through the bounding volume hierarchy when
+ * the scene has one and by testing every object otherwise.
+ *
+ * @param scene - the scene
+ * @param ro - ray vector orgin
+ * @param rd - ray vector direction
+ * @param ignore - object index excluded from the test, -1 to test every object
+ * @param max_distance - hits further away than this are ignored
+ * @param best_distance - receives the distance of the closest hit, INFINITY if none
+ * @returns array index of the closest object, -1 if nothing was hit
+ */
+int scene_closest(Scene *scene, real *ro, real *rd, int ignore, real max_distance, real *best_distance) {
+	real distance;
+	int slot, object, closest_object;
+	
+	if(scene->bvh != NULL) {
+		return bvh_closest(scene->bvh, scene, ro, rd, ignore, max_distance, best_distance);
+		
+	}
+	
+	STATS_ADD(sphere_tests, scene->spheres.count);
+	STATS_ADD(plane_tests, scene->planes.count);
+	
+	closest_object = -1;
+	*best_distance = INFINITY;
+	
+	// Ties go to the object that comes first in the scene
+	for(slot = 0; slot < scene->spheres.count; slot++) {
+		object = scene->spheres.object[slot];
+		
+		if(object != ignore) {
+			distance = sphere_intersection(&scene->spheres, slot, ro, rd);
 			
-				}
-				
-				if ((distance > 0) && (distance < (best_distance2))) {
-					closest_object2 = index;    // <= array index of object
-					best_distance2 = distance;	// <= closest distance value
-					
-				}
+			if((distance > 0) && (distance <= max_distance) && ((distance < (*best_distance)) || ((distance == (*best_distance)) && (object < closest_object)))) {
+				closest_object = object;	// <= array index of object
+				*best_distance = distance;	// <= closest distance value
 				
 			}
 			
 		}
-		//double temp_reflectivity = 0.0;
-		if(best_distance2 == INFINITY) {
-			// Set default color, no object was intersected
-			pixel_coloring[0] = pixel_coloring[1] = pixel_coloring[2] = 0;
-
-		} else {
-			// Recursive call to colorer
-			colorer(objects, num_objects, reflected_ro, reflected_rd, best_distance2, closest_object2, reflection_color, depth + 1);
+		
+	}
+	
+	for(slot = 0; slot < scene->planes.count; slot++) {
+		object = scene->planes.object[slot];
+		
+		if(object != ignore) {
+			distance = plane_intersection(&scene->planes, slot, ro, rd);
 			
-			if((objects[closest_object].type) != NULL) { // <= Check against type nulls
-				if(strcmp((objects[closest_object].type), "sphere") == 0) {
-					vector_scale(reflection_color, objects[closest_object].properties.sphere.reflectivity, reflection_color);
-					//temp_reflectivity = objects[closest_object].properties.sphere.reflectivity;
-				
-				} else if(strcmp((objects[closest_object].type), "plane") == 0) {
-					vector_scale(reflection_color, objects[closest_object].properties.sphere.reflectivity, reflection_color);
-					//temp_reflectivity = objects[closest_object].properties.plane.reflectivity;
-					
-				}
+			if((distance > 0) && (distance <= max_distance) && ((distance < (*best_distance)) || ((distance == (*best_distance)) && (object < closest_object)))) {
+				closest_object = object;	// <= array index of object
+				*best_distance = distance;	// <= closest distance value
 				
 			}
-			//printf("Reflection Color; %d, %d, %d\n", reflection_color[0], reflection_color[1], reflection_color[2]);
-			light_direction[0] = light_direction[1] = light_direction[2] = 0.0;
-			vector_scale(reflection_vector, -1, light_direction);
-			vector_scale(reflected_rd, best_distance2, reflected_rd);
-			vector_subtract(reflected_rd, new_ro, new_rd);
 			
-			if((objects[closest_object].type) != NULL) {
-				if(strcmp((objects[closest_object].type), "sphere") == 0) {
-					vector_subtract(new_ro, objects[closest_object].properties.sphere.position, normal);
-					vector_copy((objects[closest_object].properties.sphere.diffuse_color), diffuse_color);
-					vector_copy((objects[closest_object].properties.sphere.specular_color), specular_color);
-					
-				} else if(strcmp((objects[closest_object].type), "plane") == 0) {
-					vector_copy((objects[closest_object].properties.plane.normal), normal);
-					vector_copy((objects[closest_object].properties.plane.diffuse_color), diffuse_color);
-					vector_copy((objects[closest_object].properties.plane.specular_color), specular_color);									
+		}
+		
+	}
+	
+	return (closest_object);
+	
+}
 
-				}
-				
-			}
 
-			// Set default value for reflection vector
-			reflection_vector[0] = reflection_vector[1] = reflection_vector[2] = 0.0;
-			
-			normalize(normal); //<= Normalize normal
-			normalize(new_rd); //<= Normalize new ray direction
-			vector_reflection(new_rd, normal, reflection_vector);
+/**
+ * Tests whether a single sphere or plane is hit by a ray within a distance.
+ *
+ * @param scene - the scene
+ * @param object - array index of the object
+ * @param ro - ray vector orgin
+ * @param rd - ray vector direction
+ * @param max_distance - hits further away than this are ignored
+ * @returns 1 if the object is hit at a distance in (0, max_distance], 0 otherwise
+ */
+int object_occludes(Scene *scene, int object, real *ro, real *rd, real max_distance) {
+	real distance = 0;
+	
+	if(scene->types[object] == TYPE_SPHERE) {
+		distance = sphere_intersection(&scene->spheres, scene->slots[object], ro, rd);
+		STATS_ADD(sphere_tests, 1);
+		
+	} else if(scene->types[object] == TYPE_PLANE) {
+		distance = plane_intersection(&scene->planes, scene->slots[object], ro, rd);
+		STATS_ADD(plane_tests, 1);
+		
+	}
+	
+	return ((distance > 0) && (distance <= max_distance));
+	
+}
+
+
+/**
+ * Any hit query used by shadow rays. Unlike scene_closest it stops at the first object found
+ * between the origin and max_distance instead of searching for the closest one.
+ *
+ * @param scene - the scene
+ * @param ro - ray vector orgin
+ * @param rd - ray vector direction
+ * @param ignore - object index excluded from the test, -1 to test every object
+ * @param max_distance - hits further away than this are ignored
+ * @returns array index of an object hit within max_distance, -1 if there is none
+ */
+int scene_occluded(Scene *scene, real *ro, real *rd, int ignore, real max_distance) {
+	int slot, object;
+	
+	for(slot = 0; slot < scene->planes.count; slot++) {
+		object = scene->planes.object[slot];
+		
+		if((object != ignore) && (object_occludes(scene, object, ro, rd, max_distance) != 0)) {
+			return (object);
 			
-			// Set default values for diffuse and specular output vectors
-			diffuse_out[0] = diffuse_out[1] = diffuse_out[2] = 0.0;
-			specular_out[0] = specular_out[1] = specular_out[2] = 0.0;
+		}
+		
+	}
+	
+	if(scene->bvh != NULL) {
+		return bvh_occluded(scene->bvh, scene, ro, rd, ignore, max_distance);
+		
+	}
+	
+	for(slot = 0; slot < scene->spheres.count; slot++) {
+		object = scene->spheres.object[slot];
+		
+		if((object != ignore) && (object_occludes(scene, object, ro, rd, max_distance) != 0)) {
+			return (object);
 			
-			diffuse_reflection(normal, new_rd, reflection_color, diffuse_color, diffuse_out);
-			specular_highlight(normal, new_rd, reflection_vector, rd, specular_color, reflection_color, specular_out);
+		}
 		
-			// Set angular and radial default values
-			fang_out = frad_out = 1.0;
+	}
+	
+	return (-1);
+	
+}
+
+
+/**
+ * Allocates the per thread rendering state for a number of workers.
+ *
+ * @param scene - the scene that will be rendered
+ * @param count - number of workers
+ * @param settings - per render parameters, sets the depth and termination of secondary rays
+ * @returns array of count worker states
+ */
+WorkerState* worker_states_create(Scene *scene, int count, RenderSettings *settings) {
+	WorkerState *states;
+	int index, light;
+	
+	states = (WorkerState *)calloc(count, sizeof(WorkerState));
+	if(states == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	for(index = 0; index < count; index++) {
+		states[index].last_occluder = (int *)malloc(sizeof(int) * (scene->num_lights + 1));
+		if(states[index].last_occluder == NULL) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
 			
-			// Get angular and radial attenuation values
-			//fang_out = fang((objects[index].properties.light.radial_a0), (objects[index].properties.light.theta), (objects[index].properties.light.direction), new_rd); 
-			//frad_out = frad((objects[index].properties.light.radial_a0), (objects[index].properties.light.radial_a1), (objects[index].properties.light.radial_a2), light_distance);
+		}
+		
+		for(light = 0; light < scene->num_lights; light++) {
+			states[index].last_occluder[light] = -1;
 			
+		}
+		
+		// Every shaded ray leaves at most one sibling behind per depth, plus the two children
+		// of the deepest ray
+		states[index].max_depth = settings->max_depth;
+		states[index].min_weight = settings->min_weight;
+		states[index].roulette = settings->roulette;
+		states[index].stack_size = settings->max_depth + 2;
+		states[index].stack = (RayEntry *)malloc(sizeof(RayEntry) * states[index].stack_size);
+		if(states[index].stack == NULL) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
 			
-			// Add angular attenuation, radial attenuation, diffuse color and specular color to pixels
-			pixel_coloring[0] += fang_out * frad_out * (diffuse_out[0] + specular_out[0]);
-			pixel_coloring[1] += fang_out * frad_out * (diffuse_out[1] + specular_out[1]);
-			pixel_coloring[2] += fang_out * frad_out * (diffuse_out[2] + specular_out[2]);		
-
 		}
+		
+	}
+	
+	return states;
+	
+}
 
-		// Iterate through light objects
-		for(index = 0; index < num_objects; index++) {
-			if(strcmp(objects[index].type, "light") == 0) {
-				
-				// Set defaults
-				new_rd[0] = new_rd[1] = new_rd[2] = 0;
-				light_distance = 0.0;
-				
-				// Calcuate new ray direction
-				vector_subtract(objects[index].properties.light.position, new_ro, new_rd);
-				light_distance = vector_length(new_rd);
-				normalize(new_rd);	//<= Normalize new ray direction
-				
-				// Set default value
-				best_distance2 = INFINITY;
-				
-				// Execute shadow intersection test
-				for(index2 = 0; index2 < num_objects; index2++) {
-					distance = 0.0;	// <= reset distance each iteration
-					
-					if(closest_object != index2) {				// <= prevent self intersecting
-						if((objects[index2].type) != NULL) { 	// <= check against type nulls
-							if(strcmp((objects[index2].type), "sphere") == 0) {
-								distance = sphere_intersection(new_ro, new_rd, objects[index2].properties.sphere.position, objects[index2].properties.sphere.radius);
-							
-							} else if(strcmp((objects[index2].type), "plane") == 0) {
-								distance = plane_intersection(new_ro, new_rd, objects[index2].properties.plane.position, objects[index2].properties.plane.normal);
-						
-							}
-							
-							if(distance <= light_distance) {
-								if ((distance > 0) && (distance < (best_distance2))) {
-									best_distance2 = distance;	// <= closest distance value
-									
-								}
-								
-							}
-							
-						}
-						
-					}
-					
-				} // End-of-Object Iteration Loop						
-				
-				// Set default values for diffuse and specular colors
-				diffuse_color[0] = diffuse_color[1] = diffuse_color[2] = 0.0;
-				specular_color[0] = specular_color[1] = specular_color[2] = 0.0;
-				
-				// Set default value for the normal vector
-				normal[0] = normal[1] = normal[2] = 0.0;
-
-				// No intersection detected
-				if(best_distance2 == INFINITY) {
-					if((objects[closest_object].type) != NULL) {
-						if(strcmp((objects[closest_object].type), "sphere") == 0) {
-							vector_copy((objects[closest_object].properties.sphere.position), normal);
-							vector_subtract(new_ro, objects[closest_object].properties.sphere.position, normal);
-							vector_copy((objects[closest_object].properties.sphere.diffuse_color), diffuse_color);
-							vector_copy((objects[closest_object].properties.sphere.specular_color), specular_color);
-							
-						} else if(strcmp((objects[closest_object].type), "plane") == 0) {
-							vector_copy((objects[closest_object].properties.plane.normal), normal);
-							vector_copy((objects[closest_object].properties.plane.diffuse_color), diffuse_color);
-							vector_copy((objects[closest_object].properties.plane.specular_color), specular_color);									
-
-						}
-						
-					}
-			
-					// Set default value for reflection vector		
-					reflection_vector[0] = reflection_vector[1] = reflection_vector[2] = 0.0;
-					
-					normalize(normal); //<= Normalize normal
-					normalize(new_rd); //<= Normalize new ray direction
-					vector_reflection(new_rd, normal, reflection_vector);
-					
-					// Set default values for diffuse and specular output vectors
-					diffuse_out[0] = diffuse_out[1] = diffuse_out[2] = 0.0;
-					specular_out[0] = specular_out[1] = specular_out[2] = 0.0;
-					
-					diffuse_reflection(normal, new_rd, (objects[index].properties.light.color), diffuse_color, diffuse_out);
-					specular_highlight(normal, new_rd, reflection_vector, rd, specular_color, (objects[index].properties.light.color), specular_out);
-					
-					// Set angular and radial default values
-					fang_out = frad_out = 0.0;
-					
-					// Get angular and radial attenuation values
-					fang_out = fang((objects[index].properties.light.radial_a0), (objects[index].properties.light.theta), (objects[index].properties.light.direction), new_rd); 
-					frad_out = frad((objects[index].properties.light.radial_a0), (objects[index].properties.light.radial_a1), (objects[index].properties.light.radial_a2), light_distance);
-					
-					// Add angular attenuation, radial attenuation, diffuse color and specular color to pixels
-					pixel_coloring[0] += fang_out * frad_out * (diffuse_out[0] + specular_out[0]);
-					pixel_coloring[1] += fang_out * frad_out * (diffuse_out[1] + specular_out[1]);
-					pixel_coloring[2] += fang_out * frad_out * (diffuse_out[2] + specular_out[2]);
-					
-				}
-				
-			}
+
+/**
+ * Returns the deepest ray stack reached by any of a number of workers.
+ *
+ * @param states - array of worker states
+ * @param count - number of workers
+ * @returns peak number of entries on a ray stack
+ */
+int worker_states_peak(WorkerState *states, int count) {
+	int index, peak = 0;
+	
+	for(index = 0; index < count; index++) {
+		if(states[index].peak_stack > peak) {
+			peak = states[index].peak_stack;
 			
-		}	
+		}
 		
-	}	 
+	}
 	
- }
+	return (peak);
+	
+}
 
 
 /**
- * This function implements the raycasting portion of this application it performs the calculations for pixel scaling, and logic that uses the 
- * scene data to detect object ray intersections, colors pixels related to the object data, and stores the  collection of information into an 
- * image data buffer to be written using a ppm write function.
+ * Releases worker states created by worker_states_create.
  *
- * @param objects - collection of objects read in from the json parser
- * @param image - is an Image object used to store image data
- * @param num_objects - number of objects read in from the json parser use to set iteration values for, for loops.
- * @returns Image - which is the image pointer to the image object that is used to store the image data for write purposes.
+ * @param states - array of worker states
+ * @param count - number of workers
  */
-Image* raycaster(Object objects[], Image *image, int num_objects) {
-	double pixel_height, pixel_width;	//<= image height and width in pixels
-	double h, w;						//<= height and width of the camera
-	double cx, cy; 						//<= center of pixel
-	double distance, best_distance;		//<= Raycaster intersection distance result(s)
-	double ro[3], rd[3];				//<= view vector orgin and direction
-	double red, green, blue;			//<= 8-bit RBG storage
-	double pixel_coloring[3]; 	 		//<= final coloring vector
-	int row, column, index, index2; 	//<= iteration counters
-	int closest_object;					//<= array index of closest object
+void worker_states_free(WorkerState *states, int count) {
+	int index;
 	
-	// Set center x & y
-	cx = cy = 0;
+	for(index = 0; index < count; index++) {
+		free(states[index].last_occluder);
+		free(states[index].stack);
+		
+	}
+	
+	free(states);
+	
+}
+
+
+/**
+ * Looks up the camera in the scene and derives the pixel scaling used to build view vectors.
+ *
+ * @param scene - the scene
+ * @param image - image the view is projected onto
+ * @param view - view structure that stores the computed values
+ */
+void setup_view(Scene *scene, Image *image, View *view) {
+	int index;
 	
 	// Get the index of the camera
-	index = get_camera(objects, num_objects);
+	index = scene->camera;
 	
-	// // Check scene for a camera, -1 means camera is missing
+	// Check scene for a camera, -1 means camera is missing
 	if(index == (-1)) {
 		fprintf(stderr, "Error, no camera object was found.\n");
 		exit(-1);
 		
-	} else {
-		// Get camera height and width
-		h = objects[index].properties.camera.height;
-		w = objects[index].properties.camera.width;
+	}
+	
+	// Set center x & y
+	view->cx = view->cy = 0;
+	
+	// Get camera height and width
+	view->h = scene->viewport.height;
+	view->w = scene->viewport.width;
+	
+	// Scale pixels
+	view->pixel_height = view->h / (image->height);
+	view->pixel_width = view->w / (image->width);
+	
+}
+
+
+/**
+ * Computes the normalized view vector through a point inside a pixel.
+ *
+ * @param view - camera and pixel scaling values
+ * @param row - pixel row
+ * @param column - pixel column
+ * @param dy - vertical offset of the point within the pixel, 0 to 1
+ * @param dx - horizontal offset of the point within the pixel, 0 to 1
+ * @param rd - receives the view vector direction
+ */
+void view_sample(View *view, int row, int column, double dy, double dx, real *rd) {
+	// Set view vector direction
+	rd[0] = (view->cx - (view->w / 2.0) + view->pixel_width * (column + dx));
+	rd[1] = - 1 * (view->cy - (view->h / 2.0) + view->pixel_height * (row + dy));
+	rd[2] = 1.0;
+	
+	normalize(rd); // <= Normalize ray direction
+	
+}
+
+
+/**
+ * Computes the normalized view vector through the center of a pixel.
+ *
+ * @param view - camera and pixel scaling values
+ * @param row - pixel row
+ * @param column - pixel column
+ * @param rd - receives the view vector direction
+ */
+void view_ray(View *view, int row, int column, real *rd) {
+	view_sample(view, row, column, 0.5, 0.5, rd);
+	
+}
 
-		// Scale pixels
-		pixel_height = h / (image->height);
-		pixel_width = w / (image->width);
+
+/**
+ * Colors a pixel from the closest hit of its view ray and stores the result in the image data
+ * buffer.
+ *
+ * @param scene - the scene
+ * @param state - rendering state of the calling thread
+ * @param image - image that receives the pixel
+ * @param row - pixel row
+ * @param column - pixel column
+ * @param ro - view vector orgin
+ * @param rd - view vector direction
+ * @param closest_object - array index of the closest object, -1 if nothing was hit
+ * @param best_distance - distance to the closest object
+ */
+void shade_pixel(Scene *scene, WorkerState *state, Image *image, int row, int column, real *ro, real *rd, int closest_object, real best_distance) {
+	real pixel_coloring[3]; 	 		//<= final coloring vector
+	Pixel *pixel;						//<= destination pixel
+	
+	// Set ambient color
+	pixel_coloring[0] = 0;
+	pixel_coloring[1] = 0;
+	pixel_coloring[2] = 0;
+	
+	pixel = image_pixel(image, row, column);
+	STATS_ADD(primary_rays, 1);
+	
+	// Object intersection detected
+	if(closest_object != -1) {
+		STATS_ADD(hits, 1);
+		
+		// Calcuate reflection, refraction
+		state->random = sample_hash(row, column, 0) | 1;
+		colorer(scene, state, ro, rd, best_distance, closest_object, pixel_coloring);
+		
+		// Apply coloring to a pixel
+		pixel->red = clamp(pixel_coloring[0], 0, 1) * (image->max_color);
+		pixel->green = clamp(pixel_coloring[1], 0, 1) * (image->max_color);
+		pixel->blue = clamp(pixel_coloring[2], 0, 1) * (image->max_color);
+		
+	} else {
+		// Background color
+		pixel->red = pixel->green = pixel->blue = 0;
 		
 	}
+	
+}
+
 
-	// Set default values for view orgin and view vector
+/**
+ * Casts the view rays of a block of neighbouring pixels, PACKET_COLUMNS wide and two rows
+ * tall, as one packet, then colors each pixel and stores the result in the image data buffer.
+ * Pixels of the block at or past row_end or column_end are left out. Only reads the scene and
+ * writes its own pixels so it is safe to call from several threads at once.
+ *
+ * @param scene - the scene
+ * @param state - rendering state of the calling thread
+ * @param image - image that receives the pixels
+ * @param view - camera and pixel scaling values
+ * @param row - row of the upper left pixel
+ * @param column - column of the upper left pixel
+ * @param row_end - first row not to render
+ * @param column_end - first column not to render
+ * @param objects - receives the closest object of each pixel for anti-aliasing, may be NULL
+ */
+void raycast_block(Scene *scene, WorkerState *state, Image *image, View *view, int row, int column, int row_end, int column_end, int *objects) {
+	RayPacket packet;					//<= view vectors of the block
+	real ro[3], rd[3];				//<= view vector orgin and direction
+	int lane, y, x;						//<= packet lane and pixel coordinates
+	
+	// Set default values for view orgin
 	ro[0] = ro[1] = ro[2] = 0.0;
-	rd[0] = rd[1] = rd[2] = 0.0;
 	
-	// Iterate over pixel matrix
-	for(row = 0; row < (image->height); row++) {
-		for(column = 0; column < (image->width); column++) {
+	for(lane = 0; lane < PACKET_SIZE; lane++) {
+		y = row + (lane / PACKET_COLUMNS);
+		x = column + (lane % PACKET_COLUMNS);
+		
+		if((y < row_end) && (x < column_end)) {
+			view_ray(view, y, x, rd);
 			
-			// Set view vector direction
-			rd[0] = (cx - (w / 2.0) + pixel_width * (column + 0.5));
-			rd[1] = - 1 * (cy - (h / 2.0) + pixel_height * (row + 0.5));
-			rd[2] = 1.0;
+		} else {
+			// Inactive lane, a NaN direction never hits anything
+			rd[0] = rd[1] = rd[2] = NAN;
 			
-			normalize(rd); // <= Normalize ray direction
-			best_distance = INFINITY;
+		}
+		
+		packet.ox[lane] = ro[0];
+		packet.oy[lane] = ro[1];
+		packet.oz[lane] = ro[2];
+		packet.dx[lane] = rd[0];
+		packet.dy[lane] = rd[1];
+		packet.dz[lane] = rd[2];
+		packet.ignore[lane] = -1;
+		
+	}
+	
+	// Execute object intersection test
+	packet_closest(scene, &packet);
+	
+	for(lane = 0; lane < PACKET_SIZE; lane++) {
+		y = row + (lane / PACKET_COLUMNS);
+		x = column + (lane % PACKET_COLUMNS);
+		
+		if((y < row_end) && (x < column_end)) {
+			rd[0] = packet.dx[lane];
+			rd[1] = packet.dy[lane];
+			rd[2] = packet.dz[lane];
 			
-			// Set ambient color
-			pixel_coloring[0] = 0;
-			pixel_coloring[1] = 0;
-			pixel_coloring[2] = 0;
+			shade_pixel(scene, state, image, y, x, ro, rd, packet.object[lane], packet.distance[lane]);
 			
-			// Execute object intersection test
-			for(index = 0; index < num_objects; index++) {
-				distance = 0;
+			if(objects != NULL) {
+				objects[(size_t)(image->band_width) * (y - image->band_start) + (x - image->band_left)] = packet.object[lane];
 				
-				if((objects[index].type) != NULL) { // <= Check against type nulls
-					if(strcmp((objects[index].type), "sphere") == 0) {
-						distance = sphere_intersection(ro, rd, objects[index].properties.sphere.position, objects[index].properties.sphere.radius);
+			}
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Returns a pseudo random offset within a pixel that only depends on its arguments, so an
+ * anti-aliased image does not depend on the number of threads.
+ *
+ * @param row - pixel row
+ * @param column - pixel column
+ * @param sample - index of the sample within the pixel
+ * @returns offset in the range 0 to 1
+ */
+static double sample_jitter(int row, int column, int sample) {
+	return ((sample_hash(row, column, sample) >> 8) / 16777216.0);
+	
+}
+
+
+/**
+ * Picks the pixels worth anti-aliasing, those whose closest object differs from a neighbour's
+ * or whose color differs strongly from a neighbour's.
+ *
+ * @param image - image holding one sample per pixel
+ * @param objects - closest object of each pixel
+ * @param pixels - receives the indices of the selected pixels
+ * @returns number of selected pixels
+ */
+static size_t find_edges(Image *image, int *objects, size_t *pixels) {
+	int neighbours[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+	int row, column, neighbour, threshold;
+	size_t index, other, count;
+	Pixel *a, *b;
+	
+	threshold = AA_CONTRAST * image->max_color;
+	count = 0;
+	
+	for(row = 0; row < image->height; row++) {
+		for(column = 0; column < image->width; column++) {
+			index = (size_t)(image->width) * row + column;
+			a = &image->image_data[index];
+			
+			for(neighbour = 0; neighbour < 4; neighbour++) {
+				if((row + neighbours[neighbour][0] < 0) || (row + neighbours[neighbour][0] >= image->height) || (column + neighbours[neighbour][1] < 0) || (column + neighbours[neighbour][1] >= image->width)) {
+					continue;
 					
-					} else if(strcmp((objects[index].type), "plane") == 0) {
-						distance = plane_intersection(ro, rd, objects[index].properties.plane.position, objects[index].properties.plane.normal);
+				}
 				
-					}
-					
-					if ((distance > 0) && (distance < (best_distance))) {
-						closest_object = index;		// <= array index of object
-						best_distance = distance;	// <= closest distance value
-						
-					}
+				other = index + ((long long)(image->width) * neighbours[neighbour][0]) + neighbours[neighbour][1];
+				b = &image->image_data[other];
+				
+				if((objects[index] != objects[other]) || (abs(a->red - b->red) > threshold) || (abs(a->green - b->green) > threshold) || (abs(a->blue - b->blue) > threshold)) {
+					pixels[count++] = index;
+					break;
 					
 				}
 				
 			}
 			
-			// Object intersection detected
-			if((best_distance > 0) && (best_distance != INFINITY)) {
-				// Calcuate reflection, refraction
-				colorer(objects, num_objects, ro, rd, best_distance, closest_object, pixel_coloring, 0);
-					
-				// Set 8-bit RGB default values
-				red = green = blue = 0.0;
+		}
+		
+	}
+	
+	return (count);
+	
+}
+
+
+/**
+ * Recolors a pixel from a grid of jittered samples, one per cell, traced four to a packet.
+ *
+ * @param scene - the scene
+ * @param state - rendering state of the calling thread
+ * @param image - image that receives the pixel
+ * @param view - camera and pixel scaling values
+ * @param row - pixel row
+ * @param column - pixel column
+ * @param grid - number of samples per side of the pixel
+ */
+void antialias_pixel(Scene *scene, WorkerState *state, Image *image, View *view, int row, int column, int grid) {
+	RayPacket packet;					//<= view vectors of the samples
+	real ro[3], rd[3];				//<= view vector orgin and direction
+	real sample_coloring[3];			//<= color of one sample
+	real sum[3];						//<= sum of the clamped sample colors
+	int first, lane, sample, samples;
+	Pixel *pixel;
+	
+	ro[0] = ro[1] = ro[2] = 0.0;
+	sum[0] = sum[1] = sum[2] = 0.0;
+	samples = grid * grid;
+	STATS_ADD(primary_rays, samples);
+	
+	for(first = 0; first < samples; first += PACKET_SIZE) {
+		for(lane = 0; lane < PACKET_SIZE; lane++) {
+			sample = first + lane;
+			
+			if(sample < samples) {
+				view_sample(view, row, column, ((sample / grid) + sample_jitter(row, column, 2 * sample)) / grid, ((sample % grid) + sample_jitter(row, column, 2 * sample + 1)) / grid, rd);
 				
-				// Apply coloring to a pixel
-				if(strcmp(objects[(closest_object)].type, "sphere") == 0) {
-					red = clamp(pixel_coloring[0], 0, 1) * (image->max_color);
-					green = clamp(pixel_coloring[1], 0, 1) * (image->max_color);
-					blue = clamp(pixel_coloring[2], 0, 1) * (image->max_color);
-					
-					image->image_data[(image->width) * row + column].red = red;
-					image->image_data[(image->width) * row + column].green = green;
-					image->image_data[(image->width) * row + column].blue = blue;
-
-				} else if(strcmp(objects[(closest_object)].type, "plane") == 0) {
-					red = clamp(pixel_coloring[0], 0, 1) * (image->max_color);
-					green = clamp(pixel_coloring[1], 0, 1) * (image->max_color);
-					blue = clamp(pixel_coloring[2], 0, 1) * (image->max_color);
-					
-					image->image_data[(image->width) * row + column].red = red;
-					image->image_data[(image->width) * row + column].green = green;
-					image->image_data[(image->width) * row + column].blue = blue;
-					
-				}
+			} else {
+				// Inactive lane, a NaN direction never hits anything
+				rd[0] = rd[1] = rd[2] = NAN;
+				
+			}
+			
+			packet.ox[lane] = ro[0];
+			packet.oy[lane] = ro[1];
+			packet.oz[lane] = ro[2];
+			packet.dx[lane] = rd[0];
+			packet.dy[lane] = rd[1];
+			packet.dz[lane] = rd[2];
+			packet.ignore[lane] = -1;
+			
+		}
+		
+		packet_closest(scene, &packet);
+		
+		for(lane = 0; (lane < PACKET_SIZE) && (first + lane < samples); lane++) {
+			if(packet.object[lane] != -1) {
+				STATS_ADD(hits, 1);
+				rd[0] = packet.dx[lane];
+				rd[1] = packet.dy[lane];
+				rd[2] = packet.dz[lane];
+				
+				sample_coloring[0] = sample_coloring[1] = sample_coloring[2] = 0;
+				state->random = sample_hash(row, column, first + lane + 1) | 1;
+				colorer(scene, state, ro, rd, packet.distance[lane], packet.object[lane], sample_coloring);
+				
+				sum[0] += clamp(sample_coloring[0], 0, 1);
+				sum[1] += clamp(sample_coloring[1], 0, 1);
+				sum[2] += clamp(sample_coloring[2], 0, 1);
 				
 			}
 			
-		} // End-of-Row Loop
+		}
+		
+	}
+	
+	pixel = image_pixel(image, row, column);
+	pixel->red = (sum[0] / samples) * (image->max_color);
+	pixel->green = (sum[1] / samples) * (image->max_color);
+	pixel->blue = (sum[2] / samples) * (image->max_color);
+	
+}
+
+
+/**
+ * Anti-aliases a chunk of edge pixels, called by the thread pool once per chunk.
+ *
+ * @param context - pointer to the AAJob describing the pass
+ * @param task - index of the chunk
+ * @param thread_id - worker executing the chunk
+ */
+static void antialias_task(void *context, int task, int thread_id) {
+	AAJob *job = (AAJob *)context;
+	size_t index, pixel;
+	
+	for(index = (size_t)task * AA_CHUNK; (index < (size_t)(task + 1) * AA_CHUNK) && (index < job->num_pixels); index++) {
+		pixel = job->pixels[index];
+		antialias_pixel(job->scene, &job->states[thread_id], job->image, job->view, pixel / job->image->width, pixel % job->image->width, job->grid);
+		
+	}
+	
+}
+
+
+/**
+ * Adaptive anti-aliasing pass run after an image has been rendered with one sample per pixel.
+ * Only edge pixels are resampled, with as many stratified samples as fit in a square grid of
+ * at most max_samples cells.
+ *
+ * @param scene - the scene
+ * @param states - rendering state of every worker
+ * @param image - the rendered image
+ * @param view - camera and pixel scaling values
+ * @param pool - thread pool that resamples the pixels, NULL to resample on the calling thread
+ * @param objects - closest object of each pixel
+ * @param max_samples - samples allowed per pixel
+ * @returns number of view rays traced, including the first sample of every pixel
+ */
+static long long antialias(Scene *scene, WorkerState *states, Image *image, View *view, ThreadPool *pool, int *objects, int max_samples) {
+	AAJob job;
+	int task;
+	
+	job.grid = (int)sqrt(max_samples);
+	if(job.grid < 2) {
+		return ((long long)image->width * image->height);
+		
+	}
+	
+	job.pixels = (size_t *)malloc(sizeof(size_t) * image->width * image->height);
+	if(job.pixels == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	job.scene = scene;
+	job.states = states;
+	job.image = image;
+	job.view = view;
+	
+	// Edges are found from the whole first pass before any pixel changes
+	job.num_pixels = find_edges(image, objects, job.pixels);
+	
+	if(pool != NULL) {
+		threadpool_run(pool, antialias_task, &job, (job.num_pixels + AA_CHUNK - 1) / AA_CHUNK);
+		
+	} else {
+		for(task = 0; task < (job.num_pixels + AA_CHUNK - 1) / AA_CHUNK; task++) {
+			antialias_task(&job, task, 0);
+			
+		}
+		
+	}
+	
+	free(job.pixels);
+	
+	return (((long long)image->width * image->height) + ((long long)job.num_pixels * job.grid * job.grid));
+	
+}
+
+
+/**
+ * Allocates the closest object map anti-aliasing needs, when it is turned on.
+ *
+ * @param image - image that will be rendered
+ * @param settings - per render parameters
+ * @returns the map, NULL when anti-aliasing is off
+ */
+static int* objects_create(Image *image, RenderSettings *settings) {
+	int *objects;
+	
+	if(settings->max_samples < 4) {
+		return (NULL);
+		
+	}
+	
+	objects = (int *)malloc(sizeof(int) * image->band_width * image->band_height);
+	if(objects == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	return (objects);
+	
+}
+
+
+/**
+ * This function implements the raycasting portion of this application it performs the calculations for pixel scaling, and logic that uses the 
+ * scene data to detect object ray intersections, colors pixels related to the object data, and stores the  collection of information into an 
+ * image data buffer to be written using a ppm write function.
+ *
+ * @param scene - scene created from the objects read in from the json parser
+ * @param image - is an Image object used to store image data
+ * @param settings - per render parameters, receives the peak ray stack usage and sample count
+ * @returns Image - which is the image pointer to the image object that is used to store the image data for write purposes.
+ */
+Image* raycaster(Scene *scene, Image *image, RenderSettings *settings) {
+	View view;			//<= camera and pixel scaling
+	WorkerState *state;	//<= rendering state of the calling thread
+	int *objects;		//<= closest object of every pixel, for anti-aliasing
+	int row, column; 	//<= iteration counters
+	
+	setup_view(scene, image, &view);
+	state = worker_states_create(scene, 1, settings);
+	objects = objects_create(image, settings);
+	
+	// Iterate over the rows and columns held in the image in blocks of one packet
+	for(row = image->band_start; row < (image->band_start + image->band_height); row += 2) {
+		for(column = image->band_left; column < (image->band_left + image->band_width); column += PACKET_COLUMNS) {
+			raycast_block(scene, state, image, &view, row, column, image->band_start + image->band_height, image->band_left + image->band_width, objects);
+			
+		} // End-of-Column Loop
+		
+	} // End-of-Row Loop 
+	
+	settings->samples = (long long)image->band_width * image->band_height;
+	if(objects != NULL) {
+		settings->samples = antialias(scene, state, image, &view, NULL, objects, settings->max_samples);
+		free(objects);
+		
+	}
+	
+	settings->peak_stack = worker_states_peak(state, 1);
+	worker_states_free(state, 1);
+	
+	return image;
+	
+}
+
+
+/**
+ * Renders a single square tile of the image, called by the thread pool once per tile.
+ *
+ * @param context - pointer to the TileJob describing the render
+ * @param task - index of the tile in row major order
+ * @param thread_id - worker executing the tile
+ */
+static void raycast_tile(void *context, int task, int thread_id) {
+	TileJob *job = (TileJob *)context;
+	int row, column;							//<= iteration counters
+	int row_start, column_start;				//<= upper left corner of the tile
+	int row_end, column_end;					//<= lower right corner of the tile
+	
+	row_start = job->image->band_start + (task / job->tiles_x) * job->tile_size;
+	column_start = job->image->band_left + (task % job->tiles_x) * job->tile_size;
+	
+	row_end = row_start + job->tile_size;
+	if(row_end > job->image->band_start + job->image->band_height) {
+		row_end = job->image->band_start + job->image->band_height;
+		
+	}
+	
+	column_end = column_start + job->tile_size;
+	if(column_end > job->image->band_left + job->image->band_width) {
+		column_end = job->image->band_left + job->image->band_width;
+		
+	}
+	
+	for(row = row_start; row < row_end; row += 2) {
+		for(column = column_start; column < column_end; column += PACKET_COLUMNS) {
+			raycast_block(job->scene, &job->states[thread_id], job->image, &job->view, row, column, row_end, column_end, job->objects);
+			
+		}
 		
-	} // End-of-Column Loop 
+	}
+	
+}
+
 
+/**
+ * Tiled and multithreaded version of raycaster. The image is split into square tiles that the
+ * pool's workers render straight into the image data buffer, idle workers steal tiles from the
+ * others. Every pixel is computed by the same routine as the serial path so the output is
+ * identical regardless of the number of threads.
+ *
+ * @param scene - scene created from the objects read in from the json parser
+ * @param image - is an Image object used to store image data
+ * @param pool - thread pool that executes the tiles
+ * @param tile_size - width and height of a tile in pixels
+ * @param settings - per render parameters, receives the peak ray stack usage and sample count
+ * @returns Image - pointer to the rendered image
+ */
+Image* raycaster_tiled(Scene *scene, Image *image, ThreadPool *pool, int tile_size, RenderSettings *settings) {
+	TileJob job;
+	int tiles_y;
+	
+	if(tile_size < 1) {
+		tile_size = DEFAULT_TILE_SIZE;
+		
+	}
+	
+	setup_view(scene, image, &job.view);
+	
+	job.scene = scene;
+	job.states = worker_states_create(scene, pool->num_threads, settings);
+	job.image = image;
+	job.tile_size = tile_size;
+	job.tiles_x = (image->band_width + tile_size - 1) / tile_size;
+	job.objects = objects_create(image, settings);
+	tiles_y = (image->band_height + tile_size - 1) / tile_size;
+	
+	threadpool_run(pool, raycast_tile, &job, job.tiles_x * tiles_y);
+	
+	settings->samples = (long long)image->band_width * image->band_height;
+	if(job.objects != NULL) {
+		settings->samples = antialias(scene, job.states, image, &job.view, pool, job.objects, settings->max_samples);
+		free(job.objects);
+		
+	}
+	
+	settings->peak_stack = worker_states_peak(job.states, pool->num_threads);
+	worker_states_free(job.states, pool->num_threads);
+	
 	return image;
 	
 }
+
+
+/**
+ * Renders the rows held in an image with the selected renderer.
+ *
+ * @param scene - the scene
+ * @param image - image that receives the rows, the whole image or one band of it
+ * @param pool - worker threads, NULL to render on the calling thread
+ * @param tile_size - width and height of the tiles handed to the workers
+ * @param wavefront - 1 to trace the tiles in waves
+ * @param settings - per render parameters, receives the peak ray stack usage and sample count
+ */
+void render_image(Scene *scene, Image *image, ThreadPool *pool, int tile_size, int wavefront, RenderSettings *settings) {
+	if(wavefront != 0) {
+		raycaster_wavefront(scene, image, pool, tile_size, settings);
+		
+	} else if(pool == NULL) {
+		raycaster(scene, image, settings);
+		
+	} else {
+		raycaster_tiled(scene, image, pool, tile_size, settings);
+		
+	}
+	
+}
@@ -8,8 +8,132 @@
  
 #ifndef raycaster_h
 	#define raycaster_h
+	
+	#define DEFAULT_TILE_SIZE 32
+	#define DEFAULT_MAX_DEPTH 7
+	#define RAY_EPSILON 0.0001
+	
+	// Weight below which secondary rays are dropped, half an 8-bit step of full white
+	#define DEFAULT_MIN_WEIGHT (1.0 / 512.0)
+	
+	// Weight below which secondary rays play Russian roulette when it is turned on
+	#define ROULETTE_WEIGHT 0.1
+	
+	// Neighbouring pixels whose channels differ by more than this fraction get anti-aliased
+	#define AA_CONTRAST 0.1
+	
+	// Edge pixels handed to a worker at a time
+	#define AA_CHUNK 64
+	
+	/**
+	 * Camera dimensions and pixel scaling used to build the view vector of a pixel.
+	 */
+	typedef struct View {
+		real w, h;
+		real cx, cy;
+		real pixel_width, pixel_height;
+		
+	} View;
+	
+	/**
+	 * Per render parameters. Secondary rays whose weight falls below min_weight are dropped,
+	 * or with roulette set, play Russian roulette below ROULETTE_WEIGHT. max_samples caps the samples an anti-aliased pixel gets, 1 turns
+	 * anti-aliasing off. peak_stack and samples are filled in by the render with the deepest ray
+	 * stack any thread reached and the number of view rays traced.
+	 */
+	typedef struct RenderSettings {
+		int max_depth;
+		real min_weight;
+		int roulette;
+		int max_samples;
+		int peak_stack;
+		long long samples;
+		
+	} RenderSettings;
+	
+	/**
+	 * A ray waiting to be shaded. weight is the fraction of its color that reaches the pixel.
+	 */
+	typedef struct RayEntry {
+		real ro[3];
+		real rd[3];
+		real weight;
+		real distance;
+		int object;
+		int depth;
+		
+	} RayEntry;
+	
+	/**
+	 * Rendering state private to one thread. last_occluder holds, per light, the object that
+	 * blocked the thread's previous shadow ray towards that light or -1. stack holds the rays
+	 * still to be shaded for the current pixel, it is sized so that max_depth bounces never
+	 * overflow it. random is the state of the generator behind Russian roulette, reseeded per
+	 * pixel so images do not depend on which thread rendered what.
+	 */
+	typedef struct WorkerState {
+		int *last_occluder;
+		RayEntry *stack;
+		int stack_size;
+		int stack_top;
+		int peak_stack;
+		int max_depth;
+		real min_weight;
+		int roulette;
+		unsigned int random;
+		
+	} WorkerState;
+	
+	/**
+	 * Describes a tiled render handed to the thread pool, tiles are numbered in row major order.
+	 */
+	typedef struct TileJob {
+		Scene *scene;
+		WorkerState *states;
+		Image *image;
+		View view;
+		int tile_size;
+		int tiles_x;
+		int *objects;
+		
+	} TileJob;
+	
+	/**
+	 * Describes the anti-aliasing of the edge pixels of an image handed to the thread pool,
+	 * task i refines pixels i * AA_CHUNK up to the next chunk. grid is the number of samples
+	 * per side of a pixel.
+	 */
+	typedef struct AAJob {
+		Scene *scene;
+		WorkerState *states;
+		Image *image;
+		View *view;
+		size_t *pixels;
+		size_t num_pixels;
+		int grid;
+		
+	} AAJob;
 
 	// function declarations
-	Image* raycaster(Object objects[], Image *image, int num_objects);
+	real clamp(real number, real min, real max);
+	int refraction(real *direction, real *normal, real ior, real *refraction_vector);
+	void surface_normal(Scene *scene, int object, real *point, real *normal);
+	void light_contribution(SceneLight *light, Material *material, real *rd, real *light_rd, real light_distance, real *normal, real *color);
+	unsigned int sample_hash(unsigned int a, unsigned int b, unsigned int c);
+	int continue_ray(WorkerState *state, real *weight);
+	int light_occluder(Scene *scene, WorkerState *state, int light, real *point, real *light_rd, int ignore, real light_distance);
+	int scene_closest(Scene *scene, real *ro, real *rd, int ignore, real max_distance, real *best_distance);
+	int object_occludes(Scene *scene, int object, real *ro, real *rd, real max_distance);
+	int scene_occluded(Scene *scene, real *ro, real *rd, int ignore, real max_distance);
+	WorkerState* worker_states_create(Scene *scene, int count, RenderSettings *settings);
+	int worker_states_peak(WorkerState *states, int count);
+	void worker_states_free(WorkerState *states, int count);
+	void setup_view(Scene *scene, Image *image, View *view);
+	void view_sample(View *view, int row, int column, double dy, double dx, real *rd);
+	void view_ray(View *view, int row, int column, real *rd);
+	void shade_pixel(Scene *scene, WorkerState *state, Image *image, int row, int column, real *ro, real *rd, int closest_object, real best_distance);
+	Image* raycaster(Scene *scene, Image *image, RenderSettings *settings);
+	Image* raycaster_tiled(Scene *scene, Image *image, ThreadPool *pool, int tile_size, RenderSettings *settings);
+	void render_image(Scene *scene, Image *image, ThreadPool *pool, int tile_size, int wavefront, RenderSettings *settings);
  
-#endif
\ No newline at end of file
+#endif
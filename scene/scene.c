@@ -0,0 +1,312 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: scene.c
+ * Copyright © 2016 All rights reserved 
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+#include "..\math\real.h"
+#include "..\math\vector_math.h"
+#include "..\json\json.h"
+#include "scene.h"
+#include "..\simd\simd.h"
+#include "..\bvh\bvh.h"
+
+/**
+ * Allocates a zero filled block aligned to SCENE_ALIGNMENT bytes, exits the program if the
+ * allocation fails.
+ *
+ * @param size - size of the block in bytes
+ * @returns pointer to the block, release with free
+ */
+void *scene_alloc(size_t size) {
+	void *block = NULL;
+	
+	// Round up so that the last vector load of an array stays inside the block
+	size = (size + SCENE_ALIGNMENT - 1) & ~((size_t)SCENE_ALIGNMENT - 1);
+	if(size == 0) {
+		size = SCENE_ALIGNMENT;
+		
+	}
+	
+	if(posix_memalign(&block, SCENE_ALIGNMENT, size) != 0) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	memset(block, 0, size);
+	return block;
+	
+}
+
+
+/**
+ * Maps an object's type string onto its enumerated type.
+ *
+ * @param type - type string read in from the json parser, may be NULL
+ * @returns the object type, TYPE_NONE for empty or unknown objects
+ */
+static ObjectType object_type(char *type) {
+	if(type == NULL) {
+		return (TYPE_NONE);
+		
+	} else if(strcmp(type, "camera") == 0) {
+		return (TYPE_CAMERA);
+		
+	} else if(strcmp(type, "sphere") == 0) {
+		return (TYPE_SPHERE);
+		
+	} else if(strcmp(type, "plane") == 0) {
+		return (TYPE_PLANE);
+		
+	} else if(strcmp(type, "light") == 0) {
+		return (TYPE_LIGHT);
+		
+	}
+	
+	return (TYPE_NONE);
+	
+}
+
+
+/**
+ * Compiles the objects read in from the json parser into per type structure of arrays
+ * buffers. Sphere radii are squared, plane normals normalized and their offsets computed,
+ * and spotlight cone cosines precomputed so none of it is repeated per ray.
+ *
+ * @param objects - collection of objects read in from the json parser
+ * @param num_objects - number of objects in the collection
+ * @returns pointer to the compiled scene
+ */
+Scene* scene_compile(Object objects[], int num_objects) {
+	Scene *scene;
+	int index, num_spheres, num_planes;
+	
+	scene = (Scene *)scene_alloc(sizeof(Scene));
+	scene->objects = objects;
+	scene->num_objects = num_objects;
+	scene->camera = -1;
+	
+	scene->types = (ObjectType *)scene_alloc(sizeof(ObjectType) * num_objects);
+	scene->slots = (int *)scene_alloc(sizeof(int) * num_objects);
+	scene->materials = (Material *)scene_alloc(sizeof(Material) * num_objects);
+	
+	// Resolve types and count the primitives of each kind
+	num_spheres = num_planes = 0;
+	for(index = 0; index < num_objects; index++) {
+		scene->types[index] = object_type(objects[index].type);
+		
+		switch(scene->types[index]) {
+			case TYPE_CAMERA:
+				if(scene->camera == -1) {
+					scene->camera = index;
+					
+				}
+				break;
+				
+			case TYPE_SPHERE:
+				scene->slots[index] = num_spheres++;
+				break;
+				
+			case TYPE_PLANE:
+				scene->slots[index] = num_planes++;
+				break;
+				
+			case TYPE_LIGHT:
+				scene->slots[index] = scene->num_lights++;
+				break;
+				
+			default:
+				break;
+				
+		}
+		
+	}
+	
+	scene->spheres.x = (real *)scene_alloc(sizeof(real) * num_spheres);
+	scene->spheres.y = (real *)scene_alloc(sizeof(real) * num_spheres);
+	scene->spheres.z = (real *)scene_alloc(sizeof(real) * num_spheres);
+	scene->spheres.radius2 = (real *)scene_alloc(sizeof(real) * num_spheres);
+	scene->spheres.object = (int *)scene_alloc(sizeof(int) * num_spheres);
+	scene->spheres.count = num_spheres;
+	
+	scene->planes.x = (real *)scene_alloc(sizeof(real) * num_planes);
+	scene->planes.y = (real *)scene_alloc(sizeof(real) * num_planes);
+	scene->planes.z = (real *)scene_alloc(sizeof(real) * num_planes);
+	scene->planes.d = (real *)scene_alloc(sizeof(real) * num_planes);
+	scene->planes.object = (int *)scene_alloc(sizeof(int) * num_planes);
+	scene->planes.count = num_planes;
+	
+	scene->lights = (SceneLight *)scene_alloc(sizeof(SceneLight) * scene->num_lights);
+	
+	scene_update(scene);
+	
+	return scene;
+	
+}
+
+
+/**
+ * Fills in the compiled arrays of a scene from its objects, again after the objects' properties
+ * changed. The objects must keep their types and order, only their values are read. The eye
+ * stays at the origin while rendering, so a camera position is compiled in by moving every
+ * sphere, plane and light the other way.
+ *
+ * @param scene - scene compiled from the objects
+ */
+void scene_update(Scene *scene) {
+	Object *objects = scene->objects;
+	Sphere *sphere;
+	Plane *plane;
+	Light *light;
+	SceneLight *compiled;
+	real normal[3], position[3], eye[3];
+	int index, slot;
+	
+	eye[0] = eye[1] = eye[2] = 0.0;
+	if(scene->camera != -1) {
+		scene->viewport = objects[scene->camera].properties.camera;
+		vector_load(scene->viewport.position, eye);
+		
+	}
+	
+	for(index = 0; index < scene->num_objects; index++) {
+		slot = scene->slots[index];
+		
+		if(scene->types[index] == TYPE_SPHERE) {
+			sphere = &objects[index].properties.sphere;
+			
+			scene->spheres.x[slot] = sphere->position[0] - eye[0];
+			scene->spheres.y[slot] = sphere->position[1] - eye[1];
+			scene->spheres.z[slot] = sphere->position[2] - eye[2];
+			scene->spheres.radius2[slot] = sphere->radius * sphere->radius;
+			scene->spheres.object[slot] = index;
+			
+			vector_load(sphere->diffuse_color, scene->materials[index].diffuse_color);
+			vector_load(sphere->specular_color, scene->materials[index].specular_color);
+			scene->materials[index].reflectivity = sphere->reflectivity;
+			scene->materials[index].refractivity = sphere->refractivity;
+			scene->materials[index].ior = sphere->ior;
+			
+		} else if(scene->types[index] == TYPE_PLANE) {
+			plane = &objects[index].properties.plane;
+			
+			vector_load(plane->normal, normal);
+			normalize(normal);
+			
+			scene->planes.x[slot] = normal[0];
+			scene->planes.y[slot] = normal[1];
+			scene->planes.z[slot] = normal[2];
+			vector_load(plane->position, position);
+			vector_subtract(position, eye, position);
+			scene->planes.d[slot] = vector_dot_product(normal, position);
+			scene->planes.object[slot] = index;
+			
+			vector_load(plane->diffuse_color, scene->materials[index].diffuse_color);
+			vector_load(plane->specular_color, scene->materials[index].specular_color);
+			scene->materials[index].reflectivity = plane->reflectivity;
+			scene->materials[index].refractivity = plane->refractivity;
+			scene->materials[index].ior = plane->ior;
+			
+		} else if(scene->types[index] == TYPE_LIGHT) {
+			light = &objects[index].properties.light;
+			compiled = &scene->lights[slot];
+			
+			vector_load(light->position, compiled->position);
+			vector_subtract(compiled->position, eye, compiled->position);
+			vector_load(light->direction, compiled->direction);
+			vector_load(light->color, compiled->color);
+			compiled->radial_a0 = light->radial_a0;
+			compiled->radial_a1 = light->radial_a1;
+			compiled->radial_a2 = light->radial_a2;
+			compiled->angular_a0 = light->angular_a0;
+			
+			// A light without angle and direction is a point light
+			compiled->spotlight = !((light->theta == 0.0) && (light->direction[0] == 0) && (light->direction[1] == 0) && (light->direction[2] == 0));
+			compiled->cos_theta = cos((light->theta * M_PI) / 180); // <= Convert degrees into radians; (degrees * pi) / 180
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Compiles a scene and, when requested, builds the bounding volume hierarchy used by every
+ * ray traversal.
+ *
+ * @param objects - collection of objects read in from the json parser
+ * @param num_objects - number of objects in the collection
+ * @param use_bvh - 1 to build a bounding volume hierarchy, 0 to test every object per ray
+ * @returns pointer to the new scene
+ */
+Scene* scene_create(Object objects[], int num_objects, int use_bvh) {
+	Scene *scene = scene_compile(objects, num_objects);
+	
+	if(use_bvh != 0) {
+		scene->bvh = bvh_build(scene);
+		
+	}
+	
+	return scene;
+	
+}
+
+
+/**
+ * Releases a compiled scene, the parsed object array is owned by the caller. A scene loaded
+ * from a file releases its mapping.
+ *
+ * @param scene - scene to release
+ */
+void scene_free(Scene *scene) {
+	if(scene == NULL) {
+		return;
+		
+	}
+	
+	// Arrays of a loaded scene file belong to the mapping
+	if(scene->mapping != NULL) {
+		if(scene->mapped_bvh != 0) {
+			free(scene->bvh);
+			
+		} else {
+			bvh_free(scene->bvh);
+			
+		}
+		
+		munmap(scene->mapping, scene->mapping_size);
+		free(scene);
+		return;
+		
+	}
+	
+	bvh_free(scene->bvh);
+	
+	free(scene->spheres.x);
+	free(scene->spheres.y);
+	free(scene->spheres.z);
+	free(scene->spheres.radius2);
+	free(scene->spheres.object);
+	
+	free(scene->planes.x);
+	free(scene->planes.y);
+	free(scene->planes.z);
+	free(scene->planes.d);
+	free(scene->planes.object);
+	
+	free(scene->lights);
+	free(scene->materials);
+	free(scene->slots);
+	free(scene->types);
+	free(scene);
+	
+}
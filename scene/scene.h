@@ -0,0 +1,200 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: scene.h
+ * Copyright © 2016 All rights reserved 
+ */
+ 
+#ifndef scene_h
+	#define scene_h
+	
+	// Alignment in bytes of every compiled array, wide enough for 256-bit vector loads
+	#define SCENE_ALIGNMENT 32
+
+	/**
+	 * Object type resolved once when the scene is compiled so the render loops never
+	 * compare type strings.
+	 */
+	typedef enum ObjectType {
+		TYPE_NONE,
+		TYPE_CAMERA,
+		TYPE_SPHERE,
+		TYPE_PLANE,
+		TYPE_LIGHT
+		
+	} ObjectType;
+	
+	/**
+	 * Surface properties of a sphere or plane, indexed by object.
+	 */
+	typedef struct Material {
+		real diffuse_color[3];
+		real specular_color[3];
+		real reflectivity;
+		real refractivity;
+		real ior;
+		
+	} Material;
+	
+	/**
+	 * Structure of arrays holding every sphere, center coordinates and squared radius are
+	 * stored in separate aligned arrays. object maps a slot back to its index in the scene.
+	 */
+	typedef struct SphereArray {
+		real *x, *y, *z;
+		real *radius2;
+		int *object;
+		int count;
+		
+	} SphereArray;
+	
+	/**
+	 * Structure of arrays holding every plane as a unit normal and the offset d = normal . position
+	 * so that the plane is the set of points p with normal . p = d.
+	 */
+	typedef struct PlaneArray {
+		real *x, *y, *z;
+		real *d;
+		int *object;
+		int count;
+		
+	} PlaneArray;
+	
+	/**
+	 * Light with its spotlight cone cosine precomputed. Lights are consumed one at a time by the
+	 * shading loop so they are kept as an aligned array of structures.
+	 */
+	typedef struct SceneLight {
+		real position[3];
+		real direction[3];
+		real color[3];
+		real cos_theta;
+		real radial_a0;
+		real radial_a1;
+		real radial_a2;
+		real angular_a0;
+		int spotlight;
+		
+	} SceneLight;
+
+	/**
+	 * Scene compiled for rendering from the objects read in by the json parser. Hits are
+	 * identified by the object's index in the parsed array, types, slots and materials are
+	 * indexed the same way. viewport holds the size and position of the first camera. A scene loaded from a
+	 * compiled scene file has no objects, its arrays point into the file mapping instead.
+	 */
+	typedef struct Scene {
+		Object *objects;
+		int num_objects;
+		Camera viewport;
+		
+		ObjectType *types;
+		int *slots;
+		Material *materials;
+		
+		SphereArray spheres;
+		PlaneArray planes;
+		SceneLight *lights;
+		int num_lights;
+		
+		int camera;
+		struct BVH *bvh;
+		
+		void *mapping;
+		size_t mapping_size;
+		int mapped_bvh;
+		
+	} Scene;
+	
+	
+	/**
+	 * This function calculates the distance a ray vector intersects a compiled sphere.
+	 *
+	 * @param spheres - compiled sphere arrays
+	 * @param slot - index of the sphere within the arrays
+	 * @param ro - ray vector orgin
+	 * @param rd - ray vector direction
+	 * @returns double percision float t value that represents length of the intersecting vector, and -1 if no intersection was detected.
+	 */     
+	static inline real sphere_intersection(SphereArray *spheres, int slot, real *ro, real *rd) {
+		real a, b, c, discriminant, root, t1, t0;
+		real ox, oy, oz;
+		
+		// Step 1.) Find the equation for the object you are interested in..  
+		// Step 2.) Parameterize the equation with a center point
+		// Step 3.) Substitute the eq for a ray into our object equation.
+		// Step 4.) Solve for t.
+		// Step 5.) Rewrite the equation (flatten).
+		ox = ro[0] - spheres->x[slot];
+		oy = ro[1] - spheres->y[slot];
+		oz = ro[2] - spheres->z[slot];
+		
+		a = (rd[0] * rd[0]) + (rd[1] * rd[1]) + (rd[2] * rd[2]);
+		b = (2 * (rd[0] * ox + rd[1] * oy + rd[2] * oz));
+		c = (ox * ox) + (oy * oy) + (oz * oz) - spheres->radius2[slot];
+		
+		discriminant = (b * b) - 4 * a * c;
+		
+		if(discriminant < 0) {
+			return (-1); // <= has no solution
+			
+		}
+
+		// Quadratic Equation
+		root = real_sqrt(discriminant);
+		t1 = (-1 * b + root) / (2 * a);
+		t0 = (-1 * b - root) / (2 * a);
+		
+		if(t0 >= 0) {
+			return t0;
+			
+		} else if(t1 >= 0) {
+			return t1;
+			
+		} else {
+			return (-1);
+			
+		}
+
+	}
+	
+	
+	/**
+	 * This function calculates the distance a ray vector intersects a compiled plane,
+	 * t = (d - normal . ro) / (normal . rd).
+	 *
+	 * @param planes - compiled plane arrays
+	 * @param slot - index of the plane within the arrays
+	 * @param ro - ray vector orgin
+	 * @param rd - ray vector direction
+	 * @returns double percision float t value that represents length of the intersecting vector, and -1 if no intersection was detected.
+	 */
+	static inline real plane_intersection(PlaneArray *planes, int slot, real *ro, real *rd) {
+		real numerator, denominator, t;
+		
+		numerator = planes->d[slot] - ((planes->x[slot] * ro[0]) + (planes->y[slot] * ro[1]) + (planes->z[slot] * ro[2])); 
+		denominator = (planes->x[slot] * rd[0]) + (planes->y[slot] * rd[1]) + (planes->z[slot] * rd[2]);
+		
+		t = numerator / denominator;
+		
+		if(t >= 0) {
+			return (t);
+			
+		} else {
+			return (-1);
+			
+		}
+		
+	}
+
+	// function declarations
+	void *scene_alloc(size_t size);
+	Scene* scene_compile(Object objects[], int num_objects);
+	void scene_update(Scene *scene);
+	Scene* scene_create(Object objects[], int num_objects, int use_bvh);
+	void scene_free(Scene *scene);
+	size_t scene_write_file(Scene *scene, const char *path);
+	Scene* scene_load_file(const char *path, int use_bvh);
+ 
+#endif
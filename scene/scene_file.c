@@ -0,0 +1,536 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: scene_file.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "..\math\real.h"
+#include "..\json\json.h"
+#include "scene.h"
+#include "..\simd\simd.h"
+#include "..\bvh\bvh.h"
+
+// First bytes of every compiled scene file
+#define SCENE_FILE_MAGIC "RTBSCENE"
+
+// Bumped whenever the layout of the file or of a stored structure changes
+#define SCENE_FILE_VERSION 1
+
+/**
+ * Arrays stored in a compiled scene file, in file order.
+ */
+typedef enum SceneSection {
+	SECTION_TYPES,
+	SECTION_SLOTS,
+	SECTION_MATERIALS,
+	SECTION_SPHERE_X,
+	SECTION_SPHERE_Y,
+	SECTION_SPHERE_Z,
+	SECTION_SPHERE_RADIUS2,
+	SECTION_SPHERE_OBJECT,
+	SECTION_PLANE_X,
+	SECTION_PLANE_Y,
+	SECTION_PLANE_Z,
+	SECTION_PLANE_D,
+	SECTION_PLANE_OBJECT,
+	SECTION_LIGHTS,
+	SECTION_BVH_NODES,
+	SECTION_BVH_INDICES,
+	SCENE_SECTIONS
+	
+} SceneSection;
+
+/**
+ * Position and size in bytes of one array within the file.
+ */
+typedef struct SectionEntry {
+	uint64_t offset;
+	uint64_t size;
+	
+} SectionEntry;
+
+/**
+ * Start of a compiled scene file. Every number is little-endian and every array starts on a
+ * multiple of SCENE_ALIGNMENT bytes, so a mapping of the file can be rendered from directly.
+ * real_size tells files of the double and single precision builds apart; the section sizes
+ * double as a check that the stored structures have the layout this build expects. A file
+ * without a bounding volume hierarchy has num_nodes 0.
+ */
+typedef struct SceneFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t real_size;
+	uint64_t file_size;
+	int32_t num_objects;
+	int32_t camera;
+	int32_t num_spheres;
+	int32_t num_planes;
+	int32_t num_lights;
+	int32_t num_nodes;
+	int32_t num_indices;
+	int32_t bvh_depth;
+	double viewport_width;
+	double viewport_height;
+	SectionEntry sections[SCENE_SECTIONS];
+	
+} SceneFileHeader;
+
+/**
+ * Checks the byte order of the machine, the file format is defined as little-endian and
+ * arrays are stored and mapped as they are in memory.
+ *
+ * @returns 1 on little-endian machines, 0 otherwise
+ */
+static int little_endian(void) {
+	uint32_t probe = 1;
+	
+	return (*(unsigned char *)&probe == 1);
+	
+}
+
+
+/**
+ * Rounds a file offset up to the scene alignment.
+ *
+ * @param offset - offset in bytes
+ * @returns the aligned offset
+ */
+static uint64_t align_offset(uint64_t offset) {
+	return ((offset + SCENE_ALIGNMENT - 1) & ~((uint64_t)SCENE_ALIGNMENT - 1));
+	
+}
+
+
+/**
+ * Writes a compiled scene, and its bounding volume hierarchy when it has one, to a file the
+ * renderer can map instead of parsing the json scene again. Exits the program if the file
+ * can not be written.
+ *
+ * @param scene - the compiled scene
+ * @param path - file to write
+ * @returns size of the file in bytes
+ */
+size_t scene_write_file(Scene *scene, const char *path) {
+	static const char padding[SCENE_ALIGNMENT] = {0};
+	SceneFileHeader header;
+	const void *data[SCENE_SECTIONS];
+	uint64_t offset;
+	FILE *fpointer;
+	int section, failed;
+	
+	if(little_endian() == 0) {
+		fprintf(stderr, "Error, scene files are little-endian and this machine is not.\n");
+		exit(-1);
+		
+	}
+	
+	memset(&header, 0, sizeof(SceneFileHeader));
+	memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+	header.version = SCENE_FILE_VERSION;
+	header.real_size = sizeof(real);
+	header.num_objects = scene->num_objects;
+	header.camera = scene->camera;
+	header.num_spheres = scene->spheres.count;
+	header.num_planes = scene->planes.count;
+	header.num_lights = scene->num_lights;
+	header.viewport_width = scene->viewport.width;
+	header.viewport_height = scene->viewport.height;
+	
+	if(scene->bvh != NULL) {
+		header.num_nodes = scene->bvh->num_nodes;
+		header.num_indices = scene->bvh->num_indices;
+		header.bvh_depth = scene->bvh->depth;
+		
+	}
+	
+	// Arrays in file order with their sizes
+	data[SECTION_TYPES] = scene->types;
+	header.sections[SECTION_TYPES].size = sizeof(ObjectType) * scene->num_objects;
+	data[SECTION_SLOTS] = scene->slots;
+	header.sections[SECTION_SLOTS].size = sizeof(int) * scene->num_objects;
+	data[SECTION_MATERIALS] = scene->materials;
+	header.sections[SECTION_MATERIALS].size = sizeof(Material) * scene->num_objects;
+	
+	data[SECTION_SPHERE_X] = scene->spheres.x;
+	data[SECTION_SPHERE_Y] = scene->spheres.y;
+	data[SECTION_SPHERE_Z] = scene->spheres.z;
+	data[SECTION_SPHERE_RADIUS2] = scene->spheres.radius2;
+	for(section = SECTION_SPHERE_X; section <= SECTION_SPHERE_RADIUS2; section++) {
+		header.sections[section].size = sizeof(real) * scene->spheres.count;
+		
+	}
+	data[SECTION_SPHERE_OBJECT] = scene->spheres.object;
+	header.sections[SECTION_SPHERE_OBJECT].size = sizeof(int) * scene->spheres.count;
+	
+	data[SECTION_PLANE_X] = scene->planes.x;
+	data[SECTION_PLANE_Y] = scene->planes.y;
+	data[SECTION_PLANE_Z] = scene->planes.z;
+	data[SECTION_PLANE_D] = scene->planes.d;
+	for(section = SECTION_PLANE_X; section <= SECTION_PLANE_D; section++) {
+		header.sections[section].size = sizeof(real) * scene->planes.count;
+		
+	}
+	data[SECTION_PLANE_OBJECT] = scene->planes.object;
+	header.sections[SECTION_PLANE_OBJECT].size = sizeof(int) * scene->planes.count;
+	
+	data[SECTION_LIGHTS] = scene->lights;
+	header.sections[SECTION_LIGHTS].size = sizeof(SceneLight) * scene->num_lights;
+	
+	data[SECTION_BVH_NODES] = (scene->bvh != NULL) ? scene->bvh->nodes : NULL;
+	header.sections[SECTION_BVH_NODES].size = sizeof(BVHNode) * header.num_nodes;
+	data[SECTION_BVH_INDICES] = (scene->bvh != NULL) ? scene->bvh->indices : NULL;
+	header.sections[SECTION_BVH_INDICES].size = sizeof(int) * header.num_indices;
+	
+	// Lay the arrays out one after the other, each padded to the alignment
+	offset = align_offset(sizeof(SceneFileHeader));
+	for(section = 0; section < SCENE_SECTIONS; section++) {
+		header.sections[section].offset = offset;
+		offset = align_offset(offset + header.sections[section].size);
+		
+	}
+	header.file_size = offset;
+	
+	fpointer = fopen(path, "wb");
+	if(fpointer == NULL) {
+		fprintf(stderr, "Error, could not open file '%s'.\n", path);
+		exit(-1);
+		
+	}
+	
+	offset = sizeof(SceneFileHeader);
+	fwrite(&header, sizeof(SceneFileHeader), 1, fpointer);
+	
+	for(section = 0; section < SCENE_SECTIONS; section++) {
+		fwrite(padding, 1, header.sections[section].offset - offset, fpointer);
+		if(header.sections[section].size > 0) {
+			fwrite(data[section], 1, header.sections[section].size, fpointer);
+			
+		}
+		offset = header.sections[section].offset + header.sections[section].size;
+		
+	}
+	fwrite(padding, 1, header.file_size - offset, fpointer);
+	
+	failed = ferror(fpointer);
+	if((fclose(fpointer) != 0) || (failed != 0)) {
+		fprintf(stderr, "Error, could not write file '%s'.\n", path);
+		exit(-1);
+		
+	}
+	
+	return (header.file_size);
+	
+}
+
+
+/**
+ * Returns a pointer to an array of a mapped scene file after checking it lies within the
+ * file and has the size this build expects.
+ *
+ * @param header - header of the mapped file
+ * @param section - the array
+ * @param size - expected size in bytes
+ * @param path - the file, for errors
+ * @returns pointer to the array inside the mapping
+ */
+static void *section_data(SceneFileHeader *header, int section, uint64_t size, const char *path) {
+	SectionEntry *entry = &header->sections[section];
+	
+	if((entry->size != size) || (entry->offset % SCENE_ALIGNMENT != 0) || (entry->offset > header->file_size) || (entry->size > header->file_size - entry->offset)) {
+		fprintf(stderr, "Error, '%s' is damaged or was written by an incompatible build; compile the scene again.\n", path);
+		exit(-1);
+		
+	}
+	
+	return ((char *)header + entry->offset);
+	
+}
+
+
+/**
+ * Checks that every index a loaded scene stores lies within the array it indexes, so a
+ * damaged file is refused instead of read out of bounds while rendering.
+ *
+ * @param scene - scene pointing at the arrays of a mapped file
+ * @returns 1 if every index is in range, 0 otherwise
+ */
+static int check_scene(Scene *scene) {
+	int index, slot, limit;
+	
+	if((scene->camera < -1) || (scene->camera >= scene->num_objects)) {
+		return (0);
+		
+	}
+	
+	// A slot indexes the array of its object's type
+	for(index = 0; index < scene->num_objects; index++) {
+		switch(scene->types[index]) {
+			case TYPE_NONE:
+			case TYPE_CAMERA:
+				continue;
+				
+			case TYPE_SPHERE:
+				limit = scene->spheres.count;
+				break;
+				
+			case TYPE_PLANE:
+				limit = scene->planes.count;
+				break;
+				
+			case TYPE_LIGHT:
+				limit = scene->num_lights;
+				break;
+				
+			default:
+				return (0);
+				
+		}
+		
+		slot = scene->slots[index];
+		if((slot < 0) || (slot >= limit)) {
+			return (0);
+			
+		}
+		
+	}
+	
+	for(index = 0; index < scene->spheres.count; index++) {
+		if((scene->spheres.object[index] < 0) || (scene->spheres.object[index] >= scene->num_objects)) {
+			return (0);
+			
+		}
+		
+	}
+	
+	for(index = 0; index < scene->planes.count; index++) {
+		if((scene->planes.object[index] < 0) || (scene->planes.object[index] >= scene->num_objects)) {
+			return (0);
+			
+		}
+		
+	}
+	
+	return (1);
+	
+}
+
+
+/**
+ * Checks the nodes of a mapped bounding volume hierarchy: leaves must reference entries of
+ * the index array and those sphere slots, and interior nodes children stored after them, as
+ * bvh_build lays them out, so the tree has no cycles. The depth of every node is worked out
+ * from its parent's in the same pass, the traversal stacks hold BVH_STACK_SIZE nodes.
+ *
+ * @param bvh - hierarchy pointing at the arrays of a mapped file
+ * @param num_spheres - number of sphere slots
+ * @returns 1 if the hierarchy can be traversed safely, 0 otherwise
+ */
+static int check_bvh(BVH *bvh, int num_spheres) {
+	BVHNode *node;
+	int *depths;
+	int index, valid;
+	
+	if((bvh->depth < 0) || (bvh->depth >= BVH_STACK_SIZE - 1)) {
+		return (0);
+		
+	}
+	
+	// The hierarchy of a scene without spheres is a single empty root that is never traversed
+	if(bvh->num_indices == 0) {
+		return (1);
+		
+	}
+	
+	for(index = 0; index < bvh->num_indices; index++) {
+		if((bvh->indices[index] < 0) || (bvh->indices[index] >= num_spheres)) {
+			return (0);
+			
+		}
+		
+	}
+	
+	depths = (int *)calloc(bvh->num_nodes, sizeof(int));
+	if(depths == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	valid = 1;
+	for(index = 0; (index < bvh->num_nodes) && (valid != 0); index++) {
+		node = &bvh->nodes[index];
+		
+		if(node->count > 0) {
+			valid = (node->first >= 0) && (node->first <= bvh->num_indices - node->count);
+			
+		} else {
+			valid = (node->count == 0) && (node->first > index) && (node->first < bvh->num_nodes - 1) && (depths[index] < bvh->depth);
+			if(valid != 0) {
+				depths[node->first] = depths[index] + 1;
+				depths[node->first + 1] = depths[index] + 1;
+				
+			}
+			
+		}
+		
+	}
+	
+	free(depths);
+	
+	return (valid);
+	
+}
+
+
+/**
+ * Maps a compiled scene file and points a scene at its arrays, nothing is parsed or copied.
+ * The stored bounding volume hierarchy is used when use_bvh is set; a file without one gets
+ * one built. Exits the program on files that can not be read or were written for another
+ * version or precision.
+ *
+ * @param path - file written by scene_write_file
+ * @param use_bvh - 1 to traverse a bounding volume hierarchy, 0 to test every object per ray
+ * @returns pointer to the scene, release with scene_free
+ */
+Scene* scene_load_file(const char *path, int use_bvh) {
+	SceneFileHeader *header;
+	struct stat status;
+	Scene *scene;
+	BVH *bvh;
+	void *mapping;
+	int fd;
+	
+	if(little_endian() == 0) {
+		fprintf(stderr, "Error, scene files are little-endian and this machine is not.\n");
+		exit(-1);
+		
+	}
+	
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "Error, could not open file.\n");
+		exit(-1);
+		
+	}
+	
+	if((fstat(fd, &status) != 0) || (status.st_size < (off_t)sizeof(SceneFileHeader))) {
+		fprintf(stderr, "Error, '%s' is not a compiled scene file.\n", path);
+		exit(-1);
+		
+	}
+	
+	// The renderer only reads the scene, pages are shared with the page cache
+	mapping = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED) {
+		fprintf(stderr, "Error, could not map file '%s'.\n", path);
+		exit(-1);
+		
+	}
+	
+	header = (SceneFileHeader *)mapping;
+	if(memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(header->magic)) != 0) {
+		fprintf(stderr, "Error, '%s' is not a compiled scene file.\n", path);
+		exit(-1);
+		
+	}
+	
+	if(header->version != SCENE_FILE_VERSION) {
+		fprintf(stderr, "Error, '%s' is version %u, this build reads version %d; compile the scene again.\n", path, header->version, SCENE_FILE_VERSION);
+		exit(-1);
+		
+	}
+	
+	if(header->real_size != sizeof(real)) {
+		fprintf(stderr, "Error, '%s' was compiled with %u byte reals, this build uses %d; compile the scene again.\n", path, header->real_size, (int)sizeof(real));
+		exit(-1);
+		
+	}
+	
+	if((header->file_size > (uint64_t)status.st_size) || (header->num_objects < 0) || (header->num_spheres < 0) || (header->num_planes < 0) || (header->num_lights < 0) || (header->num_nodes < 0) || (header->num_indices < 0)) {
+		fprintf(stderr, "Error, '%s' is damaged or was written by an incompatible build; compile the scene again.\n", path);
+		exit(-1);
+		
+	}
+	
+	scene = (Scene *)scene_alloc(sizeof(Scene));
+	scene->mapping = mapping;
+	scene->mapping_size = status.st_size;
+	scene->objects = NULL;
+	scene->num_objects = header->num_objects;
+	scene->camera = header->camera;
+	scene->viewport.width = header->viewport_width;
+	scene->viewport.height = header->viewport_height;
+	
+	scene->types = (ObjectType *)section_data(header, SECTION_TYPES, sizeof(ObjectType) * (uint64_t)header->num_objects, path);
+	scene->slots = (int *)section_data(header, SECTION_SLOTS, sizeof(int) * (uint64_t)header->num_objects, path);
+	scene->materials = (Material *)section_data(header, SECTION_MATERIALS, sizeof(Material) * (uint64_t)header->num_objects, path);
+	
+	scene->spheres.x = (real *)section_data(header, SECTION_SPHERE_X, sizeof(real) * (uint64_t)header->num_spheres, path);
+	scene->spheres.y = (real *)section_data(header, SECTION_SPHERE_Y, sizeof(real) * (uint64_t)header->num_spheres, path);
+	scene->spheres.z = (real *)section_data(header, SECTION_SPHERE_Z, sizeof(real) * (uint64_t)header->num_spheres, path);
+	scene->spheres.radius2 = (real *)section_data(header, SECTION_SPHERE_RADIUS2, sizeof(real) * (uint64_t)header->num_spheres, path);
+	scene->spheres.object = (int *)section_data(header, SECTION_SPHERE_OBJECT, sizeof(int) * (uint64_t)header->num_spheres, path);
+	scene->spheres.count = header->num_spheres;
+	
+	scene->planes.x = (real *)section_data(header, SECTION_PLANE_X, sizeof(real) * (uint64_t)header->num_planes, path);
+	scene->planes.y = (real *)section_data(header, SECTION_PLANE_Y, sizeof(real) * (uint64_t)header->num_planes, path);
+	scene->planes.z = (real *)section_data(header, SECTION_PLANE_Z, sizeof(real) * (uint64_t)header->num_planes, path);
+	scene->planes.d = (real *)section_data(header, SECTION_PLANE_D, sizeof(real) * (uint64_t)header->num_planes, path);
+	scene->planes.object = (int *)section_data(header, SECTION_PLANE_OBJECT, sizeof(int) * (uint64_t)header->num_planes, path);
+	scene->planes.count = header->num_planes;
+	
+	scene->lights = (SceneLight *)section_data(header, SECTION_LIGHTS, sizeof(SceneLight) * (uint64_t)header->num_lights, path);
+	scene->num_lights = header->num_lights;
+	
+	if(check_scene(scene) == 0) {
+		fprintf(stderr, "Error, '%s' is damaged or was written by an incompatible build; compile the scene again.\n", path);
+		exit(-1);
+		
+	}
+	
+	if(use_bvh == 0) {
+		// Traverse nothing, test every object
+		
+	} else if(header->num_nodes > 0) {
+		bvh = (BVH *)calloc(1, sizeof(BVH));
+		if(bvh == NULL) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
+			
+		}
+		
+		bvh->nodes = (BVHNode *)section_data(header, SECTION_BVH_NODES, sizeof(BVHNode) * (uint64_t)header->num_nodes, path);
+		bvh->num_nodes = header->num_nodes;
+		bvh->indices = (int *)section_data(header, SECTION_BVH_INDICES, sizeof(int) * (uint64_t)header->num_indices, path);
+		bvh->num_indices = header->num_indices;
+		bvh->depth = header->bvh_depth;
+		
+		if(check_bvh(bvh, scene->spheres.count) == 0) {
+			fprintf(stderr, "Error, '%s' is damaged or was written by an incompatible build; compile the scene again.\n", path);
+			exit(-1);
+			
+		}
+		
+		scene->bvh = bvh;
+		scene->mapped_bvh = 1;
+		
+	} else {
+		scene->bvh = bvh_build(scene);
+		
+	}
+	
+	return (scene);
+	
+}
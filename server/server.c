@@ -0,0 +1,466 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: server.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include "..\math\real.h"
+#include "..\ppm\ppm.h"
+#include "..\arena\arena.h"
+#include "..\json\json.h"
+#include "..\filemap\filemap.h"
+#include "..\threadpool\threadpool.h"
+#include "..\scene\scene.h"
+#include "..\raycaster\raycaster.h"
+#include "..\stats\stats.h"
+#include "server.h"
+
+/**
+ * Sends the error that ends a job, one line with the message's trailing newline dropped.
+ *
+ * @param out - stream to the client
+ * @param message - the message
+ */
+static void server_error(FILE *out, const char *message) {
+	int length = strlen(message);
+	
+	while((length > 0) && (message[length - 1] == '\n')) {
+		length--;
+		
+	}
+	
+	fprintf(out, "error %.*s\n", length, message);
+	fflush(out);
+	
+}
+
+
+/**
+ * Sends the stage a job has reached.
+ *
+ * @param out - stream to the client
+ * @param stage - name of the stage
+ */
+static void server_status(FILE *out, const char *stage) {
+	fprintf(out, "status %s\n", stage);
+	fflush(out);
+	
+}
+
+
+/**
+ * Sends the counters and stage times of a job as the JSON object of --stats, preceded by a
+ * line with its length in bytes.
+ *
+ * @param out - stream to the client
+ * @param times - seconds spent in each stage
+ * @param arena - arena holding the parsed scene
+ * @param max_depth - deepest bounce of the render
+ */
+static void server_stats(FILE *out, StatsTimes *times, Arena *arena, int max_depth) {
+	RenderStats total;
+	FILE *report;
+	char *text;
+	size_t length;
+	
+	stats_merge(&total);
+	
+	report = open_memstream(&text, &length);
+	if(report == NULL) {
+		return;
+		
+	}
+	
+	stats_write(report, &total, times, arena, max_depth);
+	fclose(report);
+	
+	fprintf(out, "stats %zu\n", length);
+	fwrite(text, 1, length, out);
+	fflush(out);
+	free(text);
+	
+}
+
+
+/**
+ * Checks whether an image could be written to a path without creating or truncating anything:
+ * an existing file must be a regular file and writable, otherwise the directory it would be
+ * created in must be writable.
+ *
+ * @param output - path of the image
+ * @returns 1 if the image could be written, 0 otherwise
+ */
+static int server_writable(const char *output) {
+	char directory[SERVER_LINE];
+	struct stat status;
+	char *slash;
+	
+	// A directory or a device passes access() but can not be written as an image
+	if(stat(output, &status) == 0) {
+		return (S_ISREG(status.st_mode) && (access(output, W_OK) == 0));
+		
+	}
+	
+	snprintf(directory, sizeof(directory), "%s", output);
+	slash = strrchr(directory, '/');
+	if(slash == NULL) {
+		strcpy(directory, ".");
+		
+	} else {
+		// The root directory keeps its slash
+		slash[(slash == directory) ? 1 : 0] = '\0';
+		
+	}
+	
+	return (access(directory, W_OK | X_OK) == 0);
+	
+}
+
+
+/**
+ * Parses the scene length of an inline request. Only decimal digits are accepted, no sign,
+ * spaces or anything after them, and the length must not exceed SERVER_MAX_SCENE.
+ *
+ * @param text - the length as sent by the client
+ * @param size - receives the length
+ * @returns 1 for a valid length, 0 otherwise
+ */
+static int server_length(const char *text, size_t *size) {
+	unsigned long long length;
+	char *end;
+	
+	if(isdigit((unsigned char)text[0]) == 0) {
+		return (0);
+		
+	}
+	
+	errno = 0;
+	length = strtoull(text, &end, 10);
+	if((errno != 0) || (*end != '\0') || (length > SERVER_MAX_SCENE)) {
+		return (0);
+		
+	}
+	
+	*size = (size_t)length;
+	return (1);
+	
+}
+
+
+/**
+ * Renders one job. Everything a bad scene or output path would exit the program for in a
+ * single render is sent back as an error instead, and the server moves on to the next job.
+ *
+ * @param config - render settings and pool of the server
+ * @param out - stream to the client
+ * @param width - image width in pixels
+ * @param height - image height in pixels
+ * @param output - path the image is written to, as PNG when it ends in .png
+ * @param data - the json scene
+ * @param size - size of the scene in bytes
+ * @returns 1 when the image was written, 0 on errors
+ */
+static int server_job(ServerConfig *config, FILE *out, int width, int height, char *output, const char *data, size_t size) {
+	char message[SERVER_LINE];
+	RenderSettings settings;
+	StatsTimes times;
+	Object *objects;
+	Scene *scene;
+	Image image;
+	Arena arena;
+	double start;
+	int num_objects, written;
+	
+	// Fail before any work is done when the image could not be written, leaving no file behind
+	if(server_writable(output) == 0) {
+		snprintf(message, sizeof(message), "Error, could not open output file '%s'.", output);
+		server_error(out, message);
+		return (0);
+		
+	}
+	
+	memset(&times, 0, sizeof(StatsTimes));
+	start = wall_clock();
+	
+	server_status(out, "parsing");
+	arena_init(&arena);
+	objects = json_try_parse_scene(data, size, &arena, &num_objects, config->pool, message, sizeof(message));
+	times.parse = wall_clock() - start;
+	
+	if(objects == NULL) {
+		server_error(out, message);
+		arena_free(&arena);
+		return (0);
+		
+	} else if(num_objects <= 0) {
+		server_error(out, "Error, the scene is empty.");
+		arena_free(&arena);
+		return (0);
+		
+	}
+	
+	server_status(out, "building");
+	start = wall_clock();
+	scene = scene_create(objects, num_objects, config->use_bvh);
+	times.build = wall_clock() - start;
+	
+	if(scene->camera == -1) {
+		server_error(out, "Error, no camera object was found.");
+		scene_free(scene);
+		arena_free(&arena);
+		return (0);
+		
+	}
+	
+	image.magic_number = "P6";
+	image.width = width;
+	image.height = height;
+	image.max_color = MAX_COLOR;
+	image.band_start = 0;
+	image.band_height = height;
+	image.band_left = 0;
+	image.band_width = width;
+	image.image_data = (Pixel *)malloc(sizeof(Pixel) * (size_t)width * height);
+	
+	if(image.image_data == NULL) {
+		server_error(out, "Failed to allocate memory.");
+		scene_free(scene);
+		arena_free(&arena);
+		return (0);
+		
+	}
+	
+	server_status(out, "rendering");
+	settings = config->settings;
+	start = wall_clock();
+	stats_enabled = 1;
+	render_image(scene, &image, config->pool, config->tile_size, config->wavefront, &settings);
+	stats_enabled = 0;
+	times.render = wall_clock() - start;
+	
+	server_status(out, "writing");
+	start = wall_clock();
+	if(is_png_file(output) != 0) {
+		written = try_write_png_image(output, &image, config->pool, message, sizeof(message));
+		
+	} else {
+		written = try_write_p6_image(output, &image, message, sizeof(message));
+		
+	}
+	times.write = wall_clock() - start;
+	
+	// A full disk must not take the server down with it
+	if(written == 0) {
+		server_error(out, message);
+		stats_reset();
+		free(image.image_data);
+		scene_free(scene);
+		arena_free(&arena);
+		return (0);
+		
+	}
+	
+	server_stats(out, &times, &arena, settings.max_depth);
+	stats_reset();
+	
+	fprintf(out, "done %s\n", output);
+	fflush(out);
+	
+	free(image.image_data);
+	scene_free(scene);
+	arena_free(&arena);
+	
+	return (1);
+	
+}
+
+
+/**
+ * Serves the jobs of one connection until the client hangs up. A request is one line,
+ *
+ *     render width height output scene.json
+ *     inline width height output length
+ *
+ * the second followed by length bytes of json scene. The scene path is the rest of the line so
+ * it may hold spaces, the output path may not. Every job is answered with status lines as it
+ * goes through parsing, building, rendering and writing, then a stats line with the length of
+ * the JSON statistics that follow it and a done line, or with an error line. quit ends the
+ * connection, shutdown ends the server.
+ *
+ * @param config - render settings and pool of the server
+ * @param client - the connected socket
+ * @returns 1 when the client asked the server to shut down, 0 otherwise
+ */
+static int server_client(ServerConfig *config, int client) {
+	char line[SERVER_LINE], output[SERVER_LINE], message[SERVER_LINE], command[16], *scene_path, *data;
+	int width, height, offset, mapped, shutdown;
+	size_t size;
+	FILE *in, *out;
+	
+	in = fdopen(client, "r");
+	out = fdopen(dup(client), "w");
+	if((in == NULL) || (out == NULL)) {
+		if(in != NULL) {
+			fclose(in);
+			
+		} else {
+			close(client);
+			
+		}
+		
+		return (0);
+		
+	}
+	
+	shutdown = 0;
+	
+	while(fgets(line, sizeof(line), in) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+		
+		if(strcmp(line, "quit") == 0) {
+			break;
+			
+		} else if(strcmp(line, "shutdown") == 0) {
+			shutdown = 1;
+			break;
+			
+		} else if((sscanf(line, "%15s %d %d %4095s %n", command, &width, &height, output, &offset) != 4) || ((strcmp(command, "render") != 0) && (strcmp(command, "inline") != 0))) {
+			server_error(out, "Error, unknown request, expected 'render width height output scene.json' or 'inline width height output length'.");
+			continue;
+			
+		}
+		
+		if((width < 1) || (height < 1) || ((long long)width * height > SERVER_MAX_PIXELS)) {
+			server_error(out, "Error, incorrect width and/or height value(s).");
+			continue;
+			
+		}
+		
+		if(strcmp(command, "render") == 0) {
+			scene_path = line + offset;
+			data = map_file(scene_path, &size, &mapped);
+			
+			if(data == NULL) {
+				server_error(out, "Error, could not open file.");
+				continue;
+				
+			}
+			
+			server_job(config, out, width, height, output, data, size);
+			unmap_file(data, size, mapped);
+			
+		} else {
+			// The scene bytes that follow a bad length can not be told apart from requests,
+			// so the connection ends after the error
+			if(server_length(line + offset, &size) == 0) {
+				snprintf(message, sizeof(message), "Error, the scene length must be a number of bytes no larger than %d.", SERVER_MAX_SCENE);
+				server_error(out, message);
+				break;
+				
+			}
+			
+			data = (char *)malloc(size + 1);
+			
+			if(data == NULL) {
+				server_error(out, "Failed to allocate memory.");
+				break;
+				
+			}
+			
+			// A short read means the client hung up, there is nobody left to answer
+			if(fread(data, 1, size, in) != size) {
+				free(data);
+				break;
+				
+			}
+			
+			server_job(config, out, width, height, output, data, size);
+			free(data);
+			
+		}
+		
+	}
+	
+	fclose(in);
+	fclose(out);
+	
+	return (shutdown);
+	
+}
+
+
+/**
+ * Runs a render server on a Unix domain socket. The scene parser, the hierarchy and the pool
+ * are set up once per process instead of once per image, and one job renders at a time on
+ * the whole pool while further clients wait to be accepted. Returns once a client sends
+ * shutdown.
+ *
+ * @param socket_path - path the socket is bound to, a stale socket there is replaced
+ * @param config - render settings and pool every job is rendered with
+ * @returns 0 after a shutdown, -1 if the socket could not be set up
+ */
+int server_run(const char *socket_path, ServerConfig *config) {
+	struct sockaddr_un address;
+	int listener, client, shutdown;
+	
+	if(strlen(socket_path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Error, socket path '%s' is too long.\n", socket_path);
+		return (-1);
+		
+	}
+	
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socket_path);
+	
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path);
+	
+	if((listener < 0) || (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0) || (listen(listener, SERVER_BACKLOG) != 0)) {
+		fprintf(stderr, "Error, could not listen on socket '%s'.\n", socket_path);
+		if(listener >= 0) {
+			close(listener);
+			
+		}
+		
+		return (-1);
+		
+	}
+	
+	// A client that hangs up mid job must not take the server with it
+	signal(SIGPIPE, SIG_IGN);
+	
+	printf("Serving on %s\n", socket_path);
+	fflush(stdout);
+	
+	shutdown = 0;
+	while(shutdown == 0) {
+		client = accept(listener, NULL, NULL);
+		if(client < 0) {
+			continue;
+			
+		}
+		
+		shutdown = server_client(config, client);
+		
+	}
+	
+	close(listener);
+	unlink(socket_path);
+	
+	return (0);
+	
+}
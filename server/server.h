@@ -0,0 +1,40 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: server.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef server_h
+	#define server_h
+	
+	// Longest request line a client may send, and longest error message sent back
+	#define SERVER_LINE 4096
+	
+	// Most pixels a job may ask for, the image is held whole while it renders
+	#define SERVER_MAX_PIXELS (1 << 27)
+	
+	// Largest inline scene a client may send, in bytes
+	#define SERVER_MAX_SCENE (1 << 28)
+	
+	// Connections waiting to be accepted while a job renders
+	#define SERVER_BACKLOG 16
+	
+	/**
+	 * Render settings of a server. Every job is rendered with them on the same pool, which
+	 * stays up between jobs.
+	 */
+	typedef struct ServerConfig {
+		ThreadPool *pool;
+		int tile_size;
+		int wavefront;
+		int use_bvh;
+		RenderSettings settings;
+		
+	} ServerConfig;
+	
+	// function declarations
+	int server_run(const char *socket_path, ServerConfig *config);
+	
+#endif
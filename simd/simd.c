@@ -0,0 +1,621 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: simd.c
+ * Copyright © 2016 All rights reserved 
+ */
+ 
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "..\math\real.h"
+#include "..\json\json.h"
+#include "..\scene\scene.h"
+#include "simd.h"
+#include "..\bvh\bvh.h"
+#include "..\stats\stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define SIMD_X86 1
+#endif
+
+/**
+ * Records a hit on one ray of a packet if it is closer than the ray's current closest hit.
+ * Equal distances go to the lower object index, hits on the ray's ignored object are dropped.
+ *
+ * @param packet - the ray packet
+ * @param lane - index of the ray within the packet
+ * @param distance - distance of the candidate hit
+ * @param object - array index of the object that was hit
+ */
+static inline void packet_update(RayPacket *packet, int lane, real distance, int object) {
+	if(object == packet->ignore[lane]) {
+		return;
+		
+	}
+	
+	if((distance < packet->distance[lane]) || ((distance == packet->distance[lane]) && (object < packet->object[lane]))) {
+		packet->distance[lane] = distance;
+		packet->object[lane] = object;
+		
+	}
+	
+}
+
+
+/**
+ * Scalar fallback, intersects every ray of the packet in turn.
+ *
+ * @param packet - the ray packet
+ * @param spheres - compiled sphere arrays
+ * @param slot - index of the sphere within the arrays
+ */
+static void sphere_packet_scalar(RayPacket *packet, SphereArray *spheres, int slot) {
+	real ro[3], rd[3], distance;
+	int lane;
+	
+	for(lane = 0; lane < PACKET_SIZE; lane++) {
+		ro[0] = packet->ox[lane];
+		ro[1] = packet->oy[lane];
+		ro[2] = packet->oz[lane];
+		rd[0] = packet->dx[lane];
+		rd[1] = packet->dy[lane];
+		rd[2] = packet->dz[lane];
+		
+		distance = sphere_intersection(spheres, slot, ro, rd);
+		if(distance > 0) {
+			packet_update(packet, lane, distance, spheres->object[slot]);
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Scalar fallback, intersects every ray of the packet in turn.
+ *
+ * @param packet - the ray packet
+ * @param planes - compiled plane arrays
+ * @param slot - index of the plane within the arrays
+ */
+static void plane_packet_scalar(RayPacket *packet, PlaneArray *planes, int slot) {
+	real ro[3], rd[3], distance;
+	int lane;
+	
+	for(lane = 0; lane < PACKET_SIZE; lane++) {
+		ro[0] = packet->ox[lane];
+		ro[1] = packet->oy[lane];
+		ro[2] = packet->oz[lane];
+		rd[0] = packet->dx[lane];
+		rd[1] = packet->dy[lane];
+		rd[2] = packet->dz[lane];
+		
+		distance = plane_intersection(planes, slot, ro, rd);
+		if(distance > 0) {
+			packet_update(packet, lane, distance, planes->object[slot]);
+			
+		}
+		
+	}
+	
+}
+
+
+#if defined(SIMD_X86) && !defined(SINGLE_PRECISION)
+
+/**
+ * SSE2 sphere kernel, two rays per register. Performs the same operations in the same order
+ * as sphere_intersection so the distances are bit identical.
+ *
+ * @param packet - the ray packet
+ * @param spheres - compiled sphere arrays
+ * @param slot - index of the sphere within the arrays
+ */
+__attribute__((target("sse2")))
+static void sphere_packet_sse2(RayPacket *packet, SphereArray *spheres, int slot) {
+	__m128d ox, oy, oz, dx, dy, dz, a, b, c, discriminant, root, neg_b, two_a, t0, t1, t, valid;
+	__m128d zero = _mm_setzero_pd();
+	__m128d sign = _mm_set1_pd(-0.0);
+	double distance[2] __attribute__((aligned(16)));
+	int lane, offset, mask;
+	
+	for(offset = 0; offset < PACKET_SIZE; offset += 2) {
+		ox = _mm_sub_pd(_mm_load_pd(&packet->ox[offset]), _mm_set1_pd(spheres->x[slot]));
+		oy = _mm_sub_pd(_mm_load_pd(&packet->oy[offset]), _mm_set1_pd(spheres->y[slot]));
+		oz = _mm_sub_pd(_mm_load_pd(&packet->oz[offset]), _mm_set1_pd(spheres->z[slot]));
+		dx = _mm_load_pd(&packet->dx[offset]);
+		dy = _mm_load_pd(&packet->dy[offset]);
+		dz = _mm_load_pd(&packet->dz[offset]);
+		
+		a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+		b = _mm_mul_pd(_mm_set1_pd(2.0), _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, ox), _mm_mul_pd(dy, oy)), _mm_mul_pd(dz, oz)));
+		c = _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(ox, ox), _mm_mul_pd(oy, oy)), _mm_mul_pd(oz, oz)), _mm_set1_pd(spheres->radius2[slot]));
+		discriminant = _mm_sub_pd(_mm_mul_pd(b, b), _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(4.0), a), c));
+		
+		// Quadratic Equation
+		root = _mm_sqrt_pd(discriminant);
+		neg_b = _mm_xor_pd(b, sign);
+		two_a = _mm_mul_pd(_mm_set1_pd(2.0), a);
+		t1 = _mm_div_pd(_mm_add_pd(neg_b, root), two_a);
+		t0 = _mm_div_pd(_mm_sub_pd(neg_b, root), two_a);
+		
+		// Nearest non negative root
+		valid = _mm_cmpge_pd(t0, zero);
+		t = _mm_or_pd(_mm_and_pd(valid, t0), _mm_andnot_pd(valid, t1));
+		
+		mask = _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(discriminant, zero), _mm_cmpgt_pd(t, zero)));
+		if(mask != 0) {
+			_mm_store_pd(distance, t);
+			
+			for(lane = 0; lane < 2; lane++) {
+				if(mask & (1 << lane)) {
+					packet_update(packet, offset + lane, distance[lane], spheres->object[slot]);
+					
+				}
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * SSE2 plane kernel, two rays per register.
+ *
+ * @param packet - the ray packet
+ * @param planes - compiled plane arrays
+ * @param slot - index of the plane within the arrays
+ */
+__attribute__((target("sse2")))
+static void plane_packet_sse2(RayPacket *packet, PlaneArray *planes, int slot) {
+	__m128d nx, ny, nz, numerator, denominator, t;
+	double distance[2] __attribute__((aligned(16)));
+	int lane, offset, mask;
+	
+	nx = _mm_set1_pd(planes->x[slot]);
+	ny = _mm_set1_pd(planes->y[slot]);
+	nz = _mm_set1_pd(planes->z[slot]);
+	
+	for(offset = 0; offset < PACKET_SIZE; offset += 2) {
+		numerator = _mm_sub_pd(_mm_set1_pd(planes->d[slot]), _mm_add_pd(_mm_add_pd(_mm_mul_pd(nx, _mm_load_pd(&packet->ox[offset])), _mm_mul_pd(ny, _mm_load_pd(&packet->oy[offset]))), _mm_mul_pd(nz, _mm_load_pd(&packet->oz[offset]))));
+		denominator = _mm_add_pd(_mm_add_pd(_mm_mul_pd(nx, _mm_load_pd(&packet->dx[offset])), _mm_mul_pd(ny, _mm_load_pd(&packet->dy[offset]))), _mm_mul_pd(nz, _mm_load_pd(&packet->dz[offset])));
+		t = _mm_div_pd(numerator, denominator);
+		
+		mask = _mm_movemask_pd(_mm_cmpgt_pd(t, _mm_setzero_pd()));
+		if(mask != 0) {
+			_mm_store_pd(distance, t);
+			
+			for(lane = 0; lane < 2; lane++) {
+				if(mask & (1 << lane)) {
+					packet_update(packet, offset + lane, distance[lane], planes->object[slot]);
+					
+				}
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * AVX2 sphere kernel, the whole packet in one register. Performs the same operations in the
+ * same order as sphere_intersection so the distances are bit identical.
+ *
+ * @param packet - the ray packet
+ * @param spheres - compiled sphere arrays
+ * @param slot - index of the sphere within the arrays
+ */
+__attribute__((target("avx2")))
+static void sphere_packet_avx2(RayPacket *packet, SphereArray *spheres, int slot) {
+	__m256d ox, oy, oz, dx, dy, dz, a, b, c, discriminant, root, neg_b, two_a, t0, t1, t, valid;
+	__m256d zero = _mm256_setzero_pd();
+	double distance[PACKET_SIZE] __attribute__((aligned(32)));
+	int lane, mask;
+	
+	ox = _mm256_sub_pd(_mm256_load_pd(packet->ox), _mm256_set1_pd(spheres->x[slot]));
+	oy = _mm256_sub_pd(_mm256_load_pd(packet->oy), _mm256_set1_pd(spheres->y[slot]));
+	oz = _mm256_sub_pd(_mm256_load_pd(packet->oz), _mm256_set1_pd(spheres->z[slot]));
+	dx = _mm256_load_pd(packet->dx);
+	dy = _mm256_load_pd(packet->dy);
+	dz = _mm256_load_pd(packet->dz);
+	
+	a = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+	b = _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, ox), _mm256_mul_pd(dy, oy)), _mm256_mul_pd(dz, oz)));
+	c = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ox, ox), _mm256_mul_pd(oy, oy)), _mm256_mul_pd(oz, oz)), _mm256_set1_pd(spheres->radius2[slot]));
+	discriminant = _mm256_sub_pd(_mm256_mul_pd(b, b), _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(4.0), a), c));
+	
+	// Quadratic Equation
+	root = _mm256_sqrt_pd(discriminant);
+	neg_b = _mm256_xor_pd(b, _mm256_set1_pd(-0.0));
+	two_a = _mm256_mul_pd(_mm256_set1_pd(2.0), a);
+	t1 = _mm256_div_pd(_mm256_add_pd(neg_b, root), two_a);
+	t0 = _mm256_div_pd(_mm256_sub_pd(neg_b, root), two_a);
+	
+	// Nearest non negative root
+	valid = _mm256_cmp_pd(t0, zero, _CMP_GE_OQ);
+	t = _mm256_blendv_pd(t1, t0, valid);
+	
+	mask = _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(discriminant, zero, _CMP_GE_OQ), _mm256_cmp_pd(t, zero, _CMP_GT_OQ)));
+	if(mask != 0) {
+		_mm256_store_pd(distance, t);
+		
+		for(lane = 0; lane < PACKET_SIZE; lane++) {
+			if(mask & (1 << lane)) {
+				packet_update(packet, lane, distance[lane], spheres->object[slot]);
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * AVX2 plane kernel, the whole packet in one register.
+ *
+ * @param packet - the ray packet
+ * @param planes - compiled plane arrays
+ * @param slot - index of the plane within the arrays
+ */
+__attribute__((target("avx2")))
+static void plane_packet_avx2(RayPacket *packet, PlaneArray *planes, int slot) {
+	__m256d nx, ny, nz, numerator, denominator, t;
+	double distance[PACKET_SIZE] __attribute__((aligned(32)));
+	int lane, mask;
+	
+	nx = _mm256_set1_pd(planes->x[slot]);
+	ny = _mm256_set1_pd(planes->y[slot]);
+	nz = _mm256_set1_pd(planes->z[slot]);
+	
+	numerator = _mm256_sub_pd(_mm256_set1_pd(planes->d[slot]), _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(nx, _mm256_load_pd(packet->ox)), _mm256_mul_pd(ny, _mm256_load_pd(packet->oy))), _mm256_mul_pd(nz, _mm256_load_pd(packet->oz))));
+	denominator = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(nx, _mm256_load_pd(packet->dx)), _mm256_mul_pd(ny, _mm256_load_pd(packet->dy))), _mm256_mul_pd(nz, _mm256_load_pd(packet->dz)));
+	t = _mm256_div_pd(numerator, denominator);
+	
+	mask = _mm256_movemask_pd(_mm256_cmp_pd(t, _mm256_setzero_pd(), _CMP_GT_OQ));
+	if(mask != 0) {
+		_mm256_store_pd(distance, t);
+		
+		for(lane = 0; lane < PACKET_SIZE; lane++) {
+			if(mask & (1 << lane)) {
+				packet_update(packet, lane, distance[lane], planes->object[slot]);
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+#endif
+
+#if defined(SIMD_X86) && defined(SINGLE_PRECISION)
+
+/**
+ * Single precision SSE sphere kernel, four rays per register. Performs the same operations in
+ * the same order as sphere_intersection so the distances are bit identical.
+ *
+ * @param packet - the ray packet
+ * @param spheres - compiled sphere arrays
+ * @param slot - index of the sphere within the arrays
+ */
+__attribute__((target("sse2")))
+static void sphere_packet_sse(RayPacket *packet, SphereArray *spheres, int slot) {
+	__m128 ox, oy, oz, dx, dy, dz, a, b, c, discriminant, root, neg_b, two_a, t0, t1, t, valid;
+	__m128 zero = _mm_setzero_ps();
+	float distance[4] __attribute__((aligned(16)));
+	int lane, offset, mask;
+	
+	for(offset = 0; offset < PACKET_SIZE; offset += 4) {
+		ox = _mm_sub_ps(_mm_load_ps(&packet->ox[offset]), _mm_set1_ps(spheres->x[slot]));
+		oy = _mm_sub_ps(_mm_load_ps(&packet->oy[offset]), _mm_set1_ps(spheres->y[slot]));
+		oz = _mm_sub_ps(_mm_load_ps(&packet->oz[offset]), _mm_set1_ps(spheres->z[slot]));
+		dx = _mm_load_ps(&packet->dx[offset]);
+		dy = _mm_load_ps(&packet->dy[offset]);
+		dz = _mm_load_ps(&packet->dz[offset]);
+		
+		a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		b = _mm_mul_ps(_mm_set1_ps(2.0f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ox), _mm_mul_ps(dy, oy)), _mm_mul_ps(dz, oz)));
+		c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)), _mm_set1_ps(spheres->radius2[slot]));
+		discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.0f), a), c));
+		
+		// Quadratic Equation
+		root = _mm_sqrt_ps(discriminant);
+		neg_b = _mm_xor_ps(b, _mm_set1_ps(-0.0f));
+		two_a = _mm_mul_ps(_mm_set1_ps(2.0f), a);
+		t1 = _mm_div_ps(_mm_add_ps(neg_b, root), two_a);
+		t0 = _mm_div_ps(_mm_sub_ps(neg_b, root), two_a);
+		
+		// Nearest non negative root
+		valid = _mm_cmpge_ps(t0, zero);
+		t = _mm_or_ps(_mm_and_ps(valid, t0), _mm_andnot_ps(valid, t1));
+		
+		mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_cmpgt_ps(t, zero)));
+		if(mask != 0) {
+			_mm_store_ps(distance, t);
+			
+			for(lane = 0; lane < 4; lane++) {
+				if(mask & (1 << lane)) {
+					packet_update(packet, offset + lane, distance[lane], spheres->object[slot]);
+					
+				}
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Single precision SSE plane kernel, four rays per register.
+ *
+ * @param packet - the ray packet
+ * @param planes - compiled plane arrays
+ * @param slot - index of the plane within the arrays
+ */
+__attribute__((target("sse2")))
+static void plane_packet_sse(RayPacket *packet, PlaneArray *planes, int slot) {
+	__m128 nx, ny, nz, numerator, denominator, t;
+	float distance[4] __attribute__((aligned(16)));
+	int lane, offset, mask;
+	
+	nx = _mm_set1_ps(planes->x[slot]);
+	ny = _mm_set1_ps(planes->y[slot]);
+	nz = _mm_set1_ps(planes->z[slot]);
+	
+	for(offset = 0; offset < PACKET_SIZE; offset += 4) {
+		numerator = _mm_sub_ps(_mm_set1_ps(planes->d[slot]), _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_load_ps(&packet->ox[offset])), _mm_mul_ps(ny, _mm_load_ps(&packet->oy[offset]))), _mm_mul_ps(nz, _mm_load_ps(&packet->oz[offset]))));
+		denominator = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_load_ps(&packet->dx[offset])), _mm_mul_ps(ny, _mm_load_ps(&packet->dy[offset]))), _mm_mul_ps(nz, _mm_load_ps(&packet->dz[offset])));
+		t = _mm_div_ps(numerator, denominator);
+		
+		mask = _mm_movemask_ps(_mm_cmpgt_ps(t, _mm_setzero_ps()));
+		if(mask != 0) {
+			_mm_store_ps(distance, t);
+			
+			for(lane = 0; lane < 4; lane++) {
+				if(mask & (1 << lane)) {
+					packet_update(packet, offset + lane, distance[lane], planes->object[slot]);
+					
+				}
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Single precision AVX2 sphere kernel, the whole packet of eight rays in one register.
+ * Performs the same operations in the same order as sphere_intersection so the distances are
+ * bit identical.
+ *
+ * @param packet - the ray packet
+ * @param spheres - compiled sphere arrays
+ * @param slot - index of the sphere within the arrays
+ */
+__attribute__((target("avx2")))
+static void sphere_packet_avx(RayPacket *packet, SphereArray *spheres, int slot) {
+	__m256 ox, oy, oz, dx, dy, dz, a, b, c, discriminant, root, neg_b, two_a, t0, t1, t, valid;
+	__m256 zero = _mm256_setzero_ps();
+	float distance[PACKET_SIZE] __attribute__((aligned(32)));
+	int lane, mask;
+	
+	ox = _mm256_sub_ps(_mm256_load_ps(packet->ox), _mm256_set1_ps(spheres->x[slot]));
+	oy = _mm256_sub_ps(_mm256_load_ps(packet->oy), _mm256_set1_ps(spheres->y[slot]));
+	oz = _mm256_sub_ps(_mm256_load_ps(packet->oz), _mm256_set1_ps(spheres->z[slot]));
+	dx = _mm256_load_ps(packet->dx);
+	dy = _mm256_load_ps(packet->dy);
+	dz = _mm256_load_ps(packet->dz);
+	
+	a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+	b = _mm256_mul_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, ox), _mm256_mul_ps(dy, oy)), _mm256_mul_ps(dz, oz)));
+	c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)), _mm256_mul_ps(oz, oz)), _mm256_set1_ps(spheres->radius2[slot]));
+	discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(4.0f), a), c));
+	
+	// Quadratic Equation
+	root = _mm256_sqrt_ps(discriminant);
+	neg_b = _mm256_xor_ps(b, _mm256_set1_ps(-0.0f));
+	two_a = _mm256_mul_ps(_mm256_set1_ps(2.0f), a);
+	t1 = _mm256_div_ps(_mm256_add_ps(neg_b, root), two_a);
+	t0 = _mm256_div_ps(_mm256_sub_ps(neg_b, root), two_a);
+	
+	// Nearest non negative root
+	valid = _mm256_cmp_ps(t0, zero, _CMP_GE_OQ);
+	t = _mm256_blendv_ps(t1, t0, valid);
+	
+	mask = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, zero, _CMP_GT_OQ)));
+	if(mask != 0) {
+		_mm256_store_ps(distance, t);
+		
+		for(lane = 0; lane < PACKET_SIZE; lane++) {
+			if(mask & (1 << lane)) {
+				packet_update(packet, lane, distance[lane], spheres->object[slot]);
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Single precision AVX2 plane kernel, the whole packet of eight rays in one register.
+ *
+ * @param packet - the ray packet
+ * @param planes - compiled plane arrays
+ * @param slot - index of the plane within the arrays
+ */
+__attribute__((target("avx2")))
+static void plane_packet_avx(RayPacket *packet, PlaneArray *planes, int slot) {
+	__m256 nx, ny, nz, numerator, denominator, t;
+	float distance[PACKET_SIZE] __attribute__((aligned(32)));
+	int lane, mask;
+	
+	nx = _mm256_set1_ps(planes->x[slot]);
+	ny = _mm256_set1_ps(planes->y[slot]);
+	nz = _mm256_set1_ps(planes->z[slot]);
+	
+	numerator = _mm256_sub_ps(_mm256_set1_ps(planes->d[slot]), _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_load_ps(packet->ox)), _mm256_mul_ps(ny, _mm256_load_ps(packet->oy))), _mm256_mul_ps(nz, _mm256_load_ps(packet->oz))));
+	denominator = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_load_ps(packet->dx)), _mm256_mul_ps(ny, _mm256_load_ps(packet->dy))), _mm256_mul_ps(nz, _mm256_load_ps(packet->dz)));
+	t = _mm256_div_ps(numerator, denominator);
+	
+	mask = _mm256_movemask_ps(_mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GT_OQ));
+	if(mask != 0) {
+		_mm256_store_ps(distance, t);
+		
+		for(lane = 0; lane < PACKET_SIZE; lane++) {
+			if(mask & (1 << lane)) {
+				packet_update(packet, lane, distance[lane], planes->object[slot]);
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+#endif
+
+// Kernels in use, scalar until simd_init runs
+sphere_packet_kernel sphere_intersection_packet = sphere_packet_scalar;
+plane_packet_kernel plane_intersection_packet = plane_packet_scalar;
+
+
+/**
+ * Selects the packet kernels. Without a preference, or with "auto", the widest instruction
+ * set supported by the processor is used. A preference the processor does not support falls
+ * back to automatic selection.
+ *
+ * @param preference - "auto", "avx2", "sse2", "scalar" or NULL
+ * @returns name of the selected kernels
+ */
+const char *simd_init(const char *preference) {
+	int avx2 = 0, sse2 = 0;
+	
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2");
+	sse2 = __builtin_cpu_supports("sse2");
+#endif
+	
+	if(preference == NULL) {
+		preference = "auto";
+		
+	}
+	
+	if(strcmp(preference, "scalar") == 0) {
+		avx2 = sse2 = 0;
+		
+	} else if(strcmp(preference, "sse2") == 0) {
+		avx2 = 0;
+		
+	} else if((strcmp(preference, "avx2") != 0) && (strcmp(preference, "auto") != 0)) {
+		fprintf(stderr, "Error, unknown instruction set '%s', using automatic selection.\n", preference);
+		
+	}
+	
+	sphere_intersection_packet = sphere_packet_scalar;
+	plane_intersection_packet = plane_packet_scalar;
+	
+#if defined(SIMD_X86) && defined(SINGLE_PRECISION)
+	// A packet of eight floats fills one AVX2 register, or two SSE registers
+	if(avx2 != 0) {
+		sphere_intersection_packet = sphere_packet_avx;
+		plane_intersection_packet = plane_packet_avx;
+		return ("avx2");
+		
+	} else if(sse2 != 0) {
+		sphere_intersection_packet = sphere_packet_sse;
+		plane_intersection_packet = plane_packet_sse;
+		return ("sse2");
+		
+	}
+#elif defined(SIMD_X86)
+	if(avx2 != 0) {
+		sphere_intersection_packet = sphere_packet_avx2;
+		plane_intersection_packet = plane_packet_avx2;
+		return ("avx2");
+		
+	} else if(sse2 != 0) {
+		sphere_intersection_packet = sphere_packet_sse2;
+		plane_intersection_packet = plane_packet_sse2;
+		return ("sse2");
+		
+	}
+#endif
+	
+	return ("scalar");
+	
+}
+
+
+/**
+ * Clears the closest hit of every ray in a packet.
+ *
+ * @param packet - the ray packet
+ */
+void packet_reset(RayPacket *packet) {
+	int lane;
+	
+	for(lane = 0; lane < PACKET_SIZE; lane++) {
+		packet->distance[lane] = INFINITY;
+		packet->object[lane] = -1;
+		
+	}
+	
+}
+
+
+/**
+ * Finds the closest sphere or plane hit by every ray of a packet, through the bounding volume
+ * hierarchy when the scene has one. Gives the same result per ray as scene_closest.
+ *
+ * @param scene - the scene
+ * @param packet - the ray packet, distance and object receive the closest hits
+ */
+void packet_closest(Scene *scene, RayPacket *packet) {
+	int slot;
+	
+	packet_reset(packet);
+	STATS_ADD(plane_tests, scene->planes.count * PACKET_SIZE);
+	
+	for(slot = 0; slot < scene->planes.count; slot++) {
+		plane_intersection_packet(packet, &scene->planes, slot);
+		
+	}
+	
+	if(scene->bvh != NULL) {
+		bvh_closest_packet(scene->bvh, scene, packet);
+		
+	} else {
+		STATS_ADD(sphere_tests, scene->spheres.count * PACKET_SIZE);
+		for(slot = 0; slot < scene->spheres.count; slot++) {
+			sphere_intersection_packet(packet, &scene->spheres, slot);
+			
+		}
+		
+	}
+	
+}
@@ -0,0 +1,57 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: simd.h
+ * Copyright © 2016 All rights reserved 
+ */
+ 
+#ifndef simd_h
+	#define simd_h
+	
+	// Number of rays traced together, one 256-bit register of doubles or of floats
+	#ifdef SINGLE_PRECISION
+		#define PACKET_SIZE 8
+	#else
+		#define PACKET_SIZE 4
+	#endif
+	
+	// Columns of the block of pixels whose view rays form one packet, the block is two rows tall
+	#define PACKET_COLUMNS (PACKET_SIZE / 2)
+	
+	/**
+	 * A packet of coherent rays stored as structure of arrays so one vector load fetches the
+	 * same component of every ray. distance and object hold the closest hit of each ray, an
+	 * inactive ray has a NaN direction and never hits anything. ignore holds per ray an object
+	 * index excluded from the test or -1, it is set by the caller along with the rays.
+	 */
+	typedef struct RayPacket {
+		real ox[PACKET_SIZE] __attribute__((aligned(32)));
+		real oy[PACKET_SIZE] __attribute__((aligned(32)));
+		real oz[PACKET_SIZE] __attribute__((aligned(32)));
+		real dx[PACKET_SIZE] __attribute__((aligned(32)));
+		real dy[PACKET_SIZE] __attribute__((aligned(32)));
+		real dz[PACKET_SIZE] __attribute__((aligned(32)));
+		real distance[PACKET_SIZE] __attribute__((aligned(32)));
+		int object[PACKET_SIZE];
+		int ignore[PACKET_SIZE];
+		
+	} RayPacket;
+	
+	/**
+	 * Intersects every ray of a packet with one compiled primitive and keeps the closest hit per
+	 * ray. Equal distances go to the lower object index, matching the scalar traversal.
+	 */
+	typedef void (*sphere_packet_kernel)(RayPacket *packet, SphereArray *spheres, int slot);
+	typedef void (*plane_packet_kernel)(RayPacket *packet, PlaneArray *planes, int slot);
+	
+	// Kernels selected by simd_init
+	extern sphere_packet_kernel sphere_intersection_packet;
+	extern plane_packet_kernel plane_intersection_packet;
+
+	// function declarations
+	const char *simd_init(const char *preference);
+	void packet_reset(RayPacket *packet);
+	void packet_closest(Scene *scene, RayPacket *packet);
+ 
+#endif
@@ -0,0 +1,181 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: stats.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "..\arena\arena.h"
+#include "stats.h"
+
+int stats_enabled = 0;
+__thread RenderStats *thread_stats = NULL;
+
+static RenderStats *stats_list = NULL;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Creates the counters of the calling thread and adds them to the list merged at the end of
+ * the render. Called once per thread.
+ *
+ * @returns zeroed counters
+ */
+RenderStats* stats_register(void) {
+	RenderStats *stats;
+	
+	stats = (RenderStats *)calloc(1, sizeof(RenderStats));
+	if(stats == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	pthread_mutex_lock(&stats_lock);
+	stats->next = stats_list;
+	stats_list = stats;
+	pthread_mutex_unlock(&stats_lock);
+	
+	return (stats);
+	
+}
+
+
+/**
+ * Adds up the counters of every thread. Only call while no thread is rendering.
+ *
+ * @param total - receives the sums
+ */
+void stats_merge(RenderStats *total) {
+	RenderStats *stats;
+	int depth;
+	
+	memset(total, 0, sizeof(RenderStats));
+	
+	pthread_mutex_lock(&stats_lock);
+	for(stats = stats_list; stats != NULL; stats = stats->next) {
+		total->primary_rays += stats->primary_rays;
+		total->reflection_rays += stats->reflection_rays;
+		total->refraction_rays += stats->refraction_rays;
+		total->shadow_rays += stats->shadow_rays;
+		total->occluded_shadow_rays += stats->occluded_shadow_rays;
+		total->sphere_tests += stats->sphere_tests;
+		total->plane_tests += stats->plane_tests;
+		total->hits += stats->hits;
+		
+		for(depth = 0; depth < STATS_DEPTHS; depth++) {
+			total->depth[depth] += stats->depth[depth];
+			
+		}
+		
+	}
+	pthread_mutex_unlock(&stats_lock);
+	
+}
+
+
+/**
+ * Writes merged counters and stage times as a JSON object.
+ *
+ * @param fpointer - stream the report is written to
+ * @param total - merged counters
+ * @param times - seconds spent in each stage
+ * @param arena - arena holding the parsed scene, reported as its memory footprint
+ * @param max_depth - deepest bounce of the render, bounds the histogram
+ */
+void stats_write(FILE *fpointer, RenderStats *total, StatsTimes *times, Arena *arena, int max_depth) {
+	int depth, last;
+	
+	last = (max_depth < STATS_DEPTHS - 1) ? max_depth : (STATS_DEPTHS - 1);
+	
+	fprintf(fpointer, "{\n");
+	fprintf(fpointer, "    \"rays\": {\n");
+	fprintf(fpointer, "        \"primary\": %lld,\n", total->primary_rays);
+	fprintf(fpointer, "        \"reflection\": %lld,\n", total->reflection_rays);
+	fprintf(fpointer, "        \"refraction\": %lld,\n", total->refraction_rays);
+	fprintf(fpointer, "        \"shadow\": %lld,\n", total->shadow_rays);
+	fprintf(fpointer, "        \"shadow_occluded\": %lld\n", total->occluded_shadow_rays);
+	fprintf(fpointer, "    },\n");
+	fprintf(fpointer, "    \"tests\": {\n");
+	fprintf(fpointer, "        \"sphere\": %lld,\n", total->sphere_tests);
+	fprintf(fpointer, "        \"plane\": %lld\n", total->plane_tests);
+	fprintf(fpointer, "    },\n");
+	fprintf(fpointer, "    \"hits\": %lld,\n", total->hits);
+	fprintf(fpointer, "    \"depth_histogram\": [");
+	for(depth = 0; depth <= last; depth++) {
+		fprintf(fpointer, "%s%lld", (depth > 0) ? ", " : "", total->depth[depth]);
+		
+	}
+	fprintf(fpointer, "],\n");
+	fprintf(fpointer, "    \"time_ms\": {\n");
+	fprintf(fpointer, "        \"parse\": %.3f,\n", times->parse * 1000.0);
+	fprintf(fpointer, "        \"build\": %.3f,\n", times->build * 1000.0);
+	fprintf(fpointer, "        \"render\": %.3f,\n", times->render * 1000.0);
+	fprintf(fpointer, "        \"write\": %.3f\n", times->write * 1000.0);
+	fprintf(fpointer, "    },\n");
+	fprintf(fpointer, "    \"scene_memory\": {\n");
+	fprintf(fpointer, "        \"used\": %zu,\n", arena->used);
+	fprintf(fpointer, "        \"reserved\": %zu,\n", arena->reserved);
+	fprintf(fpointer, "        \"blocks\": %d\n", arena->num_blocks);
+	fprintf(fpointer, "    }\n");
+	fprintf(fpointer, "}\n");
+	
+}
+
+
+/**
+ * Zeroes the counters of every thread but keeps them, so threads that live on, like the
+ * workers of a pool, can count the next render. Only call while no thread is rendering.
+ */
+void stats_reset(void) {
+	RenderStats *stats, *next;
+	
+	pthread_mutex_lock(&stats_lock);
+	for(stats = stats_list; stats != NULL; stats = next) {
+		next = stats->next;
+		memset(stats, 0, sizeof(RenderStats));
+		stats->next = next;
+		
+	}
+	pthread_mutex_unlock(&stats_lock);
+	
+}
+
+
+/**
+ * Frees the counters of every thread. Threads that counted must not count again afterwards.
+ */
+void stats_free(void) {
+	RenderStats *stats;
+	
+	pthread_mutex_lock(&stats_lock);
+	while(stats_list != NULL) {
+		stats = stats_list;
+		stats_list = stats->next;
+		free(stats);
+		
+	}
+	pthread_mutex_unlock(&stats_lock);
+	
+	thread_stats = NULL;
+	
+}
+
+
+/**
+ * Returns the wall clock time in seconds, used to time the stages of a run.
+ *
+ * @returns seconds since an arbitrary point in the past
+ */
+double wall_clock(void) {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec + now.tv_nsec * 1e-9);
+	
+}
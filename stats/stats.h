@@ -0,0 +1,80 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: stats.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef stats_h
+	#define stats_h
+	
+	// Buckets of the depth histogram, deeper rays are counted in the last one
+	#define STATS_DEPTHS 16
+	
+	/**
+	 * Counters of one thread. Every thread that renders gets its own block on first use, so
+	 * counting never touches memory shared with another thread. The blocks are chained through
+	 * next and added up once the render is over.
+	 */
+	typedef struct RenderStats {
+		long long primary_rays;
+		long long reflection_rays;
+		long long refraction_rays;
+		long long shadow_rays;
+		long long occluded_shadow_rays;
+		long long sphere_tests;
+		long long plane_tests;
+		long long hits;
+		long long depth[STATS_DEPTHS];
+		struct RenderStats *next;
+		
+	} RenderStats;
+	
+	/**
+	 * Wall clock seconds spent in each stage of a run.
+	 */
+	typedef struct StatsTimes {
+		double parse;
+		double build;
+		double render;
+		double write;
+		
+	} StatsTimes;
+	
+	// Scene storage, see arena.h
+	struct Arena;
+	
+	extern int stats_enabled;
+	extern __thread RenderStats *thread_stats;
+	
+	// function declarations
+	RenderStats* stats_register(void);
+	void stats_merge(RenderStats *total);
+	void stats_write(FILE *fpointer, RenderStats *total, StatsTimes *times, struct Arena *arena, int max_depth);
+	void stats_reset(void);
+	void stats_free(void);
+	double wall_clock(void);
+	
+	/**
+	 * Returns the counters of the calling thread, creating them on first use.
+	 *
+	 * @returns counters of the calling thread
+	 */
+	static inline RenderStats* stats_local(void) {
+		if(thread_stats == NULL) {
+			thread_stats = stats_register();
+			
+		}
+		
+		return (thread_stats);
+		
+	}
+	
+	// Adds to a counter of the calling thread, a single predictable branch while disabled
+	#define STATS_ADD(counter, amount) do { if(stats_enabled != 0) { stats_local()->counter += (amount); } } while(0)
+	
+	// Counts a ray shaded at a depth of the histogram
+	#define STATS_DEPTH(ray_depth) STATS_ADD(depth[((ray_depth) < STATS_DEPTHS) ? (ray_depth) : (STATS_DEPTHS - 1)], 1)
+	
+#endif
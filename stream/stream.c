@@ -0,0 +1,252 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: stream.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "..\ppm\ppm.h"
+#include "stream.h"
+
+/**
+ * Writer thread of a stream. Writes the submitted bands out in order and hands their buffers
+ * back to the ring, until the stream closes and every submitted band is written.
+ *
+ * @param argument - the ImageStream
+ * @returns NULL
+ */
+static void* stream_writer(void *argument) {
+	ImageStream *stream = (ImageStream *)argument;
+	Image *band;
+	size_t count;
+	
+	pthread_mutex_lock(&stream->lock);
+	
+	for(;;) {
+		while((stream->finished == stream->queued) && (stream->closing == 0)) {
+			pthread_cond_wait(&stream->submitted, &stream->lock);
+			
+		}
+		
+		if(stream->finished == stream->queued) {
+			break;
+			
+		}
+		
+		// The band stays out of the renderer's reach until it is marked finished
+		band = &stream->bands[stream->finished % stream->num_bands];
+		pthread_mutex_unlock(&stream->lock);
+		
+		count = (size_t)(band->width) * band->band_height;
+		if(fwrite(band->image_data, sizeof(Pixel), count, stream->fpointer) != count) {
+			stream->error = 1;
+			
+		}
+		
+		pthread_mutex_lock(&stream->lock);
+		stream->finished = stream->finished + 1;
+		pthread_cond_signal(&stream->written);
+		
+	}
+	
+	pthread_mutex_unlock(&stream->lock);
+	
+	return (NULL);
+	
+}
+
+
+/**
+ * Creates a P6 file and writes its header, then starts the thread that writes the bands out.
+ *
+ * @param filename - the image file
+ * @param width - width of the image in pixels
+ * @param height - height of the image in pixels
+ * @param max_color - maximum color value
+ * @param band_height - rows per band, the last band may have fewer
+ * @param num_bands - number of band buffers in the ring, at least 2 so rendering and writing overlap
+ * @returns the stream
+ */
+ImageStream* stream_open(char *filename, int width, int height, int max_color, int band_height, int num_bands) {
+	ImageStream *stream;
+	int index;
+	
+	if(band_height < 1) {
+		band_height = 1;
+		
+	}
+	
+	if(band_height > height) {
+		band_height = height;
+		
+	}
+	
+	if(num_bands < 2) {
+		num_bands = 2;
+		
+	}
+	
+	stream = (ImageStream *)malloc(sizeof(ImageStream));
+	if(stream == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	stream->fpointer = fopen(filename, "wb");
+	if(stream->fpointer == NULL) {
+		fprintf(stderr, "Error, unable to open file.\n");
+		exit(-1);
+		
+	}
+	
+	// Same header as write_p6_image
+	fprintf(stream->fpointer, "%s\n", "P6");
+	fprintf(stream->fpointer, "%d %d\n", width, height);
+	fprintf(stream->fpointer, "%d\n", max_color);
+	
+	stream->bands = (Image *)malloc(sizeof(Image) * num_bands);
+	if(stream->bands == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	for(index = 0; index < num_bands; index++) {
+		stream->bands[index].magic_number = "P6";
+		stream->bands[index].width = width;
+		stream->bands[index].height = height;
+		stream->bands[index].max_color = max_color;
+		stream->bands[index].band_start = 0;
+		stream->bands[index].band_height = 0;
+		stream->bands[index].band_left = 0;
+		stream->bands[index].band_width = width;
+		stream->bands[index].image_data = (Pixel *)malloc(sizeof(Pixel) * width * band_height);
+		
+		if(stream->bands[index].image_data == NULL) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
+			
+		}
+		
+	}
+	
+	stream->num_bands = num_bands;
+	stream->band_height = band_height;
+	stream->height = height;
+	stream->acquired = stream->queued = stream->finished = 0;
+	stream->next_row = 0;
+	stream->closing = 0;
+	stream->error = 0;
+	
+	pthread_mutex_init(&stream->lock, NULL);
+	pthread_cond_init(&stream->submitted, NULL);
+	pthread_cond_init(&stream->written, NULL);
+	
+	if(pthread_create(&stream->writer, NULL, stream_writer, stream) != 0) {
+		fprintf(stderr, "Error, unable to create writer thread.\n");
+		exit(-1);
+		
+	}
+	
+	return (stream);
+	
+}
+
+
+/**
+ * Hands out the buffer of the next band of rows, from the top of the image down. Blocks while
+ * every buffer of the ring is waiting to be written out.
+ *
+ * @param stream - the stream
+ * @returns image holding the band, its band_start and band_height give its rows, NULL once
+ *          every row has been handed out
+ */
+Image* stream_acquire(ImageStream *stream) {
+	Image *band;
+	
+	if(stream->next_row >= stream->height) {
+		return (NULL);
+		
+	}
+	
+	pthread_mutex_lock(&stream->lock);
+	while(stream->acquired - stream->finished >= stream->num_bands) {
+		pthread_cond_wait(&stream->written, &stream->lock);
+		
+	}
+	
+	band = &stream->bands[stream->acquired % stream->num_bands];
+	stream->acquired = stream->acquired + 1;
+	pthread_mutex_unlock(&stream->lock);
+	
+	band->band_start = stream->next_row;
+	band->band_height = stream->band_height;
+	if(band->band_start + band->band_height > stream->height) {
+		band->band_height = stream->height - band->band_start;
+		
+	}
+	
+	stream->next_row = stream->next_row + band->band_height;
+	
+	return (band);
+	
+}
+
+
+/**
+ * Queues a rendered band to be written out. Bands must be submitted in the order they were
+ * acquired.
+ *
+ * @param stream - the stream
+ * @param band - the band, as returned by stream_acquire
+ */
+void stream_submit(ImageStream *stream, Image *band) {
+	pthread_mutex_lock(&stream->lock);
+	stream->queued = stream->queued + 1;
+	pthread_cond_signal(&stream->submitted);
+	pthread_mutex_unlock(&stream->lock);
+	
+}
+
+
+/**
+ * Waits for the submitted bands to be written out, closes the file and frees the stream.
+ *
+ * @param stream - the stream
+ */
+void stream_close(ImageStream *stream) {
+	int index, error;
+	
+	pthread_mutex_lock(&stream->lock);
+	stream->closing = 1;
+	pthread_cond_signal(&stream->submitted);
+	pthread_mutex_unlock(&stream->lock);
+	
+	pthread_join(stream->writer, NULL);
+	
+	// Close file stream flush all buffers
+	error = stream->error | (fclose(stream->fpointer) != 0);
+	
+	for(index = 0; index < stream->num_bands; index++) {
+		free(stream->bands[index].image_data);
+		
+	}
+	
+	pthread_mutex_destroy(&stream->lock);
+	pthread_cond_destroy(&stream->submitted);
+	pthread_cond_destroy(&stream->written);
+	free(stream->bands);
+	free(stream);
+	
+	if(error != 0) {
+		fprintf(stderr, "Error, unable to write file.\n");
+		exit(-1);
+		
+	}
+	
+}
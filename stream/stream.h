@@ -0,0 +1,48 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: stream.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef stream_h
+	#define stream_h
+	
+	#include <pthread.h>
+	
+	// Bands in the ring, one being written out while the next renders and one to spare
+	#define STREAM_BANDS 3
+	
+	/**
+	 * A P6 image written out band by band while it renders, so no more than num_bands bands
+	 * of band_height rows are ever held in memory, whatever the height of the image. The
+	 * renderer takes the bands in order from a ring of buffers, a writer thread writes each
+	 * one out once it is submitted and hands its buffer back to the ring.
+	 */
+	typedef struct ImageStream {
+		FILE *fpointer;
+		Image *bands;
+		int num_bands;
+		int band_height;
+		int height;
+		
+		pthread_t writer;
+		pthread_mutex_t lock;
+		pthread_cond_t submitted;		//<= signalled when a band is submitted or the stream closes
+		pthread_cond_t written;			//<= signalled when a band has been written out
+		
+		int acquired, queued, finished;	//<= bands handed out, submitted and written so far
+		int next_row;					//<= first row of the next band handed out
+		int closing;
+		int error;
+		
+	} ImageStream;
+	
+	// function declarations
+	ImageStream* stream_open(char *filename, int width, int height, int max_color, int band_height, int num_bands);
+	Image* stream_acquire(ImageStream *stream);
+	void stream_submit(ImageStream *stream, Image *band);
+	void stream_close(ImageStream *stream);
+	
+#endif
@@ -0,0 +1,313 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: threadpool.c
+ * Copyright © 2016 All rights reserved 
+ */
+ 
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "threadpool.h"
+
+/**
+ * Arguments handed to each worker thread on creation.
+ */
+typedef struct Worker {
+	ThreadPool *pool;
+	int id;
+	
+} Worker;
+
+
+/**
+ * Queries the operating system for the number of online processors.
+ *
+ * @returns number of processors, 1 if the value could not be determined
+ */
+int threadpool_cpu_count(void) {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	if(count < 1) {
+		return (1);
+		
+	}
+	
+	return ((int)count);
+	
+}
+
+
+/**
+ * Removes the next task from the head of a worker's own queue.
+ *
+ * @param queue - the queue owned by the calling worker
+ * @returns task index, -1 if the queue is empty
+ */
+static int queue_pop(WorkQueue *queue) {
+	int task = -1;
+	
+	pthread_mutex_lock(&queue->lock);
+	if(queue->head < queue->tail) {
+		task = queue->tasks[queue->head];
+		queue->head = queue->head + 1;
+		
+	}
+	pthread_mutex_unlock(&queue->lock);
+	
+	return task;
+	
+}
+
+
+/**
+ * Removes a task from the tail of another worker's queue.
+ *
+ * @param queue - the queue to steal from
+ * @returns task index, -1 if the queue is empty
+ */
+static int queue_steal(WorkQueue *queue) {
+	int task = -1;
+	
+	pthread_mutex_lock(&queue->lock);
+	if(queue->head < queue->tail) {
+		queue->tail = queue->tail - 1;
+		task = queue->tasks[queue->tail];
+		
+	}
+	pthread_mutex_unlock(&queue->lock);
+	
+	return task;
+	
+}
+
+
+/**
+ * Main loop of a worker thread. Waits for a new batch, drains its own queue, then steals
+ * from the other workers until every queue is empty.
+ *
+ * @param argument - pointer to the Worker structure of this thread
+ * @returns NULL
+ */
+static void *worker_main(void *argument) {
+	Worker *worker = (Worker *)argument;
+	ThreadPool *pool = worker->pool;
+	int generation = 0;
+	int task, index, victim;
+	
+	while(1) {
+		// Sleep until a new batch is published or the pool is shut down
+		pthread_mutex_lock(&pool->lock);
+		while((pool->shutdown == 0) && (pool->generation == generation)) {
+			pthread_cond_wait(&pool->start, &pool->lock);
+			
+		}
+		if(pool->shutdown != 0) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+			
+		}
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+		
+		while(1) {
+			task = queue_pop(&pool->queues[worker->id]);
+			
+			// Own queue is drained, try to steal from the other workers
+			for(index = 1; (task == -1) && (index < pool->num_threads); index++) {
+				victim = (worker->id + index) % pool->num_threads;
+				task = queue_steal(&pool->queues[victim]);
+				
+			}
+			
+			if(task == -1) {
+				break;	// <= no work left anywhere
+				
+			}
+			
+			pool->function(pool->context, task, worker->id);
+			
+		}
+		
+		// Report completion of this batch
+		pthread_mutex_lock(&pool->lock);
+		pool->active = pool->active - 1;
+		if(pool->active == 0) {
+			pthread_cond_signal(&pool->done);
+			
+		}
+		pthread_mutex_unlock(&pool->lock);
+		
+	}
+	
+	free(worker);
+	return (NULL);
+	
+}
+
+
+/**
+ * Creates a pool of persistent worker threads each owning a work queue.
+ *
+ * @param num_threads - number of workers, values below 1 use the number of processors
+ * @returns pointer to the new pool
+ */
+ThreadPool* threadpool_create(int num_threads) {
+	ThreadPool *pool;
+	Worker *worker;
+	int index;
+	
+	if(num_threads < 1) {
+		num_threads = threadpool_cpu_count();
+		
+	}
+	
+	pool = (ThreadPool *)calloc(1, sizeof(ThreadPool));
+	if(pool == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	pool->num_threads = num_threads;
+	pool->threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+	pool->queues = (WorkQueue *)calloc(num_threads, sizeof(WorkQueue));
+	if((pool->threads == NULL) || (pool->queues == NULL)) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	
+	for(index = 0; index < num_threads; index++) {
+		pthread_mutex_init(&pool->queues[index].lock, NULL);
+		
+		worker = (Worker *)malloc(sizeof(Worker));
+		if(worker == NULL) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			exit(-1);
+			
+		}
+		worker->pool = pool;
+		worker->id = index;
+		
+		if(pthread_create(&pool->threads[index], NULL, worker_main, worker) != 0) {
+			fprintf(stderr, "Error, failed to create worker thread.\n");
+			exit(-1);
+			
+		}
+		
+	}
+	
+	return pool;
+	
+}
+
+
+/**
+ * Executes num_tasks calls of function across the pool and blocks until all have completed.
+ * Tasks are dealt out to the worker queues in contiguous blocks so each worker starts on a
+ * coherent region, idle workers then steal from the end of the busiest queues.
+ *
+ * @param pool - the thread pool
+ * @param function - function executed once per task
+ * @param context - pointer passed through to every call of function
+ * @param num_tasks - number of tasks, numbered 0 .. num_tasks - 1
+ */
+void threadpool_run(ThreadPool *pool, task_function function, void *context, int num_tasks) {
+	int index, task, first, last;
+	
+	if(num_tasks <= 0) {
+		return;
+		
+	}
+	
+	pthread_mutex_lock(&pool->lock);
+	
+	// Grow the queues so that any single queue can hold the whole batch
+	if(num_tasks > pool->capacity) {
+		for(index = 0; index < pool->num_threads; index++) {
+			free(pool->queues[index].tasks);
+			pool->queues[index].tasks = (int *)malloc(sizeof(int) * num_tasks);
+			if(pool->queues[index].tasks == NULL) {
+				fprintf(stderr, "Failed to allocate memory.\n");
+				exit(-1);
+				
+			}
+			
+		}
+		pool->capacity = num_tasks;
+		
+	}
+	
+	// Deal tasks out in contiguous blocks
+	for(index = 0; index < pool->num_threads; index++) {
+		first = (int)(((long long)num_tasks * index) / pool->num_threads);
+		last = (int)(((long long)num_tasks * (index + 1)) / pool->num_threads);
+		
+		pool->queues[index].head = 0;
+		pool->queues[index].tail = 0;
+		for(task = first; task < last; task++) {
+			pool->queues[index].tasks[pool->queues[index].tail] = task;
+			pool->queues[index].tail = pool->queues[index].tail + 1;
+			
+		}
+		
+	}
+	
+	// Publish the batch and wake up the workers
+	pool->function = function;
+	pool->context = context;
+	pool->active = pool->num_threads;
+	pool->generation = pool->generation + 1;
+	pthread_cond_broadcast(&pool->start);
+	
+	while(pool->active > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+		
+	}
+	
+	pthread_mutex_unlock(&pool->lock);
+	
+}
+
+
+/**
+ * Stops all workers, joins their threads and releases the pool.
+ *
+ * @param pool - the thread pool
+ */
+void threadpool_destroy(ThreadPool *pool) {
+	int index;
+	
+	if(pool == NULL) {
+		return;
+		
+	}
+	
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	
+	for(index = 0; index < pool->num_threads; index++) {
+		pthread_join(pool->threads[index], NULL);
+		pthread_mutex_destroy(&pool->queues[index].lock);
+		free(pool->queues[index].tasks);
+		
+	}
+	
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	
+	free(pool->queues);
+	free(pool->threads);
+	free(pool);
+	
+}
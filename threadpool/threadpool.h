@@ -0,0 +1,61 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: threadpool.h
+ * Copyright © 2016 All rights reserved 
+ */
+ 
+#ifndef threadpool_h
+	#define threadpool_h
+	
+	#include <pthread.h>
+
+	/**
+	 * Function signature of a unit of work executed by the pool. The task value is the index
+	 * of the work item, thread_id identifies the worker (0 .. num_threads - 1) so callers can
+	 * keep per-thread state without locking.
+	 */
+	typedef void (*task_function)(void *context, int task, int thread_id);
+
+	/**
+	 * Double ended work queue owned by a single worker. The owner pops tasks from the head
+	 * while idle workers steal from the tail, which keeps neighbouring tiles on the same thread
+	 * for as long as possible.
+	 */
+	typedef struct WorkQueue {
+		pthread_mutex_t lock;
+		int *tasks;
+		int head, tail;
+		
+	} WorkQueue;
+
+	/**
+	 * Persistent collection of worker threads. Workers sleep on the start condition between
+	 * batches so the pool can be reused across renders without respawning threads.
+	 */
+	typedef struct ThreadPool {
+		pthread_t *threads;
+		WorkQueue *queues;
+		int num_threads;
+		int capacity;
+		
+		pthread_mutex_t lock;
+		pthread_cond_t start;
+		pthread_cond_t done;
+		
+		task_function function;
+		void *context;
+		int generation;
+		int active;
+		int shutdown;
+		
+	} ThreadPool;
+
+	// function declarations
+	int threadpool_cpu_count(void);
+	ThreadPool* threadpool_create(int num_threads);
+	void threadpool_run(ThreadPool *pool, task_function function, void *context, int num_tasks);
+	void threadpool_destroy(ThreadPool *pool);
+ 
+#endif
@@ -0,0 +1,441 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: benchmark.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define MAX_LIST 16
+#define MAX_ARGUMENTS 32
+#define MAX_STATS 4096
+
+/**
+ * A scene of the suite, args are the scenegen options that produce it.
+ */
+typedef struct BenchScene {
+	char *name;
+	char *args;
+	
+} BenchScene;
+
+/**
+ * Measurements of one render. rays and render_ms are -1 when the renderer did not report them.
+ */
+typedef struct BenchResult {
+	double wall_ms;
+	double render_ms;
+	long long rays;
+	long peak_rss_kb;
+	
+} BenchResult;
+
+static BenchScene suite[] = {
+	{"grid64", "--spheres 64 --layout grid --lights 2 --planes 1 --seed 1"},
+	{"random120", "--spheres 120 --layout random --lights 3 --spots 1 --planes 2 --seed 2"},
+	{"lights8", "--spheres 32 --layout random --lights 8 --spots 2 --planes 3 --seed 3"},
+	{"mirrors", "--spheres 27 --layout grid --lights 1 --planes 6 --seed 4"},
+	{"random10k", "--spheres 10000 --layout random --lights 2 --planes 1 --seed 5"},
+	{"grid100k", "--spheres 100000 --layout grid --lights 2 --planes 1 --seed 6"}
+};
+
+/**
+ * Returns the wall clock time in seconds.
+ *
+ * @returns seconds since an arbitrary point in the past
+ */
+static double bench_clock(void) {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec + now.tv_nsec * 1e-9);
+	
+}
+
+
+/**
+ * Parses a comma separated list of non negative integers.
+ *
+ * @param text - the list, e.g. "256,512,1024"
+ * @param values - receives at most MAX_LIST values
+ * @returns number of values read
+ */
+static int parse_list(char *text, int *values) {
+	int count = 0;
+	char *end;
+	
+	while((*text != '\0') && (count < MAX_LIST)) {
+		values[count] = (int)strtol(text, &end, 10);
+		if((end == text) || (values[count] < 0)) {
+			fprintf(stderr, "Error, invalid list '%s'.\n", text);
+			exit(-1);
+			
+		}
+		
+		count++;
+		text = (*end == ',') ? end + 1 : end;
+		
+	}
+	
+	return count;
+	
+}
+
+
+/**
+ * Splits a string on spaces into an argument vector, the string is modified.
+ *
+ * @param text - the arguments
+ * @param argv - receives pointers into text
+ * @param start - index of argv the first argument is stored at
+ * @returns index after the last argument stored
+ */
+static int split_arguments(char *text, char **argv, int start) {
+	char *token;
+	
+	for(token = strtok(text, " "); (token != NULL) && (start < MAX_ARGUMENTS - 1); token = strtok(NULL, " ")) {
+		argv[start++] = token;
+		
+	}
+	
+	return start;
+	
+}
+
+
+/**
+ * Runs a program, optionally collecting its standard output, and waits for it.
+ *
+ * @param argv - program and arguments, NULL terminated
+ * @param output - receives the program's standard output, NULL to discard it
+ * @param size - size of output in bytes
+ * @param usage - receives the resource usage of the program
+ * @returns exit status of the program, -1 if it could not be run
+ */
+static int run_program(char **argv, char *output, int size, struct rusage *usage) {
+	int fds[2], status, length, count;
+	pid_t pid;
+	
+	if(pipe(fds) != 0) {
+		fprintf(stderr, "Error, unable to create a pipe.\n");
+		exit(-1);
+		
+	}
+	
+	pid = fork();
+	if(pid < 0) {
+		fprintf(stderr, "Error, unable to start '%s'.\n", argv[0]);
+		exit(-1);
+		
+	}
+	
+	if(pid == 0) {
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execv(argv[0], argv);
+		fprintf(stderr, "Error, unable to run '%s'.\n", argv[0]);
+		_exit(127);
+		
+	}
+	
+	close(fds[1]);
+	
+	// Keep the first size bytes, drain the rest so the program never blocks on a full pipe
+	length = 0;
+	while(1) {
+		char discard[4096];
+		
+		if((output != NULL) && (length < size - 1)) {
+			count = read(fds[0], output + length, size - 1 - length);
+			
+		} else {
+			count = read(fds[0], discard, sizeof(discard));
+			
+		}
+		
+		if(count <= 0) {
+			break;
+			
+		}
+		
+		if((output != NULL) && (length < size - 1)) {
+			length += count;
+			
+		}
+		
+	}
+	
+	if(output != NULL) {
+		output[length] = '\0';
+		
+	}
+	
+	close(fds[0]);
+	
+	if(wait4(pid, &status, 0, usage) < 0) {
+		return -1;
+		
+	}
+	
+	return (WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+	
+}
+
+
+/**
+ * Reads the --stats report the renderer wrote.
+ *
+ * @param path - the report
+ * @param text - receives the report, empty if it could not be read
+ * @param size - size of text in bytes
+ */
+static void read_stats(char *path, char *text, int size) {
+	FILE *file;
+	size_t length;
+	
+	text[0] = '\0';
+	file = fopen(path, "r");
+	if(file != NULL) {
+		length = fread(text, 1, size - 1, file);
+		text[length] = '\0';
+		fclose(file);
+		
+	}
+	
+}
+
+
+/**
+ * Returns the number following a key in the renderer's --stats report.
+ *
+ * @param stats - the report
+ * @param key - quoted key preceding the number, e.g. "\"render\": "
+ * @returns the number, -1 if the key is missing
+ */
+static double find_value(char *stats, char *key) {
+	char *found;
+	
+	found = strstr(stats, key);
+	return (found != NULL) ? atof(found + strlen(key)) : -1;
+	
+}
+
+
+/**
+ * Renders a scene once and measures it. The render time and the rays traced are taken from
+ * the renderer's --stats report, its standard output is discarded.
+ *
+ * @param renderer - path of the raytracer
+ * @param threads - value passed to --threads
+ * @param size - width and height of the image
+ * @param scene_path - the json scene
+ * @param image_path - output image
+ * @param result - receives the measurements
+ */
+static void run_render(char *renderer, int threads, int size, char *scene_path, char *image_path, BenchResult *result) {
+	char stats[MAX_STATS];
+	char threads_text[16], size_text[16];
+	char *counters[] = {"\"primary\": ", "\"reflection\": ", "\"refraction\": ", "\"shadow\": "};
+	double value;
+	int index;
+	char *argv[MAX_ARGUMENTS];
+	struct rusage usage;
+	double start;
+	
+	sprintf(threads_text, "%d", threads);
+	sprintf(size_text, "%d", size);
+	
+	argv[0] = renderer;
+	argv[1] = "--threads";
+	argv[2] = threads_text;
+	argv[3] = "--stats";
+	argv[4] = "bench_stats.json";
+	argv[5] = size_text;
+	argv[6] = size_text;
+	argv[7] = scene_path;
+	argv[8] = image_path;
+	argv[9] = NULL;
+	
+	remove("bench_stats.json");
+	
+	start = bench_clock();
+	if(run_program(argv, NULL, 0, &usage) != 0) {
+		fprintf(stderr, "Error, '%s' failed on %s.\n", renderer, scene_path);
+		exit(-1);
+		
+	}
+	
+	result->wall_ms = (bench_clock() - start) * 1000.0;
+	result->peak_rss_kb = usage.ru_maxrss;
+	
+	read_stats("bench_stats.json", stats, sizeof(stats));
+	result->render_ms = find_value(stats, "\"render\": ");
+	
+	// Every ray the renderer shot: view, reflected, refracted and shadow rays
+	result->rays = 0;
+	for(index = 0; index < (int)(sizeof(counters) / sizeof(counters[0])); index++) {
+		value = find_value(stats, counters[index]);
+		if(value < 0) {
+			result->rays = -1;
+			break;
+			
+		}
+		
+		result->rays += (long long)value;
+		
+	}
+	
+}
+
+
+/**
+ * Generates the scenes of the suite, renders each at every size and thread count and prints
+ * one tab separated row per render: wall and render time, rays traced per second of render
+ * time and peak memory.
+ *
+ * Usage: benchmark [--renderer path] [--scenegen path] [--threads list] [--sizes list]
+ *        [--runs n] [--quick] [--keep] [--output file]
+ *
+ * @param argc - number of arguments
+ * @param argv - the arguments
+ * @returns 0 on success
+ */
+int main(int argc, char *argv[]) {
+	char *renderer = "./raytrace";
+	char *scenegen = "./scenegen";
+	char *output_path = NULL;
+	char *generate[MAX_ARGUMENTS];
+	char scene_path[64], args[256];
+	int threads[MAX_LIST], sizes[MAX_LIST];
+	int num_threads, num_sizes, runs, keep, index, scene, thread, size, run, processors, count;
+	BenchResult result, best;
+	struct rusage usage;
+	FILE *table;
+	
+	num_threads = parse_list("1,0", threads);
+	num_sizes = parse_list("256,512,1024", sizes);
+	runs = 1;
+	keep = 0;
+	
+	for(index = 1; index < argc; index++) {
+		if((strcmp(argv[index], "--renderer") == 0) && (index + 1 < argc)) {
+			renderer = argv[++index];
+			
+		} else if((strcmp(argv[index], "--scenegen") == 0) && (index + 1 < argc)) {
+			scenegen = argv[++index];
+			
+		} else if((strcmp(argv[index], "--threads") == 0) && (index + 1 < argc)) {
+			num_threads = parse_list(argv[++index], threads);
+			
+		} else if((strcmp(argv[index], "--sizes") == 0) && (index + 1 < argc)) {
+			num_sizes = parse_list(argv[++index], sizes);
+			
+		} else if((strcmp(argv[index], "--runs") == 0) && (index + 1 < argc)) {
+			runs = atoi(argv[++index]);
+			
+		} else if(strcmp(argv[index], "--quick") == 0) {
+			num_sizes = parse_list("128,256", sizes);
+			
+		} else if(strcmp(argv[index], "--keep") == 0) {
+			keep = 1;
+			
+		} else if((strcmp(argv[index], "--output") == 0) && (index + 1 < argc)) {
+			output_path = argv[++index];
+			
+		} else {
+			fprintf(stderr, "Error, incorrect usage!\nCorrect usage pattern is: benchmark [--renderer path] [--scenegen path] [--threads list] [--sizes list] [--runs n] [--quick] [--keep] [--output file].\n");
+			exit(-1);
+			
+		}
+		
+	}
+	
+	if((runs < 1) || (num_threads == 0) || (num_sizes == 0)) {
+		fprintf(stderr, "Error, --runs, --threads and --sizes need at least one value.\n");
+		exit(-1);
+		
+	}
+	
+	table = stdout;
+	if(output_path != NULL) {
+		table = fopen(output_path, "w");
+		if(table == NULL) {
+			fprintf(stderr, "Error, could not open file '%s'.\n", output_path);
+			exit(-1);
+			
+		}
+		
+	}
+	
+	processors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	fprintf(table, "scene\tthreads\twidth\theight\twall_ms\trender_ms\trays\trays_per_sec\tpeak_rss_kb\n");
+	
+	for(scene = 0; scene < (int)(sizeof(suite) / sizeof(suite[0])); scene++) {
+		sprintf(scene_path, "bench_%s.json", suite[scene].name);
+		strcpy(args, suite[scene].args);
+		
+		generate[0] = scenegen;
+		count = split_arguments(args, generate, 1);
+		generate[count++] = scene_path;
+		generate[count] = NULL;
+		
+		if(run_program(generate, NULL, 0, &usage) != 0) {
+			fprintf(stderr, "Error, '%s' failed to generate %s.\n", scenegen, scene_path);
+			exit(-1);
+			
+		}
+		
+		for(thread = 0; thread < num_threads; thread++) {
+			for(size = 0; size < num_sizes; size++) {
+				// Keep the fastest run, it is the one least disturbed by the rest of the system
+				for(run = 0; run < runs; run++) {
+					run_render(renderer, threads[thread], sizes[size], scene_path, "bench_output.ppm", &result);
+					if((run == 0) || (result.wall_ms < best.wall_ms)) {
+						best = result;
+						
+					}
+					
+				}
+				
+				fprintf(table, "%s\t%d\t%d\t%d\t%.3f\t%.3f\t%lld\t%.0f\t%ld\n", suite[scene].name,
+					(threads[thread] == 0) ? processors : threads[thread], sizes[size], sizes[size],
+					best.wall_ms, best.render_ms, best.rays,
+					((best.rays > 0) && (best.render_ms > 0)) ? best.rays / (best.render_ms / 1000.0) : -1.0, best.peak_rss_kb);
+				fflush(table);
+				
+			}
+			
+		}
+		
+		if(keep == 0) {
+			remove(scene_path);
+			
+		}
+		
+	}
+	
+	if(keep == 0) {
+		remove("bench_output.ppm");
+		
+	}
+	
+	remove("bench_stats.json");
+	
+	if(table != stdout) {
+		fclose(table);
+		
+	}
+	
+	return 0;
+	
+}
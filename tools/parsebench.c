@@ -0,0 +1,249 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: parsebench.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "..\arena\arena.h"
+#include "..\threadpool\threadpool.h"
+#include "..\json\json.h"
+#include "..\filemap\filemap.h"
+
+// Parsers compared, the stream parser is the reference
+#define PARSERS 3
+
+/**
+ * Returns a monotonic wall clock reading in seconds.
+ *
+ * @returns seconds since an arbitrary fixed point
+ */
+static double parse_clock(void) {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec + now.tv_nsec * 1e-9);
+	
+}
+
+
+/**
+ * Parses a scene with the stream parser, json_read_scene.
+ *
+ * @param path - the scene file
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @returns the array of objects read in
+ */
+static Object *parse_stream(char *path, Arena *arena, int *num_objects) {
+	Object *objects;
+	FILE *fpointer;
+	
+	fpointer = fopen(path, "r");
+	if(fpointer == NULL) {
+		fprintf(stderr, "Error, could not open file.\n");
+		exit(-1);
+		
+	}
+	
+	objects = json_read_scene(fpointer, arena, num_objects);
+	fclose(fpointer);
+	
+	return (objects);
+	
+}
+
+
+/**
+ * Checks that two parses of a scene gave the same objects, down to every bit of every number.
+ *
+ * @param first - objects of one parse
+ * @param second - objects of the other parse
+ * @param num_objects - number of objects in each
+ * @returns index of the first object that differs, -1 if none does
+ */
+static int compare_scenes(Object *first, Object *second, int num_objects) {
+	int index;
+	
+	for(index = 0; index < num_objects; index++) {
+		if((first[index].type == NULL) != (second[index].type == NULL)) {
+			return (index);
+			
+		}
+		
+		if((first[index].type != NULL) && (strcmp(first[index].type, second[index].type) != 0)) {
+			return (index);
+			
+		}
+		
+		// Both parsers zero an object before filling it in, unused bytes compare equal
+		if(memcmp(&first[index].properties, &second[index].properties, sizeof(first[index].properties)) != 0) {
+			return (index);
+			
+		}
+		
+	}
+	
+	return (-1);
+	
+}
+
+
+/**
+ * Parses a scene with the mapped parser, split across a thread pool.
+ *
+ * @param path - the scene file
+ * @param arena - arena that receives the objects
+ * @param num_objects - receives the number of objects read in
+ * @param pool - worker threads
+ * @returns the array of objects read in
+ */
+static Object *parse_parallel(char *path, Arena *arena, int *num_objects, ThreadPool *pool) {
+	Object *objects;
+	size_t size;
+	char *data;
+	int mapped;
+	
+	data = map_file(path, &size, &mapped);
+	if(data == NULL) {
+		fprintf(stderr, "Error, could not open file.\n");
+		exit(-1);
+		
+	}
+	
+	objects = json_parse_scene_parallel(data, size, arena, num_objects, pool);
+	unmap_file(data, size, mapped);
+	
+	return (objects);
+	
+}
+
+
+/**
+ * Times the stream parser, the mapped parser and the parallel mapped parser on one scene and
+ * checks they all agree with the stream parser.
+ *
+ * Usage: parsebench [--runs N] [--threads N] scene.json
+ *
+ * @param argc - contains the number of arguments passed to the program
+ * @param argv - a pointer reference to the arguments passed to the program
+ * @returns 0 when the parsers agree, 1 otherwise
+ */
+int main(int argc, char *argv[]) {
+	static const char *names[PARSERS] = {"stream", "mapped", "parallel"};
+	int runs, run, index, parser, threads, mismatch, status;
+	int num_objects[PARSERS];
+	double times[PARSERS], start, megabytes;
+	Object *scenes[PARSERS];
+	Arena arenas[PARSERS];
+	ThreadPool *pool;
+	FILE *fpointer;
+	char *path;
+	
+	runs = 3;
+	threads = 0;
+	path = NULL;
+	
+	for(index = 1; index < argc; index++) {
+		if((strcmp(argv[index], "--runs") == 0) && (index + 1 < argc)) {
+			runs = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--threads") == 0) && (index + 1 < argc)) {
+			// 0 selects one thread per processor
+			threads = atoi(argv[++index]);
+			
+		} else if(path == NULL) {
+			path = argv[index];
+			
+		} else {
+			fprintf(stderr, "Error, unexpected argument '%s'.\n", argv[index]);
+			exit(-1);
+			
+		}
+		
+	}
+	
+	if((path == NULL) || (runs < 1)) {
+		fprintf(stderr, "Usage: parsebench [--runs N] [--threads N] scene.json\n");
+		exit(-1);
+		
+	}
+	
+	// Size of the scene for the throughput
+	fpointer = fopen(path, "rb");
+	if(fpointer == NULL) {
+		fprintf(stderr, "Error, could not open file.\n");
+		exit(-1);
+		
+	}
+	fseek(fpointer, 0, SEEK_END);
+	megabytes = ftell(fpointer) / (1024.0 * 1024.0);
+	fclose(fpointer);
+	
+	pool = threadpool_create(threads);
+	
+	// Best of the runs for each parser, the last parse of each is kept for the comparison
+	for(parser = 0; parser < PARSERS; parser++) {
+		arena_init(&arenas[parser]);
+		scenes[parser] = NULL;
+		
+		for(run = 0; run < runs; run++) {
+			arena_free(&arenas[parser]);
+			start = parse_clock();
+			
+			if(parser == 0) {
+				scenes[parser] = parse_stream(path, &arenas[parser], &num_objects[parser]);
+				
+			} else if(parser == 1) {
+				scenes[parser] = json_load_scene(path, &arenas[parser], &num_objects[parser]);
+				
+			} else {
+				scenes[parser] = parse_parallel(path, &arenas[parser], &num_objects[parser], pool);
+				
+			}
+			
+			start = parse_clock() - start;
+			times[parser] = ((run == 0) || (start < times[parser])) ? start : times[parser];
+			
+		}
+		
+	}
+	
+	printf("parser\tthreads\tobjects\tseconds\tmb_per_sec\tspeedup\n");
+	for(parser = 0; parser < PARSERS; parser++) {
+		printf("%s\t%d\t%d\t%.4f\t%.1f\t%.2fx\n", names[parser], (parser == 2) ? pool->num_threads : 1, num_objects[parser], times[parser], megabytes / times[parser], times[0] / times[parser]);
+		
+	}
+	
+	status = 0;
+	for(parser = 1; parser < PARSERS; parser++) {
+		if(num_objects[parser] != num_objects[0]) {
+			fprintf(stderr, "Error, %s parser read %d objects, stream parser %d.\n", names[parser], num_objects[parser], num_objects[0]);
+			status = 1;
+			
+		} else {
+			mismatch = compare_scenes(scenes[0], scenes[parser], num_objects[0]);
+			if(mismatch >= 0) {
+				fprintf(stderr, "Error, %s parser disagrees on object %d.\n", names[parser], mismatch);
+				status = 1;
+				
+			}
+			
+		}
+		
+	}
+	
+	for(parser = 0; parser < PARSERS; parser++) {
+		arena_free(&arenas[parser]);
+		
+	}
+	threadpool_destroy(pool);
+	
+	return (status);
+	
+}
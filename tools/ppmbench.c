@@ -0,0 +1,382 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: ppmbench.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "..\threadpool\threadpool.h"
+#include "..\ppm\ppm.h"
+
+// 8K UHD
+#define BENCH_WIDTH 7680
+#define BENCH_HEIGHT 4320
+
+/**
+ * Returns a monotonic wall clock reading in seconds.
+ *
+ * @returns seconds since an arbitrary fixed point
+ */
+static double ppm_clock(void) {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec + now.tv_nsec * 1e-9);
+	
+}
+
+
+/**
+ * Returns the size of a file in megabytes.
+ *
+ * @param path - the file
+ * @returns size of the file
+ */
+static double file_megabytes(char *path) {
+	FILE *fpointer;
+	double megabytes;
+	
+	fpointer = fopen(path, "rb");
+	if(fpointer == NULL) {
+		fprintf(stderr, "Error, could not open file.\n");
+		exit(-1);
+		
+	}
+	
+	fseek(fpointer, 0, SEEK_END);
+	megabytes = ftell(fpointer) / (1024.0 * 1024.0);
+	fclose(fpointer);
+	
+	return (megabytes);
+	
+}
+
+
+/**
+ * Fills an image with gradients and noise, so channel values of one, two and three digits all
+ * show up in the ascii format.
+ *
+ * @param image - image with its size set, receives the pixels
+ */
+static void fill_image(Image *image) {
+	unsigned int hash;
+	int row, column;
+	Pixel *pixel;
+	
+	image->magic_number = "P6";
+	image->max_color = 255;
+	image->band_start = 0;
+	image->band_height = image->height;
+	image->band_left = 0;
+	image->band_width = image->width;
+	image->image_data = (Pixel *)malloc(sizeof(Pixel) * image->width * image->height);
+	if(image->image_data == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	for(row = 0; row < image->height; row++) {
+		for(column = 0; column < image->width; column++) {
+			hash = (unsigned int)row * 73856093u ^ (unsigned int)column * 19349663u;
+			hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+			
+			pixel = image_pixel(image, row, column);
+			pixel->red = (255 * column) / image->width;
+			pixel->green = (255 * row) / image->height;
+			pixel->blue = (hash >> 24) & 255;
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Writes a P3 image the way the renderer used to, formatting each channel with sprintf and
+ * writing it with fprintf. The reference the table driven writer is measured against.
+ *
+ * @param filename - the image file
+ * @param image - the image
+ */
+static void stdio_write_p3(char *filename, Image *image) {
+	char buffer[64];
+	size_t index;
+	FILE *fpointer;
+	
+	fpointer = fopen(filename, "w");
+	if(fpointer == NULL) {
+		fprintf(stderr, "Error, unable to open file.\n");
+		exit(-1);
+		
+	}
+	
+	fprintf(fpointer, "%s\n", "P3");
+	fprintf(fpointer, "%d %d\n", image->width, image->height);
+	fprintf(fpointer, "%d\n", image->max_color);
+	
+	for(index = 0; index < (size_t)(image->width) * image->height; index++) {
+		sprintf(buffer, "%d", image->image_data[index].red);
+		fprintf(fpointer, "%s\n", buffer);
+		
+		sprintf(buffer, "%d", image->image_data[index].green);
+		fprintf(fpointer, "%s\n", buffer);
+		
+		sprintf(buffer, "%d", image->image_data[index].blue);
+		fprintf(fpointer, "%s\n", buffer);
+		
+	}
+	
+	fclose(fpointer);
+	
+}
+
+
+/**
+ * Reads an image the way the renderer used to, fread for P6 and three calls to fscanf per
+ * pixel for P3. Only handles the headers written by this benchmark.
+ *
+ * @param filename - the image file
+ * @param image - receives the image
+ */
+static void stdio_read_image(char *filename, Image *image) {
+	char magic[3];
+	int red, green, blue;
+	size_t index;
+	FILE *fpointer;
+	
+	fpointer = fopen(filename, "r");
+	if(fpointer == NULL) {
+		fprintf(stderr, "Error, unable to open file.\n");
+		exit(-1);
+		
+	}
+	
+	if(fscanf(fpointer, "%2s %d %d %d", magic, &image->width, &image->height, &image->max_color) != 4) {
+		fprintf(stderr, "Error, invalid header.\n");
+		exit(-1);
+		
+	}
+	
+	image->band_start = 0;
+	image->band_height = image->height;
+	image->band_left = 0;
+	image->band_width = image->width;
+	image->image_data = (Pixel *)malloc(sizeof(Pixel) * image->width * image->height);
+	if(image->image_data == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	if(magic[1] == '6') {
+		fgetc(fpointer);
+		fread(image->image_data, sizeof(Pixel), (size_t)(image->width) * image->height, fpointer);
+		
+	} else {
+		for(index = 0; index < (size_t)(image->width) * image->height; index++) {
+			fscanf(fpointer, "%d", &red);
+			fscanf(fpointer, "%d", &green);
+			fscanf(fpointer, "%d", &blue);
+			
+			image->image_data[index].red = red;
+			image->image_data[index].green = green;
+			image->image_data[index].blue = blue;
+			
+		}
+		
+	}
+	
+	fclose(fpointer);
+	
+}
+
+
+/**
+ * Checks that an image read back holds the pixels that were written.
+ *
+ * @param expected - the image written
+ * @param actual - the image read back
+ * @returns 1 if they are the same, 0 otherwise
+ */
+static int same_image(Image *expected, Image *actual) {
+	if((expected->width != actual->width) || (expected->height != actual->height)) {
+		return (0);
+		
+	}
+	
+	return (memcmp(expected->image_data, actual->image_data, sizeof(Pixel) * expected->width * expected->height) == 0);
+	
+}
+
+
+/**
+ * Times writing and reading an 8K image in the P6 and P3 formats, with the table driven
+ * writer and mapped reader of ppm.c and with the stdio versions they replaced, and checks every
+ * image read back matches the one written. Then times the PNG writer on one thread and on a
+ * pool of threads.
+ *
+ * Usage: ppmbench [--runs N] [--size WIDTHxHEIGHT] [--threads N] [--keep]
+ *
+ * @param argc - contains the number of arguments passed to the program
+ * @param argv - a pointer reference to the arguments passed to the program
+ * @returns 0 when every image read back matches, 1 otherwise
+ */
+int main(int argc, char *argv[]) {
+	static char *paths[3] = {"ppm_bench_p6.ppm", "ppm_bench_p3.ppm", "ppm_bench.png"};
+	static char *formats[2] = {"P6", "P3"};
+	static char *operations[2] = {"write", "read"};
+	static char *methods[2] = {"stdio", "buffered"};
+	double times[2][2][2], png_times[2], start, elapsed, megabytes;
+	int runs, run, index, keep, format, operation, method, status, threads;
+	ThreadPool *pool;
+	Image image, copy;
+	
+	runs = 3;
+	keep = 0;
+	threads = 0;
+	image.width = BENCH_WIDTH;
+	image.height = BENCH_HEIGHT;
+	
+	for(index = 1; index < argc; index++) {
+		if((strcmp(argv[index], "--runs") == 0) && (index + 1 < argc)) {
+			runs = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--size") == 0) && (index + 1 < argc)) {
+			if(sscanf(argv[++index], "%dx%d", &image.width, &image.height) != 2) {
+				image.width = 0;
+				
+			}
+			
+		} else if((strcmp(argv[index], "--threads") == 0) && (index + 1 < argc)) {
+			// 0 selects one thread per processor
+			threads = atoi(argv[++index]);
+			
+		} else if(strcmp(argv[index], "--keep") == 0) {
+			keep = 1;
+			
+		} else {
+			fprintf(stderr, "Error, unexpected argument '%s'.\n", argv[index]);
+			exit(-1);
+			
+		}
+		
+	}
+	
+	if((runs < 1) || (image.width < 1) || (image.height < 1)) {
+		fprintf(stderr, "Usage: ppmbench [--runs N] [--size WIDTHxHEIGHT] [--threads N] [--keep]\n");
+		exit(-1);
+		
+	}
+	
+	fill_image(&image);
+	status = 0;
+	
+	// Best of the runs for every format, operation and method
+	for(format = 0; format < 2; format++) {
+		for(method = 0; method < 2; method++) {
+			for(run = 0; run < runs; run++) {
+				start = ppm_clock();
+				if(format == 0) {
+					// A P6 image is written with one fwrite either way, it is timed once
+					if(method == 0) {
+						write_p6_image(paths[format], &image);
+						
+					}
+					
+				} else if(method == 0) {
+					stdio_write_p3(paths[format], &image);
+					
+				} else {
+					write_p3_image(paths[format], &image);
+					
+				}
+				elapsed = ppm_clock() - start;
+				times[format][0][method] = ((run == 0) || (elapsed < times[format][0][method])) ? elapsed : times[format][0][method];
+				
+				if((format == 0) && (method == 1)) {
+					times[format][0][method] = times[format][0][0];
+					
+				}
+				
+				start = ppm_clock();
+				if(method == 0) {
+					stdio_read_image(paths[format], &copy);
+					
+				} else {
+					read_image(paths[format], &copy);
+					
+				}
+				elapsed = ppm_clock() - start;
+				times[format][1][method] = ((run == 0) || (elapsed < times[format][1][method])) ? elapsed : times[format][1][method];
+				
+				if(same_image(&image, &copy) == 0) {
+					fprintf(stderr, "Error, %s %s reader read back a different image.\n", methods[method], formats[format]);
+					status = 1;
+					
+				}
+				free(copy.image_data);
+				
+			}
+			
+		}
+		
+	}
+	
+	// PNG on the calling thread, then on the pool
+	pool = threadpool_create(threads);
+	for(method = 0; method < 2; method++) {
+		for(run = 0; run < runs; run++) {
+			start = ppm_clock();
+			write_png_image(paths[2], &image, (method == 0) ? NULL : pool);
+			elapsed = ppm_clock() - start;
+			png_times[method] = ((run == 0) || (elapsed < png_times[method])) ? elapsed : png_times[method];
+			
+		}
+		
+	}
+	
+	printf("format\toperation\tmethod\tseconds\tmb_per_sec\tspeedup\n");
+	for(format = 0; format < 2; format++) {
+		megabytes = file_megabytes(paths[format]);
+		
+		for(operation = 0; operation < 2; operation++) {
+			for(method = 0; method < 2; method++) {
+				printf("%s\t%s\t%s\t%.4f\t%.1f\t%.2fx\n", formats[format], operations[operation], methods[method], times[format][operation][method], megabytes / times[format][operation][method], times[format][operation][0] / times[format][operation][method]);
+				
+			}
+			
+		}
+		
+		if(keep == 0) {
+			remove(paths[format]);
+			
+		}
+		
+	}
+	
+	// PNG throughput is measured on the raw pixels, the size of the file depends on the image
+	megabytes = sizeof(Pixel) * image.width * image.height / (1024.0 * 1024.0);
+	for(method = 0; method < 2; method++) {
+		printf("PNG\twrite\t%d thread%s\t%.4f\t%.1f\t%.2fx\n", (method == 0) ? 1 : pool->num_threads, ((method == 0) || (pool->num_threads == 1)) ? "" : "s", png_times[method], megabytes / png_times[method], png_times[0] / png_times[method]);
+		
+	}
+	printf("PNG size: %.1f MB\n", file_megabytes(paths[2]));
+	
+	if(keep == 0) {
+		remove(paths[2]);
+		
+	}
+	
+	threadpool_destroy(pool);
+	free(image.image_data);
+	
+	return (status);
+	
+}
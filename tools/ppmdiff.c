@@ -0,0 +1,118 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: ppmdiff.c
+ * Copyright © 2016 All rights reserved 
+ */
+ 
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "..\ppm\ppm.h"
+
+/**
+ * Compares two ppm images of the same size, typically the output of the double and single
+ * precision builds of the raytracer, and reports how far apart they are.
+ *
+ * Usage: ppmdiff image_a.ppm image_b.ppm [tolerance]
+ *
+ * With a tolerance the exit status is 1 when any channel differs by more than the tolerance,
+ * otherwise 0.
+ */
+int main(int argc, char *argv[]) {
+	Image image_a, image_b;
+	Pixel *pixel_a, *pixel_b;
+	size_t index;
+	int channel, difference, max_difference, differing, tolerance, changed;
+	int channels_a[3], channels_b[3];
+	double total, squared, mean, psnr;
+	
+	if((argc != 3) && (argc != 4)) {
+		fprintf(stderr, "Error, incorrect usage.\nCorrect usage pattern is: ppmdiff image_a.ppm image_b.ppm [tolerance].\n");
+		exit(-1);
+		
+	}
+	
+	tolerance = -1;
+	if(argc == 4) {
+		tolerance = atoi(argv[3]);
+		
+	}
+	
+	read_image(argv[1], &image_a);
+	read_image(argv[2], &image_b);
+	
+	if((image_a.width != image_b.width) || (image_a.height != image_b.height)) {
+		fprintf(stderr, "Error, images are %dx%d and %dx%d.\n", image_a.width, image_a.height, image_b.width, image_b.height);
+		exit(-1);
+		
+	}
+	
+	max_difference = 0;
+	differing = 0;
+	total = 0;
+	squared = 0;
+	
+	for(index = 0; index < ((size_t)(image_a.width) * image_a.height); index++) {
+		pixel_a = &image_a.image_data[index];
+		pixel_b = &image_b.image_data[index];
+		
+		channels_a[0] = pixel_a->red;
+		channels_a[1] = pixel_a->green;
+		channels_a[2] = pixel_a->blue;
+		channels_b[0] = pixel_b->red;
+		channels_b[1] = pixel_b->green;
+		channels_b[2] = pixel_b->blue;
+		
+		changed = 0;
+		for(channel = 0; channel < 3; channel++) {
+			difference = abs(channels_a[channel] - channels_b[channel]);
+			
+			if(difference > max_difference) {
+				max_difference = difference;
+				
+			}
+			
+			if(difference != 0) {
+				changed = 1;
+				
+			}
+			
+			total += difference;
+			squared += (double)difference * difference;
+			
+		}
+		
+		differing += changed;
+		
+	}
+	
+	mean = total / (3.0 * image_a.width * image_a.height);
+	squared = squared / (3.0 * image_a.width * image_a.height);
+	
+	printf("Size: %dx%d\n", image_a.width, image_a.height);
+	printf("Max difference: %d\n", max_difference);
+	printf("Mean difference: %lf\n", mean);
+	printf("Differing pixels: %d (%lf%%)\n", differing, (100.0 * differing) / (image_a.width * image_a.height));
+	
+	if(squared == 0) {
+		printf("PSNR: identical\n");
+		
+	} else {
+		psnr = 10.0 * log10((255.0 * 255.0) / squared);
+		printf("PSNR: %lf dB\n", psnr);
+		
+	}
+	
+	free(image_a.image_data);
+	free(image_b.image_data);
+	
+	if((tolerance >= 0) && (max_difference > tolerance)) {
+		return (1);
+		
+	}
+	
+	return (0);
+	
+}
@@ -0,0 +1,174 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: rtclient.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Longest line the server sends
+#define CLIENT_LINE 4096
+
+/**
+ * Connects to a render server.
+ *
+ * @param path - path of the server's socket
+ * @returns the connected socket, exits the program if there is no server
+ */
+static int client_connect(const char *path) {
+	struct sockaddr_un address;
+	int fd;
+	
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+	
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if((fd < 0) || (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)) {
+		fprintf(stderr, "Error, could not connect to '%s'.\n", path);
+		exit(-1);
+		
+	}
+	
+	return (fd);
+	
+}
+
+
+/**
+ * Reads a whole file into memory.
+ *
+ * @param path - the file
+ * @param size - receives the size of the file
+ * @returns the contents, exits the program if the file can not be read
+ */
+static char *client_read_file(const char *path, size_t *size) {
+	FILE *fpointer;
+	char *data;
+	long length;
+	
+	fpointer = fopen(path, "rb");
+	if((fpointer == NULL) || (fseek(fpointer, 0, SEEK_END) != 0) || ((length = ftell(fpointer)) < 0)) {
+		fprintf(stderr, "Error, could not open file '%s'.\n", path);
+		exit(-1);
+		
+	}
+	rewind(fpointer);
+	
+	data = (char *)malloc(length + 1);
+	if((data == NULL) || (fread(data, 1, length, fpointer) != (size_t)length)) {
+		fprintf(stderr, "Error, could not read file '%s'.\n", path);
+		exit(-1);
+		
+	}
+	
+	fclose(fpointer);
+	*size = length;
+	return (data);
+	
+}
+
+
+/**
+ * Sends one render job to a raytrace --serve process and prints everything it answers: the
+ * status of each stage, the statistics of the render and the final done or error line.
+ *
+ * Usage: rtclient [--inline] socket width height scene.json output.ppm
+ *        rtclient --shutdown socket
+ *
+ * --inline sends the scene itself instead of its path, so the server need not be able to
+ * read it. The exit status is 0 once the image is written and 1 on errors.
+ */
+int main(int argc, char *argv[]) {
+	char line[CLIENT_LINE], *data;
+	size_t size, length;
+	int fd, index, send_inline, status;
+	FILE *in, *out;
+	
+	send_inline = 0;
+	
+	// A server that has hung up must end in exit status 1, not in SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+	
+	if((argc == 3) && (strcmp(argv[1], "--shutdown") == 0)) {
+		fd = client_connect(argv[2]);
+		out = fdopen(fd, "w");
+		fprintf(out, "shutdown\n");
+		fclose(out);
+		return (0);
+		
+	}
+	
+	index = 1;
+	if((argc > 1) && (strcmp(argv[1], "--inline") == 0)) {
+		send_inline = 1;
+		index++;
+		
+	}
+	
+	if(argc - index != 5) {
+		fprintf(stderr, "Error, incorrect usage.\nCorrect usage pattern is: rtclient [--inline] socket width height scene.json output.ppm, or rtclient --shutdown socket.\n");
+		exit(-1);
+		
+	}
+	
+	fd = client_connect(argv[index]);
+	in = fdopen(fd, "r");
+	out = fdopen(dup(fd), "w");
+	
+	if(send_inline != 0) {
+		data = client_read_file(argv[index + 3], &size);
+		fprintf(out, "inline %s %s %s %zu\n", argv[index + 1], argv[index + 2], argv[index + 4], size);
+		fwrite(data, 1, size, out);
+		free(data);
+		
+	} else {
+		fprintf(out, "render %s %s %s %s\n", argv[index + 1], argv[index + 2], argv[index + 4], argv[index + 3]);
+		
+	}
+	fflush(out);
+	
+	// The server answers until the job is done or has failed
+	status = 1;
+	while(fgets(line, sizeof(line), in) != NULL) {
+		fputs(line, stdout);
+		
+		if(sscanf(line, "stats %zu", &size) == 1) {
+			while(size > 0) {
+				length = fread(line, 1, (size < sizeof(line)) ? size : sizeof(line), in);
+				if(length == 0) {
+					break;
+					
+				}
+				
+				fwrite(line, 1, length, stdout);
+				size = size - length;
+				
+			}
+			
+		} else if(strncmp(line, "done ", 5) == 0) {
+			status = 0;
+			break;
+			
+		} else if(strncmp(line, "error ", 6) == 0) {
+			break;
+			
+		}
+		
+	}
+	
+	fprintf(out, "quit\n");
+	fclose(out);
+	fclose(in);
+	
+	return (status);
+	
+}
@@ -0,0 +1,293 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: scenegen.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * Describes the scene to generate. The same description and seed always give the same scene.
+ */
+typedef struct SceneSpec {
+	int spheres;
+	int grid;
+	int lights;
+	int spots;
+	int planes;
+	unsigned long long seed;
+	
+} SceneSpec;
+
+
+/**
+ * Returns the next pseudo random number in [0, 1). A fixed 64 bit linear congruential
+ * generator is used instead of rand so a seed gives the same scene on every platform.
+ *
+ * @param state - generator state, advanced by the call
+ * @returns a number in [0, 1)
+ */
+static double next_random(unsigned long long *state) {
+	*state = (*state) * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (double)((*state) >> 11) / 9007199254740992.0;
+	
+}
+
+
+/**
+ * Returns a pseudo random number in [low, high).
+ *
+ * @param state - generator state, advanced by the call
+ * @param low - smallest value returned
+ * @param high - upper bound of the values returned
+ * @returns a number in [low, high)
+ */
+static double random_range(unsigned long long *state, double low, double high) {
+	return low + (high - low) * next_random(state);
+	
+}
+
+
+/**
+ * Writes one sphere with a random color and material.
+ *
+ * @param fpointer - file the scene is written to
+ * @param state - generator state
+ * @param x, y, z - center of the sphere
+ * @param radius - radius of the sphere
+ */
+static void write_sphere(FILE *fpointer, unsigned long long *state, double x, double y, double z, double radius) {
+	double reflectivity, refractivity, roll;
+	
+	// Most spheres are matte, some are mirrors, a few are glass
+	roll = next_random(state);
+	reflectivity = (roll < 0.3) ? random_range(state, 0.1, 0.5) : 0.0;
+	refractivity = (roll > 0.9) ? random_range(state, 0.2, 0.5) : 0.0;
+	
+	fprintf(fpointer, "    {\n");
+	fprintf(fpointer, "        \"type\": \"sphere\",\n");
+	fprintf(fpointer, "        \"radius\": %.4f,\n", radius);
+	fprintf(fpointer, "        \"reflectivity\": %.4f,\n", reflectivity);
+	fprintf(fpointer, "        \"refractivity\": %.4f,\n", refractivity);
+	fprintf(fpointer, "        \"ior\": 1.33,\n");
+	fprintf(fpointer, "        \"diffuse_color\": [%.4f, %.4f, %.4f],\n", random_range(state, 0.1, 1.0), random_range(state, 0.1, 1.0), random_range(state, 0.1, 1.0));
+	fprintf(fpointer, "        \"specular_color\": [1, 1, 1],\n");
+	fprintf(fpointer, "        \"position\": [%.4f, %.4f, %.4f]\n", x, y, z);
+	fprintf(fpointer, "    }");
+	
+}
+
+
+/**
+ * Writes a scene as json: a camera, the spheres inside a box in front of it, the planes
+ * bounding the box and the lights above it.
+ *
+ * @param fpointer - file the scene is written to
+ * @param spec - description of the scene
+ */
+static void write_scene(FILE *fpointer, SceneSpec *spec) {
+	// Floor, back wall, left and right walls, ceiling, wall behind the camera
+	double plane_normals[6][3] = {{0, 1, 0}, {0, 0, -1}, {1, 0, 0}, {-1, 0, 0}, {0, -1, 0}, {0, 0, 1}};
+	double plane_positions[6][3] = {{0, -3, 0}, {0, 0, 20}, {-6, 0, 0}, {6, 0, 0}, {0, 8, 0}, {0, 0, -4}};
+	double box_min[3] = {-4, -2.5, 4};
+	double box_max[3] = {4, 3, 14};
+	unsigned long long state;
+	double spacing[3], size, radius, x, y, z;
+	int index, per_axis, i, j, k, axis;
+	
+	state = spec->seed * 2654435761ULL + 1;
+	
+	fprintf(fpointer, "[\n");
+	fprintf(fpointer, "    {\n");
+	fprintf(fpointer, "        \"type\": \"camera\",\n");
+	fprintf(fpointer, "        \"width\": 2.0,\n");
+	fprintf(fpointer, "        \"height\": 2.0\n");
+	fprintf(fpointer, "    }");
+	
+	if(spec->grid != 0) {
+		// Smallest cube of cells that holds every sphere, filled in order
+		per_axis = 1;
+		while(per_axis * per_axis * per_axis < spec->spheres) {
+			per_axis++;
+			
+		}
+		
+		for(axis = 0; axis < 3; axis++) {
+			spacing[axis] = (box_max[axis] - box_min[axis]) / per_axis;
+			
+		}
+		
+		size = spacing[0];
+		for(axis = 1; axis < 3; axis++) {
+			if(spacing[axis] < size) {
+				size = spacing[axis];
+				
+			}
+			
+		}
+		
+		for(index = 0; index < spec->spheres; index++) {
+			i = index % per_axis;
+			j = (index / per_axis) % per_axis;
+			k = index / (per_axis * per_axis);
+			
+			fprintf(fpointer, ",\n");
+			write_sphere(fpointer, &state, box_min[0] + (i + 0.5) * spacing[0], box_min[1] + (j + 0.5) * spacing[1], box_min[2] + (k + 0.5) * spacing[2], 0.4 * size);
+			
+		}
+		
+	} else {
+		// Random field, the radii shrink with the count so the density stays about the same
+		size = cbrt((box_max[0] - box_min[0]) * (box_max[1] - box_min[1]) * (box_max[2] - box_min[2]) / ((spec->spheres > 0) ? spec->spheres : 1));
+		
+		for(index = 0; index < spec->spheres; index++) {
+			x = random_range(&state, box_min[0], box_max[0]);
+			y = random_range(&state, box_min[1], box_max[1]);
+			z = random_range(&state, box_min[2], box_max[2]);
+			radius = random_range(&state, 0.15, 0.5) * size;
+			
+			fprintf(fpointer, ",\n");
+			write_sphere(fpointer, &state, x, y, z, radius);
+			
+		}
+		
+	}
+	
+	for(index = 0; index < spec->planes; index++) {
+		fprintf(fpointer, ",\n");
+		fprintf(fpointer, "    {\n");
+		fprintf(fpointer, "        \"type\": \"plane\",\n");
+		fprintf(fpointer, "        \"reflectivity\": %.4f,\n", (index == 0) ? 0.2 : 0.0);
+		fprintf(fpointer, "        \"normal\": [%g, %g, %g],\n", plane_normals[index][0], plane_normals[index][1], plane_normals[index][2]);
+		fprintf(fpointer, "        \"diffuse_color\": [%.4f, %.4f, %.4f],\n", random_range(&state, 0.3, 1.0), random_range(&state, 0.3, 1.0), random_range(&state, 0.3, 1.0));
+		fprintf(fpointer, "        \"specular_color\": [1, 1, 1],\n");
+		fprintf(fpointer, "        \"position\": [%g, %g, %g]\n", plane_positions[index][0], plane_positions[index][1], plane_positions[index][2]);
+		fprintf(fpointer, "    }");
+		
+	}
+	
+	for(index = 0; index < spec->lights; index++) {
+		x = random_range(&state, -5, 5);
+		y = random_range(&state, 4, 7);
+		z = random_range(&state, 0, 10);
+		
+		fprintf(fpointer, ",\n");
+		fprintf(fpointer, "    {\n");
+		fprintf(fpointer, "        \"type\": \"light\",\n");
+		fprintf(fpointer, "        \"color\": [%.4f, %.4f, %.4f],\n", 3.0 / spec->lights, 3.0 / spec->lights, 3.0 / spec->lights);
+		
+		// The last lights are spot lights aimed at the center of the box
+		if(index >= spec->lights - spec->spots) {
+			fprintf(fpointer, "        \"theta\": 35,\n");
+			fprintf(fpointer, "        \"angular-a0\": 2,\n");
+			fprintf(fpointer, "        \"direction\": [%.4f, %.4f, %.4f],\n", -x, 0.25 - y, 9 - z);
+			
+		} else {
+			fprintf(fpointer, "        \"theta\": 0,\n");
+			
+		}
+		
+		fprintf(fpointer, "        \"radial-a2\": 0.01,\n");
+		fprintf(fpointer, "        \"radial-a1\": 0.05,\n");
+		fprintf(fpointer, "        \"radial-a0\": 0.5,\n");
+		fprintf(fpointer, "        \"position\": [%.4f, %.4f, %.4f]\n", x, y, z);
+		fprintf(fpointer, "    }");
+		
+	}
+	
+	fprintf(fpointer, "\n]\n");
+	
+}
+
+
+/**
+ * Generates reproducible benchmark scenes: a field of spheres on a grid or at random, lit by
+ * point and spot lights and bounded by planes.
+ *
+ * Usage: scenegen [--spheres n] [--layout grid|random] [--lights m] [--spots s] [--planes k]
+ *        [--seed n] output.json
+ *
+ * @param argc - number of arguments
+ * @param argv - the arguments
+ * @returns 0 on success
+ */
+int main(int argc, char *argv[]) {
+	SceneSpec spec;
+	FILE *fpointer;
+	int index;
+	
+	spec.spheres = 64;
+	spec.grid = 1;
+	spec.lights = 2;
+	spec.spots = 0;
+	spec.planes = 1;
+	spec.seed = 1;
+	
+	for(index = 1; (index < argc - 1) && (argv[index][0] == '-'); index++) {
+		if((strcmp(argv[index], "--spheres") == 0) && (index + 2 < argc)) {
+			spec.spheres = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--layout") == 0) && (index + 2 < argc)) {
+			index++;
+			if(strcmp(argv[index], "grid") == 0) {
+				spec.grid = 1;
+				
+			} else if(strcmp(argv[index], "random") == 0) {
+				spec.grid = 0;
+				
+			} else {
+				fprintf(stderr, "Error, unknown layout '%s'.\n", argv[index]);
+				exit(-1);
+				
+			}
+			
+		} else if((strcmp(argv[index], "--lights") == 0) && (index + 2 < argc)) {
+			spec.lights = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--spots") == 0) && (index + 2 < argc)) {
+			spec.spots = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--planes") == 0) && (index + 2 < argc)) {
+			spec.planes = atoi(argv[++index]);
+			
+		} else if((strcmp(argv[index], "--seed") == 0) && (index + 2 < argc)) {
+			spec.seed = strtoull(argv[++index], NULL, 10);
+			
+		} else {
+			fprintf(stderr, "Error, unknown or incomplete option '%s'.\n", argv[index]);
+			exit(-1);
+			
+		}
+		
+	}
+	
+	if(index != argc - 1) {
+		fprintf(stderr, "Error, incorrect usage!\nCorrect usage pattern is: scenegen [--spheres n] [--layout grid|random] [--lights m] [--spots s] [--planes k] [--seed n] output.json.\n");
+		exit(-1);
+		
+	}
+	
+	if((spec.spheres < 0) || (spec.lights < 0) || (spec.planes < 0) || (spec.planes > 6) || (spec.spots < 0) || (spec.spots > spec.lights)) {
+		fprintf(stderr, "Error, counts must not be negative, at most 6 planes and --spots at most --lights.\n");
+		exit(-1);
+		
+	}
+	
+	fpointer = fopen(argv[index], "w");
+	if(fpointer == NULL) {
+		fprintf(stderr, "Error, could not open file '%s'.\n", argv[index]);
+		exit(-1);
+		
+	}
+	
+	write_scene(fpointer, &spec);
+	fclose(fpointer);
+	
+	return 0;
+	
+}
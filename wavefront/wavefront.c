@@ -0,0 +1,660 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: wavefront.c
+ * Copyright © 2016 All rights reserved
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "..\math\real.h"
+#include "..\math\vector_math.h"
+#include "..\ppm\ppm.h"
+#include "..\json\json.h"
+#include "..\threadpool\threadpool.h"
+#include "..\scene\scene.h"
+#include "..\simd\simd.h"
+#include "..\bvh\bvh.h"
+#include "..\raycaster\raycaster.h"
+#include "..\stats\stats.h"
+#include "wavefront.h"
+
+// Sort keys of secondary rays, direction octant and dominant axis
+#define RAY_KEYS 24
+
+/**
+ * Grows an array to hold at least a number of elements, exits the program if the allocation
+ * fails.
+ *
+ * @param array - the array, may be NULL
+ * @param needed - number of elements the array has to hold
+ * @param size - size of an element in bytes
+ * @returns pointer to the grown array
+ */
+static void *wave_grow(void *array, int needed, size_t size) {
+	array = realloc(array, size * needed);
+	if(array == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	return array;
+	
+}
+
+
+/**
+ * Makes room for a number of rays in the ray queues of a worker.
+ *
+ * @param state - queues of the worker
+ * @param needed - number of rays every queue has to hold
+ */
+static void reserve_rays(WaveState *state, int needed) {
+	if(needed <= state->ray_capacity) {
+		return;
+		
+	}
+	
+	if(needed < state->ray_capacity * 2) {
+		needed = state->ray_capacity * 2;
+		
+	}
+	
+	state->rays = (WaveRay *)wave_grow(state->rays, needed, sizeof(WaveRay));
+	state->next = (WaveRay *)wave_grow(state->next, needed, sizeof(WaveRay));
+	state->sorted_rays = (WaveRay *)wave_grow(state->sorted_rays, needed, sizeof(WaveRay));
+	state->ray_capacity = needed;
+	
+}
+
+
+/**
+ * Makes room for a number of shadow rays in the shadow queues of a worker.
+ *
+ * @param state - queues of the worker
+ * @param needed - number of shadow rays every queue has to hold
+ */
+static void reserve_shadows(WaveState *state, int needed) {
+	if(needed <= state->shadow_capacity) {
+		return;
+		
+	}
+	
+	if(needed < state->shadow_capacity * 2) {
+		needed = state->shadow_capacity * 2;
+		
+	}
+	
+	state->shadows = (ShadowRay *)wave_grow(state->shadows, needed, sizeof(ShadowRay));
+	state->sorted_shadows = (ShadowRay *)wave_grow(state->sorted_shadows, needed, sizeof(ShadowRay));
+	state->shadow_capacity = needed;
+	
+}
+
+
+/**
+ * Allocates the queues of a number of workers along with their rendering state.
+ *
+ * @param scene - the scene that will be rendered
+ * @param count - number of workers
+ * @param tile_size - width and height of a tile in pixels
+ * @param settings - per render parameters
+ * @returns array of count worker queues
+ */
+static WaveState* wave_states_create(Scene *scene, int count, int tile_size, RenderSettings *settings) {
+	WaveState *states;
+	WorkerState *workers;
+	int index;
+	
+	states = (WaveState *)calloc(count, sizeof(WaveState));
+	if(states == NULL) {
+		fprintf(stderr, "Failed to allocate memory.\n");
+		exit(-1);
+		
+	}
+	
+	workers = worker_states_create(scene, count, settings);
+	
+	for(index = 0; index < count; index++) {
+		states[index].worker = &workers[index];
+		
+		// Enough buckets for either kind of sort
+		states[index].num_buckets = scene->num_lights * 8;
+		if(states[index].num_buckets < RAY_KEYS) {
+			states[index].num_buckets = RAY_KEYS;
+			
+		}
+		
+		states[index].buckets = (int *)wave_grow(NULL, states[index].num_buckets, sizeof(int));
+		states[index].pixels = (real *)wave_grow(NULL, tile_size * tile_size * 3, sizeof(real));
+		reserve_rays(&states[index], tile_size * tile_size);
+		reserve_shadows(&states[index], tile_size * tile_size * (scene->num_lights + 1));
+		
+	}
+	
+	return states;
+	
+}
+
+
+/**
+ * Releases worker queues created by wave_states_create.
+ *
+ * @param states - array of worker queues
+ * @param count - number of workers
+ */
+static void wave_states_free(WaveState *states, int count) {
+	int index;
+	
+	for(index = 0; index < count; index++) {
+		free(states[index].rays);
+		free(states[index].next);
+		free(states[index].sorted_rays);
+		free(states[index].shadows);
+		free(states[index].sorted_shadows);
+		free(states[index].buckets);
+		free(states[index].pixels);
+		
+	}
+	
+	worker_states_free(states[0].worker, count);
+	free(states);
+	
+}
+
+
+/**
+ * Returns the octant of a direction, one bit per negative component.
+ *
+ * @param rd - ray vector direction
+ * @returns octant in the range 0 to 7
+ */
+static inline int direction_octant(real *rd) {
+	return ((rd[0] < 0) | ((rd[1] < 0) << 1) | ((rd[2] < 0) << 2));
+	
+}
+
+
+/**
+ * Sort key of a secondary ray, rays with equal keys head the same way and tend to visit the
+ * same parts of the hierarchy.
+ *
+ * @param rd - ray vector direction
+ * @returns key in the range 0 to RAY_KEYS - 1
+ */
+static int ray_key(real *rd) {
+	real x = real_fabs(rd[0]), y = real_fabs(rd[1]), z = real_fabs(rd[2]);
+	int axis;
+	
+	if((x >= y) && (x >= z)) {
+		axis = 0;
+		
+	} else if(y >= z) {
+		axis = 1;
+		
+	} else {
+		axis = 2;
+		
+	}
+	
+	return ((direction_octant(rd) * 3) + axis);
+	
+}
+
+
+/**
+ * Orders the wave by direction with a stable counting sort.
+ *
+ * @param state - queues of the worker
+ */
+static void sort_rays(WaveState *state) {
+	WaveRay *swap;
+	int index, key, total, count;
+	
+	memset(state->buckets, 0, sizeof(int) * RAY_KEYS);
+	for(index = 0; index < state->num_rays; index++) {
+		state->buckets[ray_key(state->rays[index].rd)]++;
+		
+	}
+	
+	// Turn the counts into starting positions
+	total = 0;
+	for(key = 0; key < RAY_KEYS; key++) {
+		count = state->buckets[key];
+		state->buckets[key] = total;
+		total = total + count;
+		
+	}
+	
+	for(index = 0; index < state->num_rays; index++) {
+		key = ray_key(state->rays[index].rd);
+		state->sorted_rays[state->buckets[key]++] = state->rays[index];
+		
+	}
+	
+	swap = state->rays;
+	state->rays = state->sorted_rays;
+	state->sorted_rays = swap;
+	
+}
+
+
+/**
+ * Orders the shadow rays by light and then by direction with a stable counting sort. Being
+ * stable, the shadow rays of one wave ray stay in light order so its color is summed in the
+ * same order as by the depth first renderer.
+ *
+ * @param state - queues of the worker
+ * @param num_keys - number of lights times 8
+ */
+static void sort_shadows(WaveState *state, int num_keys) {
+	ShadowRay *swap;
+	int index, key, total, count;
+	
+	memset(state->buckets, 0, sizeof(int) * num_keys);
+	for(index = 0; index < state->num_shadows; index++) {
+		state->buckets[(state->shadows[index].light * 8) + direction_octant(state->shadows[index].rd)]++;
+		
+	}
+	
+	total = 0;
+	for(key = 0; key < num_keys; key++) {
+		count = state->buckets[key];
+		state->buckets[key] = total;
+		total = total + count;
+		
+	}
+	
+	for(index = 0; index < state->num_shadows; index++) {
+		key = (state->shadows[index].light * 8) + direction_octant(state->shadows[index].rd);
+		state->sorted_shadows[state->buckets[key]++] = state->shadows[index];
+		
+	}
+	
+	swap = state->shadows;
+	state->shadows = state->sorted_shadows;
+	state->sorted_shadows = swap;
+	
+}
+
+
+/**
+ * Finds the closest hit of every ray of the wave, four rays to a packet.
+ *
+ * @param scene - the scene
+ * @param state - queues of the worker
+ */
+static void intersect_wave(Scene *scene, WaveState *state) {
+	RayPacket packet;
+	WaveRay *ray;
+	int first, lane;
+	
+	for(first = 0; first < state->num_rays; first += PACKET_SIZE) {
+		for(lane = 0; lane < PACKET_SIZE; lane++) {
+			if(first + lane < state->num_rays) {
+				ray = &state->rays[first + lane];
+				
+				packet.ox[lane] = ray->ro[0];
+				packet.oy[lane] = ray->ro[1];
+				packet.oz[lane] = ray->ro[2];
+				packet.dx[lane] = ray->rd[0];
+				packet.dy[lane] = ray->rd[1];
+				packet.dz[lane] = ray->rd[2];
+				packet.ignore[lane] = ray->ignore;
+				
+			} else {
+				// Inactive lane, a NaN direction never hits anything
+				packet.ox[lane] = packet.oy[lane] = packet.oz[lane] = 0;
+				packet.dx[lane] = packet.dy[lane] = packet.dz[lane] = NAN;
+				packet.ignore[lane] = -1;
+				
+			}
+			
+		}
+		
+		packet_closest(scene, &packet);
+		
+		for(lane = 0; (lane < PACKET_SIZE) && (first + lane < state->num_rays); lane++) {
+			state->rays[first + lane].distance = packet.distance[lane];
+			state->rays[first + lane].object = packet.object[lane];
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Appends a secondary ray to the next wave.
+ *
+ * @param state - queues of the worker
+ * @param ro - ray vector orgin
+ * @param rd - normalized ray vector direction
+ * @param weight - fraction of the ray's color that reaches the pixel
+ * @param ignore - object index excluded from the test, -1 to test every object
+ * @param pixel - tile relative index of the pixel
+ */
+static void emit_ray(WaveState *state, real *ro, real *rd, real weight, int ignore, int pixel) {
+	WaveRay *ray = &state->next[state->num_next++];
+	
+	vector_copy(ro, ray->ro);
+	vector_copy(rd, ray->rd);
+	ray->weight = weight;
+	ray->ignore = ignore;
+	ray->pixel = pixel;
+	
+}
+
+
+/**
+ * Computes the hit point of every ray of the wave, queues a shadow ray per light that could
+ * light the point and queues the reflected and refracted rays into the next wave. Performs the
+ * same operations as colorer so both renderers produce the same colors.
+ *
+ * @param scene - the scene
+ * @param state - queues of the worker
+ * @param spawn - 1 if the wave may spawn secondary rays, 0 at the maximum depth
+ */
+static void shade_wave(Scene *scene, WaveState *state, int spawn) {
+	WaveRay *ray;						//<= ray being shaded
+	ShadowRay *shadow;					//<= queued shadow ray
+	real point[3];						//<= hit point
+	real normal[3]; 					//<= normal vector
+	real direction[3];					//<= light or secondary ray direction
+	real origin[3];						//<= secondary ray orgin
+	real light_distance;				//<= distance to the light
+	real color[3];						//<= light reflected from a single light
+	Material *material;					//<= surface properties of the hit object
+	real weight;						//<= weight of a secondary ray
+	int index, light;
+	
+	state->num_shadows = 0;
+	state->num_next = 0;
+	reserve_shadows(state, state->num_rays * scene->num_lights);
+	
+	// Secondary rays go to the next queue, which grows along with the current one
+	if(spawn != 0) {
+		reserve_rays(state, state->num_rays * 2);
+		
+	}
+	
+	for(index = 0; index < state->num_rays; index++) {
+		ray = &state->rays[index];
+		ray->color[0] = ray->color[1] = ray->color[2] = 0;
+		
+		if(ray->object == -1) {
+			continue;
+			
+		}
+		
+		material = &scene->materials[ray->object];
+		
+		// Establish the hit point and its normal
+		vector_scale(ray->rd, ray->distance, point);
+		vector_add(ray->ro, point, point);
+		
+		normalize(ray->rd);
+		surface_normal(scene, ray->object, point, normal);
+		normalize(normal);
+		
+		for(light = 0; light < scene->num_lights; light++) {
+			vector_subtract(scene->lights[light].position, point, direction);
+			light_distance = vector_length(direction);
+			normalize(direction);
+			
+			light_contribution(&scene->lights[light], material, ray->rd, direction, light_distance, normal, color);
+			
+			// A light the point faces away from needs no shadow ray
+			if((color[0] != 0) || (color[1] != 0) || (color[2] != 0)) {
+				shadow = &state->shadows[state->num_shadows++];
+				vector_copy(point, shadow->ro);
+				vector_copy(direction, shadow->rd);
+				vector_copy(color, shadow->color);
+				shadow->distance = light_distance;
+				shadow->ray = index;
+				shadow->light = light;
+				shadow->ignore = ray->object;
+				
+			}
+			
+		}
+		
+		if(spawn == 0) {
+			continue;
+			
+		}
+		
+		// Spheres and planes are convex, a reflected ray can not hit its own object again
+		weight = ray->weight * material->reflectivity;
+		if((material->reflectivity > 0) && (continue_ray(state->worker, &weight) != 0)) {
+			vector_reflection(ray->rd, normal, direction);
+			STATS_ADD(reflection_rays, 1);
+			emit_ray(state, point, direction, weight, ray->object, ray->pixel);
+			
+		}
+		
+		// A refracted ray may hit the far side of its own object, step off the surface instead
+		weight = ray->weight * material->refractivity;
+		if((material->refractivity > 0) && (continue_ray(state->worker, &weight) != 0) && (refraction(ray->rd, normal, material->ior, direction) != 0)) {
+			vector_scale(direction, RAY_EPSILON, origin);
+			vector_add(point, origin, origin);
+			STATS_ADD(refraction_rays, 1);
+			emit_ray(state, origin, direction, weight, -1, ray->pixel);
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Traces the queued shadow rays, grouped by light and direction, and adds the light of every
+ * unblocked one to the color of its wave ray.
+ *
+ * @param scene - the scene
+ * @param state - queues of the worker
+ */
+static void trace_shadows(Scene *scene, WaveState *state) {
+	ShadowRay *shadow;
+	WaveRay *ray;
+	int index;
+	
+	sort_shadows(state, scene->num_lights * 8);
+	
+	for(index = 0; index < state->num_shadows; index++) {
+		shadow = &state->shadows[index];
+		
+		if(light_occluder(scene, state->worker, shadow->light, shadow->ro, shadow->rd, shadow->ignore, shadow->distance) == -1) {
+			ray = &state->rays[shadow->ray];
+			ray->color[0] += shadow->color[0];
+			ray->color[1] += shadow->color[1];
+			ray->color[2] += shadow->color[2];
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Renders one tile as a sequence of waves. The first wave holds the view rays of the tile,
+ * every following wave the reflected and refracted rays spawned by the one before it.
+ *
+ * @param job - description of the render
+ * @param state - queues of the worker
+ * @param task - index of the tile in row major order
+ */
+static void wavefront_tile(WaveJob *job, WaveState *state, int task) {
+	WaveRay *ray, *swap;
+	Pixel *pixel;
+	real *color;
+	int row, column, width, height, index, depth;
+	int row_start, column_start;				//<= upper left corner of the tile
+	int row_end, column_end;					//<= lower right corner of the tile
+	
+	row_start = job->image->band_start + (task / job->tiles_x) * job->tile_size;
+	column_start = job->image->band_left + (task % job->tiles_x) * job->tile_size;
+	
+	row_end = row_start + job->tile_size;
+	if(row_end > job->image->band_start + job->image->band_height) {
+		row_end = job->image->band_start + job->image->band_height;
+		
+	}
+	
+	column_end = column_start + job->tile_size;
+	if(column_end > job->image->band_left + job->image->band_width) {
+		column_end = job->image->band_left + job->image->band_width;
+		
+	}
+	
+	width = column_end - column_start;
+	height = row_end - row_start;
+	memset(state->pixels, 0, sizeof(real) * width * height * 3);
+	
+	// Russian roulette draws from a sequence seeded per tile
+	state->worker->random = sample_hash(row_start, column_start, 0) | 1;
+	
+	// Generate the view rays of the tile
+	state->num_rays = 0;
+	for(row = row_start; row < row_end; row++) {
+		for(column = column_start; column < column_end; column++) {
+			ray = &state->rays[state->num_rays];
+			
+			ray->ro[0] = ray->ro[1] = ray->ro[2] = 0.0;
+			view_ray(&job->view, row, column, ray->rd);
+			ray->weight = 1;
+			ray->ignore = -1;
+			ray->pixel = state->num_rays++;
+			
+		}
+		
+	}
+	STATS_ADD(primary_rays, state->num_rays);
+	
+	for(depth = 0; state->num_rays > 0; depth++) {
+		// View rays are coherent already
+		if(depth > 0) {
+			sort_rays(state);
+			
+		}
+		
+		intersect_wave(job->scene, state);
+		shade_wave(job->scene, state, depth < job->max_depth);
+		trace_shadows(job->scene, state);
+		
+		for(index = 0; index < state->num_rays; index++) {
+			ray = &state->rays[index];
+			
+			if(ray->object != -1) {
+				STATS_ADD(hits, 1);
+				STATS_DEPTH(depth);
+				color = &state->pixels[ray->pixel * 3];
+				color[0] += ray->weight * ray->color[0];
+				color[1] += ray->weight * ray->color[1];
+				color[2] += ray->weight * ray->color[2];
+				
+			}
+			
+		}
+		
+		// The rays spawned by this wave become the next wave
+		swap = state->rays;
+		state->rays = state->next;
+		state->next = swap;
+		state->num_rays = state->num_next;
+		
+	}
+	
+	for(row = 0; row < height; row++) {
+		for(column = 0; column < width; column++) {
+			color = &state->pixels[((row * width) + column) * 3];
+			pixel = image_pixel(job->image, row_start + row, column_start + column);
+			
+			pixel->red = clamp(color[0], 0, 1) * (job->image->max_color);
+			pixel->green = clamp(color[1], 0, 1) * (job->image->max_color);
+			pixel->blue = clamp(color[2], 0, 1) * (job->image->max_color);
+			
+		}
+		
+	}
+	
+}
+
+
+/**
+ * Renders a single tile, called by the thread pool once per tile.
+ *
+ * @param context - pointer to the WaveJob describing the render
+ * @param task - index of the tile in row major order
+ * @param thread_id - worker executing the tile
+ */
+static void wavefront_task(void *context, int task, int thread_id) {
+	WaveJob *job = (WaveJob *)context;
+	
+	wavefront_tile(job, &job->states[thread_id], task);
+	
+}
+
+
+/**
+ * Wavefront version of raycaster. Instead of following the ray tree of one pixel at a time,
+ * every tile is traced in waves: all rays of a wave are intersected in packets, then the
+ * shadow rays they spawn are traced grouped by light and direction, then their reflected and
+ * refracted rays, sorted by direction, form the next wave. Keeps the hierarchy and the object
+ * arrays hot in cache and hands the packet kernels full packets of secondary rays. Colors
+ * match the depth first renderer up to the order in which the bounces of a pixel are summed.
+ *
+ * @param scene - scene created from the objects read in from the json parser
+ * @param image - is an Image object used to store image data
+ * @param pool - thread pool that executes the tiles, NULL to render on the calling thread
+ * @param tile_size - width and height of a tile in pixels
+ * @param settings - per render parameters
+ * @returns Image - pointer to the rendered image
+ */
+Image* raycaster_wavefront(Scene *scene, Image *image, ThreadPool *pool, int tile_size, RenderSettings *settings) {
+	WaveJob job;
+	int count, tiles_y, task;
+	
+	if(tile_size < 1) {
+		tile_size = DEFAULT_TILE_SIZE;
+		
+	}
+	
+	count = (pool != NULL) ? pool->num_threads : 1;
+	
+	setup_view(scene, image, &job.view);
+	
+	job.scene = scene;
+	job.states = wave_states_create(scene, count, tile_size, settings);
+	job.image = image;
+	job.tile_size = tile_size;
+	job.tiles_x = (image->band_width + tile_size - 1) / tile_size;
+	job.max_depth = settings->max_depth;
+	tiles_y = (image->band_height + tile_size - 1) / tile_size;
+	
+	if(pool != NULL) {
+		threadpool_run(pool, wavefront_task, &job, job.tiles_x * tiles_y);
+		
+	} else {
+		for(task = 0; task < job.tiles_x * tiles_y; task++) {
+			wavefront_tile(&job, &job.states[0], task);
+			
+		}
+		
+	}
+	
+	// Rays wait in queues rather than on a stack
+	settings->peak_stack = 0;
+	settings->samples = (long long)image->band_width * image->band_height;
+	wave_states_free(job.states, count);
+	
+	return image;
+	
+}
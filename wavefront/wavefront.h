@@ -0,0 +1,78 @@
+/**
+ * Author: Jarid Bredemeier
+ * Email: jpb64@nau.edu
+ * Date: Tuesday, November 1, 2016
+ * File: wavefront.h
+ * Copyright © 2016 All rights reserved
+ */
+
+#ifndef wavefront_h
+	#define wavefront_h
+	
+	/**
+	 * A ray of the current wave. color collects the light reflected at its hit point, weight is
+	 * the fraction of that light that reaches pixel, the tile relative index of its pixel.
+	 */
+	typedef struct WaveRay {
+		real ro[3];
+		real rd[3];
+		real color[3];
+		real weight;
+		real distance;
+		int object;
+		int ignore;
+		int pixel;
+		
+	} WaveRay;
+	
+	/**
+	 * A shadow ray from a hit point of the current wave towards a light. color is the light the
+	 * point reflects if the light turns out to be visible, ray indexes the wave ray it belongs to.
+	 */
+	typedef struct ShadowRay {
+		real ro[3];
+		real rd[3];
+		real color[3];
+		real distance;
+		int ray;
+		int light;
+		int ignore;
+		
+	} ShadowRay;
+	
+	/**
+	 * Queues and buffers of one worker. rays holds the wave being traced, next the rays it
+	 * spawns, the sorted arrays are the targets of the coherence sorts. buckets counts the keys
+	 * of a sort and pixels accumulates the colors of the tile being rendered.
+	 */
+	typedef struct WaveState {
+		WorkerState *worker;
+		WaveRay *rays, *next, *sorted_rays;
+		int num_rays, num_next, ray_capacity;
+		ShadowRay *shadows, *sorted_shadows;
+		int num_shadows, shadow_capacity;
+		int *buckets;
+		int num_buckets;
+		real *pixels;
+		
+	} WaveState;
+	
+	/**
+	 * Describes a wavefront render handed to the thread pool, tiles are numbered in row major
+	 * order.
+	 */
+	typedef struct WaveJob {
+		Scene *scene;
+		WaveState *states;
+		Image *image;
+		View view;
+		int tile_size;
+		int tiles_x;
+		int max_depth;
+		
+	} WaveJob;
+	
+	// function declarations
+	Image* raycaster_wavefront(Scene *scene, Image *image, ThreadPool *pool, int tile_size, RenderSettings *settings);
+	
+#endif